@@ -1,5 +1,6 @@
 #include <iostream>
 #include "vivid/Application.h"
+#include "vivid/core/GLStateCache.h"
 #include "vivid/core/Mesh.h"
 #include "vivid/core/Camera.h"
 #include "vivid/core/Shader.h"
@@ -14,12 +15,16 @@ namespace vivid {
 class BasicPbrDemo : public Application {
 public:
     BasicPbrDemo() : Application(800, 600, "PBR demo") {
-        glEnable(GL_DEPTH_TEST);
+        GLStateCache::Instance().Enable(GL_DEPTH_TEST);
 
         SetWindowResizable(false);
 
         // Load shader
         shader_ = ShaderImpl::LoadShader("./shaders/BasicPbr.vert", "./shaders/BasicPbr.frag");
+        if (shader_ == nullptr) {
+            std::cerr << "failed to build the shader!\n";
+            exit(-1);
+        }
 
         // Create airplane
         auto sphereGeo = std::make_shared<SphereGeometry>(0.5f, 64, 64);
@@ -39,7 +44,7 @@ public:
         controls_->Update();
 
         // Render to the screen
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        GLStateCache::Instance().BindFramebuffer(GL_FRAMEBUFFER, 0);
         glClearColor(0.75f, 0.9f, 0.9f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -1,5 +1,6 @@
 #include <iostream>
 #include "vivid/Application.h"
+#include "vivid/core/GLStateCache.h"
 #include "vivid/core/Mesh.h"
 #include "vivid/core/Camera.h"
 #include "vivid/core/Shader.h"
@@ -18,6 +19,10 @@ namespace vivid {
         ColoredBlinnPhongDemoApp() : Application(800, 600, "cube demo") {
             // Load shader
             shader_ = ShaderImpl::GetBlinnPhongShader();
+            if (shader_ == nullptr) {
+                std::cerr << "failed to build the shader!\n";
+                exit(-1);
+            }
 
             glm::vec3 diffuseColor(0.2, 0.7, 0.8);
             glm::vec3 specularColor(1, 0, 0);
@@ -49,7 +54,7 @@ namespace vivid {
 
         void Render() override {
             glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-            glEnable(GL_DEPTH_TEST);
+            GLStateCache::Instance().Enable(GL_DEPTH_TEST);
             glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
             controls_->Update();
@@ -1,6 +1,7 @@
 #include <iostream>
 #include <fstream>
 #include "vivid/Application.h"
+#include "vivid/core/GLStateCache.h"
 #include "vivid/core/Mesh.h"
 #include "vivid/core/Camera.h"
 #include "vivid/core/Shader.h"
@@ -41,6 +42,10 @@ public:
         // Load shader
         std::cout << "load shader...\n";
         shader_ = ShaderImpl::LoadShader("./shaders/Fog.vert", "./shaders/Fog.frag");
+        if (shader_ == nullptr) {
+            std::cerr << "failed to build the shader!\n";
+            exit(-1);
+        }
 
         // Mesh
         std::cout << "create mesh...\n";
@@ -62,7 +67,7 @@ public:
 
     void Render() override {
         glClearColor(bgColor.x, bgColor.y, bgColor.z, 1.0f);
-        glEnable(GL_DEPTH_TEST);
+        GLStateCache::Instance().Enable(GL_DEPTH_TEST);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
         // if you want to draw the wireframe, set the fill mode
@@ -1,6 +1,7 @@
 #include <iostream>
 #include <fstream>
 #include "vivid/Application.h"
+#include "vivid/core/GLStateCache.h"
 #include "vivid/core/Mesh.h"
 #include "vivid/core/Camera.h"
 #include "vivid/core/Shader.h"
@@ -19,7 +20,7 @@ namespace vivid {
     class FrameBufferDemoApp : public Application {
     public:
         FrameBufferDemoApp() : Application(800, 600, "Load json demo") {
-            glEnable(GL_DEPTH_TEST);
+            GLStateCache::Instance().Enable(GL_DEPTH_TEST);
 
             // Make the window size constant
             SetWindowResizable(false);
@@ -37,6 +38,10 @@ namespace vivid {
             // Load shader
             std::cout << "load shader...\n";
             shader_ = ShaderImpl::GetBasicShadingShader();
+            if (shader_ == nullptr) {
+                std::cerr << "failed to build the shader!\n";
+                exit(-1);
+            }
 
             // Camera
             std::cout << "create camera...\n";
@@ -56,6 +61,10 @@ namespace vivid {
             auto quadGeometry = std::make_shared<PlaneGeometry>(2, 2, 1, 1);
             quad_ = std::make_shared<Mesh>(quadGeometry, nullptr);
             quadShader_ = ShaderImpl::LoadShader("./shaders/Passthrough.vert", "./shaders/WobbyTexture.frag");
+            if (quadShader_ == nullptr) {
+                std::cerr << "failed to build the shader!\n";
+                exit(-1);
+            }
 
             controls_ = std::make_shared<OrbitControls>(window_, camera_, Eigen::Vector3d(0, 1, 0), UpDir::Y);
         }
@@ -73,7 +82,7 @@ namespace vivid {
             // Render to our frame buffer
             frameBuffer_->Bind();
             glClearColor(0.75f, 0.9f, 0.9f, 1.0f);
-            glViewport(0, 0, windowWidth_, windowHeight_);
+            GLStateCache::Instance().Viewport(0, 0, windowWidth_, windowHeight_);
             glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
             shader_->Use();
@@ -81,14 +90,13 @@ namespace vivid {
             fox_->Draw(camera_, shader_);
 
             // Render to screen
-            glBindFramebuffer(GL_FRAMEBUFFER, 0);
-            glViewport(0, 0, windowWidth_, windowHeight_);
+            GLStateCache::Instance().BindFramebuffer(GL_FRAMEBUFFER, 0);
+            GLStateCache::Instance().Viewport(0, 0, windowWidth_, windowHeight_);
             glClearColor(0.75f, 0.9f, 0.9f, 1.0f);
             glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
             quadShader_->Use();
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, frameBuffer_->colorTextureHandle_);
+            GLStateCache::Instance().BindTexture(0, GL_TEXTURE_2D, frameBuffer_->colorTextureHandle_);
             quadShader_->SetInt("myTexture", 0);
 
             auto time = (float)(glfwGetTime() * 10.0f);
@@ -1,5 +1,6 @@
 #include <iostream>
 #include "vivid/Application.h"
+#include "vivid/core/GLStateCache.h"
 #include "vivid/core/Mesh.h"
 #include "vivid/core/Camera.h"
 #include "vivid/core/Shader.h"
@@ -31,7 +32,7 @@ namespace vivid {
 
         void Render() override {
             glClearColor(0.9f, 0.9f, 0.9f, 1.0f);
-            glEnable(GL_DEPTH_TEST);
+            GLStateCache::Instance().Enable(GL_DEPTH_TEST);
             glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
             // imgui
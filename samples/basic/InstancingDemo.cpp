@@ -0,0 +1,77 @@
+#include <iostream>
+#include "vivid/Application.h"
+#include "vivid/core/GLStateCache.h"
+#include "vivid/core/InstancedMesh.h"
+#include "vivid/core/Camera.h"
+#include "vivid/core/Shader.h"
+#include "vivid/OrbitControls.h"
+#include "vivid/utils/GlmUtils.h"
+#include "vivid/primitives/BoxGeometry.h"
+#include "vivid/extras/ShaderImpl.h"
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace vivid {
+    class InstancingDemoApp : public Application {
+    public:
+        InstancingDemoApp() : Application(800, 600, "Instancing Demo") {
+            // Load shader
+            shader_ = ShaderImpl::GetInstancedShader();
+            if (shader_ == nullptr) {
+                std::cerr << "failed to build the shader!\n";
+                exit(-1);
+            }
+
+            // A grid of boxes drawn in a single call
+            const int gridSize = 100;
+            auto boxGeometry = std::make_shared<BoxGeometry>(1, 1, 1, 1, 1, 1);
+            boxes_ = std::make_shared<InstancedMesh>(boxGeometry, nullptr, gridSize * gridSize);
+            for (int i = 0; i < gridSize; ++i) {
+                for (int j = 0; j < gridSize; ++j) {
+                    const int index = i * gridSize + j;
+                    const float height = 0.2f + 0.8f * float((i * 7 + j * 13) % 10) / 10.f;
+                    boxes_->SetTransformAt(index,
+                                           Eigen::Vector3f(float(i - gridSize / 2), float(j - gridSize / 2), height / 2),
+                                           Eigen::Quaternionf::Identity(),
+                                           Eigen::Vector3f(0.6f, 0.6f, height));
+                    boxes_->SetColorAt(index, glm::vec3(float(i) / gridSize, float(j) / gridSize, 0.6f));
+                }
+            }
+
+            // Camera
+            Eigen::Vector3d lookAtTarget(0, 0, 0);
+            camera_ = std::make_shared<Camera>();
+            glm::mat4 view_mat = glm::lookAt(glm::vec3(40, 0, 30), glm::vec3(lookAtTarget.x(), lookAtTarget.y(), lookAtTarget.z()), glm::vec3(0, 0, 1));
+            Eigen::Matrix4d Tcw = vivid::GlmUtils::glm2eigen<double>(view_mat);
+            camera_->SetTransform(Transform(Tcw.inverse()));
+
+            controls_ = std::make_shared<OrbitControls>(window_, camera_, lookAtTarget);
+        }
+
+        void Render() override {
+            glClearColor(0.75f, 0.9f, 0.9f, 1.0f);
+            GLStateCache::Instance().Enable(GL_DEPTH_TEST);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+            controls_->Update();
+
+            boxes_->Draw(camera_, shader_);
+        }
+
+    private:
+        InstancedMeshPtr boxes_;
+        std::shared_ptr<Shader> shader_;
+
+        CameraPtr camera_;
+
+        std::shared_ptr<OrbitControls> controls_;
+
+    };
+} // namespace vivid
+
+
+int main() {
+    vivid::InstancingDemoApp app;
+    app.Run();
+
+    return 0;
+}
@@ -1,6 +1,7 @@
 #include <iostream>
 #include <fstream>
 #include "vivid/Application.h"
+#include "vivid/core/GLStateCache.h"
 #include "vivid/core/Mesh.h"
 #include "vivid/core/Camera.h"
 #include "vivid/core/Shader.h"
@@ -45,6 +46,10 @@ public:
         std::cout << "load shader...\n";
         //shader_ = ShaderImpl::LoadShader("./shaders/SimpleShading.vert", "./shaders/SimpleShading.frag");
         shader_ = ShaderImpl::GetBasicShadingShader();
+        if (shader_ == nullptr) {
+            std::cerr << "failed to build the shader!\n";
+            exit(-1);
+        }
 
         // material
         auto material = std::make_shared<BasicColorMaterial>(glm::vec3(0.5), colorTexture);
@@ -65,7 +70,7 @@ public:
 
     void Render() override {
         glClearColor(0.75f, 0.9f, 0.9f, 1.0f);
-        glEnable(GL_DEPTH_TEST);
+        GLStateCache::Instance().Enable(GL_DEPTH_TEST);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
         // if you want to draw the wireframe, set the fill mode
@@ -1,7 +1,10 @@
 #include <iostream>
 #include "vivid/Application.h"
+#include "vivid/core/GLStateCache.h"
 #include "vivid/core/Mesh.h"
 #include "vivid/core/Camera.h"
+#include "vivid/core/Renderer.h"
+#include "vivid/core/Scene.h"
 #include "vivid/core/Shader.h"
 #include "vivid/OrbitControls.h"
 #include "vivid/utils/GlmUtils.h"
@@ -15,14 +18,16 @@ namespace vivid {
 class BasicPbrDemo : public Application {
 public:
     BasicPbrDemo() : Application(800, 600, "PBR demo") {
-        glEnable(GL_DEPTH_TEST);
-        glEnable(GL_BLEND);
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        GLStateCache::Instance().Enable(GL_DEPTH_TEST);
 
         SetWindowResizable(false);
 
         // Load shader
         shader_ = ShaderImpl::GetPBRShader();
+        if (shader_ == nullptr) {
+            std::cerr << "failed to build the shader!\n";
+            exit(-1);
+        }
 
         // IBL textures
         auto brdfLutTexture = IOUtil::LoadTexture("./models/car/lut.png");
@@ -34,26 +39,34 @@ public:
         LoadInterior();
 
         shader_->Use();
-        glActiveTexture(GL_TEXTURE5);
-        glBindTexture(GL_TEXTURE_2D, brdfLutTexture->GetHandle());
+        GLStateCache::Instance().BindTexture(5, GL_TEXTURE_2D, brdfLutTexture->GetHandle());
         shader_->SetInt("uBrdfLutMap", 5);
 
-        glActiveTexture(GL_TEXTURE6);
-        glBindTexture(GL_TEXTURE_2D, envIrradianceTexture->GetHandle());
+        GLStateCache::Instance().BindTexture(6, GL_TEXTURE_2D, envIrradianceTexture->GetHandle());
         shader_->SetInt("uEnvIrradianceMap", 6);
 
-        glActiveTexture(GL_TEXTURE7);
-        glBindTexture(GL_TEXTURE_2D, envSpecularTexture->GetHandle());
+        GLStateCache::Instance().BindTexture(7, GL_TEXTURE_2D, envSpecularTexture->GetHandle());
         shader_->SetInt("uEnvSpecularMap", 7);
 
         shader_->SetBool("uEnableIBL", true);
 
+        // Lights don't move, their uniforms are kept by the program
+        shader_->SetVec3("uLightPositions[0]", glm::vec3(0, 2.0, 2.0));
+        shader_->SetVec3("uLightColors[0]", glm::vec3(180.0));
+        shader_->SetInt("uLightCount", 1);
+
         // Create airplane
         auto sphereGeo = std::make_shared<SphereGeometry>(0.3f, 64, 64);
         auto sphereMaterial = std::make_shared<PbrMaterial>(glm::vec3(1));
         sphere_ = std::make_shared<Mesh>(sphereGeo, sphereMaterial);
         sphere_->GetTransform().SetPosition({0, 1.0, 1.2});
 
+        // The inner parts follow the exterior
+        scene_ = std::make_shared<Scene>();
+        scene_->Add(sphere_);
+        scene_->Add(carExt_);
+        carExt_->AddChild(carExtInner_);
+        carExt_->AddChild(carInterior_);
 
         // Camera
         Eigen::Vector3d lookAtTarget(0, 0, 0);
@@ -69,36 +82,20 @@ public:
         controls_->Update();
 
         // Render to the screen
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        GLStateCache::Instance().BindFramebuffer(GL_FRAMEBUFFER, 0);
         glClearColor(0.75f, 0.9f, 0.9f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        // Bind shader
-        shader_->Use();
-
-        // Set camera position uniform
-        Eigen::Vector3d camPos = camera_->GetTransform().Position();
-        shader_->SetVec3("uCamPosW", glm::vec3(camPos.x(), camPos.y(), camPos.z()));
-
-        // Set light uniforms
-        shader_->SetVec3("uLightPositions[0]", glm::vec3(0, 2.0, 2.0));
-        shader_->SetVec3("uLightColors[0]", glm::vec3(180.0));
-        shader_->SetInt("uLightCount", 1);
-
-        // draw sphere
+        // The camera position is read from the frame uniforms, the lights were set once
+        // update sphere material
         auto sphereMaterial = std::dynamic_pointer_cast<PbrMaterial>(sphere_->GetMaterial());
         sphereMaterial->SetBaseColor(baseColor_);
         sphereMaterial->SetMetalness(metalness_);
         sphereMaterial->SetRoughness(roughness_);
-        sphere_->Draw(camera_, shader_);
 
-        // draw car
+        // rotate car, then draw the sphere and the car
         carExt_->GetTransform().Rotate({0, 1, 0}, 0.01);
-        carExtInner_->SetTransform(carExt_->GetTransform());
-        carInterior_->SetTransform(carExt_->GetTransform());
-        carInterior_->Draw(camera_, shader_);
-        carExt_->Draw(camera_, shader_);
-        carExtInner_->Draw(camera_, shader_);
+        renderer_.Render(*scene_, camera_, shader_);
 
         // UI
         ui_.NewFrame();
@@ -117,6 +114,8 @@ public:
     void LoadExterior() {
         carExt_ = IOUtil::LoadJsonModel("./models/car/car-ext.json");
         carExtInner_ = IOUtil::LoadJsonModel("./models/car/car-ext-inner.json");
+        carExt_->GetGeometry()->SetInterleaved(true);
+        carExtInner_->GetGeometry()->SetInterleaved(true);
         auto material = std::make_shared<PbrMaterial>(glm::vec3(1));
 
         auto baseColorTexture = IOUtil::LoadTexture("./models/car/car-ext-color.jpg");
@@ -131,12 +130,16 @@ public:
         auto emissiveTexture = IOUtil::LoadTexture("./models/car/car-ext-emissive.jpg");
         material->SetEmissiveTexture(emissiveTexture);
 
+        // The windows are blended over the interior, drawn after it
+        material->SetTransparent(true);
+
         carExt_->SetMaterial(material);
         carExtInner_->SetMaterial(material);
     }
 
     void LoadInterior() {
         carInterior_ = IOUtil::LoadJsonModel("./models/car/car-int.json");
+        carInterior_->GetGeometry()->SetInterleaved(true);
 
         auto material = std::make_shared<PbrMaterial>(glm::vec3(1));
         auto baseColorTexture = IOUtil::LoadTexture("./models/car/car-int-color.jpg");
@@ -157,6 +160,9 @@ public:
 private:
     ShaderPtr shader_;
 
+    ScenePtr scene_;
+    Renderer renderer_;
+
     MeshPtr sphere_;
 
     MeshPtr carExt_;
@@ -11,6 +11,10 @@ public:
     PointCloudDemoApp() : Application(800, 600, "cube demo") {
         // Load shaders
         shader_ = ShaderImpl::GetVertexColoredShader();
+        if (shader_ == nullptr) {
+            std::cerr << "failed to build the shader!\n";
+            exit(-1);
+        }
 
         // create point cloud
         GeneratePointCloud(points_, colors_, numPoints_);
@@ -27,7 +31,7 @@ public:
 
     void Render() override {
         glClearColor(0.2f, 0.2f, 0.2f, 1.0f);
-        glEnable(GL_DEPTH_TEST);
+        GLStateCache::Instance().Enable(GL_DEPTH_TEST);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
         controls_->Update();
@@ -76,9 +80,19 @@ public:
             colors[i3] = 1 - points[i3 + 2] / s;
         }
 
+        // Update the attributes of the existing point cloud, they are uploaded on the next draw
+        if (pointCloud_) {
+            positionAttr_->SetData(points_);
+            colorAttr_->SetData(colors_);
+            colorAttr_->Quantize(ComponentType::UnsignedByte);
+            return;
+        }
+
+        positionAttr_ = std::make_shared<Attribute>(AttributeType::Position, 3, false, &points_);
+        colorAttr_ = Attribute::CreateQuantized(AttributeType::Color, 3, ComponentType::UnsignedByte, colors_);
         auto geo = std::make_shared<Geometry>();
-        geo->AddAttribute(std::make_shared<Attribute>(AttributeType::Position, 3, false, &points_));
-        geo->AddAttribute(std::make_shared<Attribute>(AttributeType::Color, 3, false, &colors_));
+        geo->AddAttribute(positionAttr_);
+        geo->AddAttribute(colorAttr_);
 
         auto material = std::make_shared<PointCloudMaterial>(pointSize_);
         pointCloud_ = std::make_shared<Mesh>(geo, material);
@@ -88,6 +102,8 @@ private:
 
     // point cloud
     MeshPtr pointCloud_;
+    AttributePtr positionAttr_;
+    AttributePtr colorAttr_;
     std::shared_ptr<Shader> shader_;
 
     float pointSize_ = 2.0;
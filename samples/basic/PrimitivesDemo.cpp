@@ -1,5 +1,6 @@
 #include <iostream>
 #include "vivid/Application.h"
+#include "vivid/core/GLStateCache.h"
 #include "vivid/core/Mesh.h"
 #include "vivid/core/Camera.h"
 #include "vivid/core/Shader.h"
@@ -23,6 +24,10 @@ namespace vivid {
             // Load shaders
             shader_ = ShaderImpl::GetBasicShadingShader();
             helperShader_ = ShaderImpl::GetVertexColoredShader();
+            if (shader_ == nullptr || helperShader_ == nullptr) {
+                std::cerr << "failed to build the shaders!\n";
+                exit(-1);
+            }
 
             // Create color material
             auto material = std::make_shared<BasicColorMaterial>(glm::vec3(1, 0.8, 0.2), nullptr);
@@ -76,7 +81,7 @@ namespace vivid {
 
         void Render() override {
             glClearColor(0.75f, 0.9f, 0.9f, 1.0f);
-            glEnable(GL_DEPTH_TEST);
+            GLStateCache::Instance().Enable(GL_DEPTH_TEST);
             glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
             controls_->Update();
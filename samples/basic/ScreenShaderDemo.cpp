@@ -52,6 +52,10 @@ namespace vivid {
 
             // Load shader
             shader_ = ShaderImpl::GetScreenShader();
+            if (shader_ == nullptr) {
+                std::cerr << "failed to build the shader!\n";
+                exit(-1);
+            }
 
             triangle_ = std::make_shared<Mesh>(triangleGeometry, nullptr);
 
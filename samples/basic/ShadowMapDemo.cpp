@@ -1,5 +1,6 @@
 #include <iostream>
 #include "vivid/Application.h"
+#include "vivid/core/GLStateCache.h"
 #include "vivid/core/Mesh.h"
 #include "vivid/core/Camera.h"
 #include "vivid/core/Shader.h"
@@ -18,12 +19,16 @@ namespace vivid {
     class PrimitivesDemoApp : public Application {
     public:
         PrimitivesDemoApp() : Application(1280, 960, "cube demo") {
-            glEnable(GL_DEPTH_TEST);
+            GLStateCache::Instance().Enable(GL_DEPTH_TEST);
 
             SetWindowResizable(false);
 
             // Load shader
             shader_ = ShaderImpl::LoadShader("./shaders/ShadowMapping.vert", "./shaders/ShadowMapping.frag");
+            if (shader_ == nullptr) {
+                std::cerr << "failed to build the shader!\n";
+                exit(-1);
+            }
 
             // Create airplane
             airplane_ = IOUtil::LoadJsonModel("./models/airplane.json");
@@ -42,6 +47,10 @@ namespace vivid {
             quad_ = std::make_shared<Mesh>(quadGeometry, nullptr);
 
             quadShader_ = ShaderImpl::LoadShader("./shaders/Passthrough.vert", "./shaders/SimpleTexture.frag");
+            if (quadShader_ == nullptr) {
+                std::cerr << "failed to build the shader!\n";
+                exit(-1);
+            }
 
 
             // Camera
@@ -78,16 +87,15 @@ namespace vivid {
             shadow_->RenderDepthMap(castMeshes);
 
             // Render to the screen
-            glBindFramebuffer(GL_FRAMEBUFFER, 0);
-            glViewport(0, 0, windowWidth_, windowHeight_);
+            GLStateCache::Instance().BindFramebuffer(GL_FRAMEBUFFER, 0);
+            GLStateCache::Instance().Viewport(0, 0, windowWidth_, windowHeight_);
             glClearColor(0.75f, 0.9f, 0.9f, 1.0f);
             glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
             // Bind shader
             shader_->Use();
 
-            glActiveTexture(GL_TEXTURE2);
-            glBindTexture(GL_TEXTURE_2D, shadow_->GetDepthMapHandle());
+            GLStateCache::Instance().BindTexture(2, GL_TEXTURE_2D, shadow_->GetDepthMapHandle());
             shader_->SetInt("shadowMap", 2);
 
             glm::mat4 lightCamPV = lightCamera_->GetProjectionMatrix() *lightCamera_->GetViewMatrix();
@@ -100,11 +108,10 @@ namespace vivid {
             // Render the depth texture to the plane
             quadShader_->Use();
 
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, shadow_->GetDepthMapHandle());
+            GLStateCache::Instance().BindTexture(0, GL_TEXTURE_2D, shadow_->GetDepthMapHandle());
             quadShader_->SetInt("myTexture", 0);
 
-            glViewport(0, 0, 256, 256);
+            GLStateCache::Instance().Viewport(0, 0, 256, 256);
             quad_->Draw(nullptr, quadShader_);
 
         }
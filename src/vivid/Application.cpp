@@ -1,5 +1,11 @@
 #include "Application.h"
 #include "Fonts.hpp"
+#include "vivid/core/FrameUniforms.h"
+#include "vivid/core/GLContext.h"
+#include "vivid/core/GLStateCache.h"
+#include "vivid/core/ShaderCache.h"
+#include "vivid/core/ShaderLibrary.h"
+#include "vivid/extras/ShaderImpl.h"
 #include <utility>
 #include <functional>
 
@@ -16,12 +22,22 @@ Application::Application(int windowWidth, int windowHeight, std::string  appName
         exit(-1);
     }
 
-    glEnable(GL_DEPTH_TEST);
+    GLStateCache &gl = GLStateCache::Instance();
+    gl.Enable(GL_DEPTH_TEST);
 
     // This is necessary if we want to change point size when rendering in GL_POINTS mode.
-    glEnable(GL_PROGRAM_POINT_SIZE);
+    gl.Enable(GL_PROGRAM_POINT_SIZE);
 
-    glEnable(GL_MULTISAMPLE);   // enable multi-sampling
+    gl.Enable(GL_MULTISAMPLE);   // enable multi-sampling
+
+    // Compile the built-in shaders in the background, finished by Update(), from cached binaries if possible
+    ShaderCache::LoadProgramBinaryExtension(reinterpret_cast<ShaderCache::ProcLoader>(glfwGetProcAddress));
+    ShaderLibrary::EnableParallelCompile(reinterpret_cast<ShaderLibrary::ProcLoader>(glfwGetProcAddress));
+    ShaderImpl::Precompile();
+
+    int width, height;
+    glfwGetFramebufferSize(window_, &width, &height);
+    FrameUniforms::Default().SetViewport(0, 0, width, height);
 }
 
 
@@ -62,12 +78,16 @@ void Application::Run() {
         Update();
         std::this_thread::sleep_for(std::chrono::milliseconds(1));
     }
+    // GL objects released from now on can't be deleted
+    GLContext::SetAlive(false);
     glfwTerminate();
     std::cout << "Terminate " << appName_ << "\n";
 }
 
 
 void Application::Update() {
+    FrameUniforms::Default().SetTime(static_cast<float>(glfwGetTime()));
+    ShaderLibrary::Default().Poll();
     Render();
     glfwPollEvents();
     glfwSwapBuffers(window_);
@@ -85,7 +105,8 @@ void Application::WindowResizeCallback(int width, int height) {
     windowHeight_ = height;
     // make sure the viewport matches the new window dimensions; note that width and
     // height will be significantly larger than specified on retina displays.
-    glViewport(0, 0, width, height);
+    GLStateCache::Instance().Viewport(0, 0, width, height);
+    FrameUniforms::Default().SetViewport(0, 0, width, height);
 }
 
 
@@ -1,5 +1,6 @@
 #include "UIManager.h"
 #include "vivid/Fonts.hpp"
+#include "vivid/core/GLStateCache.h"
 
 namespace vivid {
 
@@ -100,12 +101,18 @@ void UIManager::NewFrame() {
     ImGui_ImplOpenGL3_NewFrame();
     ImGui_ImplGlfw_NewFrame();
     ImGui::NewFrame();
+
+    // The backend creates its objects on the first frame, binding them directly
+    GLStateCache::Instance().Invalidate();
 }
 
 
 void UIManager::Render() {
     ImGui::Render();
     ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+
+    // ImGui sets the GL state directly
+    GLStateCache::Instance().Invalidate();
 }
 
 
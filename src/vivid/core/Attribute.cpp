@@ -0,0 +1,249 @@
+#include <algorithm>
+#include <cstring>
+#include <glm/gtc/packing.hpp>
+#include "vivid/core/Attribute.h"
+
+namespace vivid {
+
+namespace {
+
+template<typename T>
+void WritePacked(std::vector<unsigned char> &dst, size_t index, T value) {
+    memcpy(dst.data() + index * sizeof(T), &value, sizeof(T));
+}
+
+template<typename T>
+T ReadPacked(const std::vector<unsigned char> &src, size_t index) {
+    T value;
+    memcpy(&value, src.data() + index * sizeof(T), sizeof(T));
+    return value;
+}
+
+} // namespace
+
+
+std::shared_ptr<Attribute> Attribute::CreateQuantized(AttributeType type, int elementsPerItem,
+                                                      ComponentType componentType,
+                                                      const std::vector<float> &data) {
+    // Quantize straight from the input, without an intermediate float copy
+    auto attr = std::make_shared<Attribute>(type, elementsPerItem, false, data.data(), data.size());
+    attr->Quantize(componentType);
+    if (attr->IsFloat()) {
+        // Not quantized (float requested, or a format the item size doesn't fit), own a copy of the data
+        attr->MutableData();
+    }
+    return attr;
+}
+
+
+void Attribute::SetPackedData(ComponentType componentType, bool normalized,
+                              std::vector<unsigned char> &data, bool useMove) {
+    if (componentType == ComponentType::Float) {
+        std::cerr << "Warning: use SetData() for float attributes!\n";
+        return;
+    }
+    componentType_ = componentType;
+    normalized_ = normalized;
+    packedData_ = useMove ? std::move(data) : data;
+    data_.clear();
+    view_ = nullptr;
+    cpuReleased_ = false;
+    MarkDirty();
+}
+
+
+float* Attribute::MutableData() {
+    if (view_ != nullptr) {
+        data_.assign(view_, view_ + viewSize_);
+        view_ = nullptr;
+    }
+    return data_.data();
+}
+
+
+void Attribute::ReleaseCpuData() {
+    if (cpuReleased_) {
+        return;
+    }
+    releasedSize_ = TotalSize();
+    cpuReleased_ = true;
+    std::vector<float>().swap(data_);
+    std::vector<unsigned char>().swap(packedData_);
+    view_ = nullptr;
+    viewSize_ = 0;
+}
+
+
+void Attribute::UpdateItems(int firstItem, const float *data, int itemCount) {
+    if (!IsFloat() || cpuReleased_) {
+        std::cerr << "Warning: UpdateItems() is only supported by float attributes with CPU data!\n";
+        return;
+    }
+    MutableData();
+    const size_t begin = static_cast<size_t>(firstItem) * elementsPerItem_;
+    const size_t count = static_cast<size_t>(itemCount) * elementsPerItem_;
+    if (begin + count > data_.size()) {
+        data_.resize(begin + count);
+    }
+    std::copy(data, data + count, data_.begin() + (long)begin);
+    MarkItemsDirty(firstItem, itemCount);
+}
+
+
+bool Attribute::RemapItems(const std::vector<unsigned int> &remap) {
+    if (cpuReleased_) {
+        std::cerr << "Warning: the CPU data of attribute (" << name_ << ") has been released!\n";
+        return false;
+    }
+    const auto itemCount = static_cast<size_t>(ItemCount());
+    if (remap.size() != itemCount) {
+        std::cerr << "Warning: remap of " << remap.size() << " items for attribute (" << name_ << ") of "
+                  << itemCount << " items!\n";
+        return false;
+    }
+    std::vector<bool> used(itemCount, false);
+    for (unsigned int target : remap) {
+        if (target >= itemCount || used[target]) {
+            std::cerr << "Warning: remap of attribute (" << name_ << ") is not a permutation of its items!\n";
+            return false;
+        }
+        used[target] = true;
+    }
+
+    const size_t itemSize = ItemSize();
+    const auto *src = static_cast<const unsigned char*>(RawData());
+    std::vector<unsigned char> remapped(TotalSize());
+    for (size_t i = 0; i < itemCount; ++i) {
+        memcpy(remapped.data() + remap[i] * itemSize, src + i * itemSize, itemSize);
+    }
+
+    if (IsFloat()) {
+        data_.resize(remapped.size() / sizeof(float));
+        memcpy(data_.data(), remapped.data(), remapped.size());
+        view_ = nullptr;
+        viewSize_ = 0;
+    } else {
+        packedData_ = std::move(remapped);
+    }
+    MarkDirty();
+    return true;
+}
+
+
+void Attribute::MarkItemsDirty(int firstItem, int itemCount) {
+    const size_t begin = firstItem * ItemSize();
+    const size_t end = std::min(begin + itemCount * ItemSize(), TotalSize());
+    if (begin >= end) {
+        return;
+    }
+    // Merge with the range not uploaded yet
+    if (dirtyEnd_ > dirtyBegin_) {
+        dirtyBegin_ = std::min(dirtyBegin_, begin);
+        dirtyEnd_ = std::max(dirtyEnd_, end);
+    } else {
+        dirtyBegin_ = begin;
+        dirtyEnd_ = end;
+    }
+    version_++;
+}
+
+
+void Attribute::Quantize(ComponentType componentType) {
+    if (!IsFloat() || cpuReleased_ || componentType == ComponentType::Float) {
+        return;
+    }
+    const float *data = Data();
+    const size_t floatCount = FloatCount();
+
+    std::vector<unsigned char> packed;
+    if (componentType == ComponentType::Int2_10_10_10_Rev) {
+        if (elementsPerItem_ < 3 || elementsPerItem_ > 4) {
+            std::cerr << "Warning: 10-10-10-2 format requires 3 or 4 elements per item, attribute ("
+                      << name_ << ") is not quantized!\n";
+            return;
+        }
+        const size_t itemCount = floatCount / elementsPerItem_;
+        packed.resize(itemCount * sizeof(uint32_t));
+        for (size_t i = 0; i < itemCount; ++i) {
+            const float *item = &data[i * elementsPerItem_];
+            glm::vec4 v(item[0], item[1], item[2], elementsPerItem_ == 4 ? item[3] : 0.f);
+            WritePacked(packed, i, glm::packSnorm3x10_1x2(v));
+        }
+        elementsPerItem_ = 4;
+    } else {
+        packed.resize(floatCount * ComponentSize(componentType));
+        for (size_t i = 0; i < floatCount; ++i) {
+            const float v = data[i];
+            switch (componentType) {
+                case ComponentType::HalfFloat: WritePacked(packed, i, glm::packHalf1x16(v)); break;
+                case ComponentType::Byte: WritePacked(packed, i, glm::packSnorm1x8(v)); break;
+                case ComponentType::UnsignedByte: WritePacked(packed, i, glm::packUnorm1x8(v)); break;
+                case ComponentType::Short: WritePacked(packed, i, glm::packSnorm1x16(v)); break;
+                case ComponentType::UnsignedShort: WritePacked(packed, i, glm::packUnorm1x16(v)); break;
+                default: break;
+            }
+        }
+    }
+
+    // Half floats keep their value, integer types are normalized to [-1, 1] or [0, 1] by GL.
+    normalized_ = componentType != ComponentType::HalfFloat;
+    componentType_ = componentType;
+    packedData_ = std::move(packed);
+    std::vector<float>().swap(data_);
+    view_ = nullptr;
+    viewSize_ = 0;
+    MarkDirty();
+}
+
+
+std::vector<float> Attribute::ToFloat() const {
+    if (cpuReleased_) {
+        return {};
+    }
+    if (IsFloat()) {
+        return std::vector<float>(Data(), Data() + FloatCount());
+    }
+
+    std::vector<float> result;
+    const size_t elementCount = ElementCount();
+    result.reserve(elementCount);
+    if (componentType_ == ComponentType::Int2_10_10_10_Rev) {
+        for (size_t i = 0; i < elementCount / 4; ++i) {
+            glm::vec4 v = glm::unpackSnorm3x10_1x2(ReadPacked<uint32_t>(packedData_, i));
+            result.insert(result.end(), {v.x, v.y, v.z, v.w});
+        }
+        return result;
+    }
+
+    for (size_t i = 0; i < elementCount; ++i) {
+        switch (componentType_) {
+            case ComponentType::HalfFloat:
+                result.push_back(glm::unpackHalf1x16(ReadPacked<uint16_t>(packedData_, i)));
+                break;
+            case ComponentType::Byte: {
+                auto v = ReadPacked<uint8_t>(packedData_, i);
+                result.push_back(normalized_ ? glm::unpackSnorm1x8(v) : (float)(int8_t)v);
+                break;
+            }
+            case ComponentType::UnsignedByte: {
+                auto v = ReadPacked<uint8_t>(packedData_, i);
+                result.push_back(normalized_ ? glm::unpackUnorm1x8(v) : (float)v);
+                break;
+            }
+            case ComponentType::Short: {
+                auto v = ReadPacked<uint16_t>(packedData_, i);
+                result.push_back(normalized_ ? glm::unpackSnorm1x16(v) : (float)(int16_t)v);
+                break;
+            }
+            case ComponentType::UnsignedShort: {
+                auto v = ReadPacked<uint16_t>(packedData_, i);
+                result.push_back(normalized_ ? glm::unpackUnorm1x16(v) : (float)v);
+                break;
+            }
+            default: break;
+        }
+    }
+    return result;
+}
+
+} // namespace vivid
@@ -5,6 +5,9 @@
 #include <vector>
 #include <map>
 #include <memory>
+#include <type_traits>
+#include <Eigen/Core>
+#include "BufferPool.h"
 
 
 namespace vivid {
@@ -43,6 +46,40 @@ static std::string AttributeName(const AttributeType& type) {
 };
 
 
+// How often the data of an attribute is expected to change.
+enum class BufferUsage : int {
+    Static = 0,     // set once, drawn many times
+    Dynamic,        // modified from time to time
+    Stream          // rewritten every frame, uploaded through a ring buffer to avoid stalls
+};
+
+
+// Data type of the elements stored in a vertex buffer.
+enum class ComponentType : int {
+    Float = 0,
+    HalfFloat,          // 16-bit float
+    Byte,               // int8, normalized to [-1, 1] when quantized
+    UnsignedByte,       // uint8, normalized to [0, 1] when quantized, e.g. colors
+    Short,              // int16, normalized to [-1, 1] when quantized
+    UnsignedShort,      // uint16, normalized to [0, 1] when quantized
+    Int2_10_10_10_Rev   // xyz as signed 10-bit + w as signed 2-bit packed in 32 bits, e.g. normals
+};
+
+// Size in bytes of a single component. The packed 10-10-10-2 format stores a whole item in 4 bytes.
+static size_t ComponentSize(ComponentType type) {
+    switch (type) {
+        case ComponentType::Float: return 4;
+        case ComponentType::HalfFloat: return 2;
+        case ComponentType::Byte: return 1;
+        case ComponentType::UnsignedByte: return 1;
+        case ComponentType::Short: return 2;
+        case ComponentType::UnsignedShort: return 2;
+        case ComponentType::Int2_10_10_10_Rev: return 4;
+        default: return 4;
+    }
+}
+
+
 /* Element: a single number.
  * Item: a struct composed of several numbers. For example, a 3D point is an item composed of 3 elements: x, y, z .
  */
@@ -56,8 +93,49 @@ public:
         if (data != nullptr) {
             data_ = (*data);
         }
+        MarkDirty();
     }
 
+    // Take over the data without copying it.
+    Attribute(AttributeType type, int elementsPerItem, bool normalized, std::vector<float> &&data)
+        : type_(type), elementsPerItem_(elementsPerItem), normalized_(normalized), data_(std::move(data))
+    {
+        name_ = AttributeName(type);
+        MarkDirty();
+    }
+
+    // Non-owning view of `elementCount` floats. The caller keeps the data alive until it has been
+    // uploaded and released (see SetKeepCpuData), or for the whole lifetime of the attribute otherwise.
+    Attribute(AttributeType type, int elementsPerItem, bool normalized, const float *data, size_t elementCount)
+        : type_(type), elementsPerItem_(elementsPerItem), normalized_(normalized),
+          view_(data), viewSize_(elementCount)
+    {
+        name_ = AttributeName(type);
+        MarkDirty();
+    }
+
+    // Non-owning view of a column-major Eigen matrix or map, one item per column, e.g. Eigen::Matrix3Xf.
+    template<typename Derived>
+    static std::shared_ptr<Attribute> CreateView(AttributeType type, const Eigen::DenseBase<Derived> &m,
+                                                 bool normalized = false) {
+        static_assert(std::is_same<typename Derived::Scalar, float>::value, "Only float matrices are supported");
+        static_assert(!Derived::IsRowMajor || Derived::ColsAtCompileTime == 1, "Only column-major matrices are supported");
+        const Derived &d = m.derived();
+        if (d.innerStride() != 1 || d.outerStride() != d.rows()) {
+            std::cerr << "Warning: the matrix is not contiguous, its data is copied into the attribute!\n";
+            std::vector<float> data(d.size());
+            Eigen::Map<Eigen::MatrixXf>(data.data(), d.rows(), d.cols()) = d;
+            return std::make_shared<Attribute>(type, (int)d.rows(), normalized, std::move(data));
+        }
+        return std::make_shared<Attribute>(type, (int)d.rows(), normalized, d.data(), (size_t)d.size());
+    }
+
+    // Create an attribute whose data is quantized on ingest, the float data is not retained. If it can't be
+    // quantized to componentType, the attribute keeps a float copy.
+    static std::shared_ptr<Attribute> CreateQuantized(AttributeType type, int elementsPerItem,
+                                                      ComponentType componentType,
+                                                      const std::vector<float> &data);
+
     inline AttributeType Type() const { return type_; }
 
     inline std::string Name() const { return name_; }
@@ -68,47 +146,175 @@ public:
     // Is normalized or not?
     inline bool Normalized() const { return normalized_; }
 
+    // Data type of each element
+    inline ComponentType GetComponentType() const { return componentType_; }
+
+    // Expected update frequency, must be set before the first draw.
+    inline BufferUsage Usage() const { return usage_; }
+    inline void SetUsage(BufferUsage usage) { usage_ = usage; }
+
+    inline bool IsFloat() const { return componentType_ == ComponentType::Float; }
+
     // Get the number of items in this attribute
     inline int ItemCount() const {
-        return static_cast<int>(data_.size()) / elementsPerItem_;
+        return static_cast<int>(TotalSize() / ItemSize());
     }
 
     // Get the number of elements
     inline int ElementCount() const {
-        return static_cast<int>(data_.size());
+        return ItemCount() * elementsPerItem_;
     }
 
     inline size_t ItemSize() const {
-        return elementsPerItem_ * sizeof(float);
+        if (componentType_ == ComponentType::Int2_10_10_10_Rev) {
+            return ComponentSize(componentType_);
+        }
+        return elementsPerItem_ * ComponentSize(componentType_);
     }
 
     inline size_t TotalSize() const {
-        return data_.size() * sizeof(float);
+        if (cpuReleased_) {
+            return releasedSize_;
+        }
+        return IsFloat() ? FloatCount() * sizeof(float) : packedData_.size();
     }
 
+    // Set float data, the attribute becomes a float attribute.
     inline void SetData(std::vector<float> &data, bool useMove = false) {
         data_ = useMove ? std::move(data) : data;
+        componentType_ = ComponentType::Float;
+        packedData_.clear();
+        view_ = nullptr;
+        cpuReleased_ = false;
+        MarkDirty();
     }
 
+    // Owned float data, empty if the attribute is quantized, a view or released.
     inline const std::vector<float>& GetData() const {
         return data_;
     }
 
-    // Vertex buffer object handle
-    inline unsigned int VBO() const { return vbo_; }
-    inline void SetVBO(unsigned int vbo) { vbo_ = vbo; }
+    // Float data, owned or viewed. Null if the attribute is quantized or released.
+    inline const float* Data() const {
+        if (!IsFloat() || cpuReleased_) {
+            return nullptr;
+        }
+        return view_ != nullptr ? view_ : data_.data();
+    }
+
+    // Overwrite `itemCount` float items starting at `firstItem`. Only this range is uploaded on the next draw.
+    void UpdateItems(int firstItem, const float *data, int itemCount);
+
+    // Writable float data, a view is copied first. Call MarkItemsDirty() after modifying it,
+    // otherwise the change won't reach GPU.
+    float* MutableData();
+
+    // Move item i to position remap[i], e.g. after reordering the vertices of a geometry. remap must be a
+    // permutation of the items. Return false, leaving the data as is, if it isn't or the CPU data has been
+    // released.
+    bool RemapItems(const std::vector<unsigned int> &remap);
+
+    // Mark a range of items as modified
+    void MarkItemsDirty(int firstItem, int itemCount);
+
+    // Mark all the data as modified
+    inline void MarkDirty() {
+        version_++;
+        dirtyBegin_ = 0;
+        dirtyEnd_ = TotalSize();
+    }
+
+    // Set already quantized data, stored as it is.
+    void SetPackedData(ComponentType componentType, bool normalized,
+                       std::vector<unsigned char> &data, bool useMove = false);
+
+    // Quantized data, empty if the attribute is a float attribute.
+    inline const std::vector<unsigned char>& GetPackedData() const {
+        return packedData_;
+    }
+
+    // Pointer to the data in its storage format, used for uploading to GPU.
+    inline const void* RawData() const {
+        if (cpuReleased_) {
+            return nullptr;
+        }
+        return IsFloat() ? static_cast<const void*>(Data()) : static_cast<const void*>(packedData_.data());
+    }
+
+    // Keep the CPU copy after uploading to GPU? If not, the data is released once uploaded and
+    // the attribute becomes GPU only until new data is set.
+    inline bool KeepCpuData() const { return keepCpuData_; }
+    inline void SetKeepCpuData(bool keep) { keepCpuData_ = keep; }
+
+    // Drop the CPU copy (or the view), the item count is preserved for drawing.
+    void ReleaseCpuData();
+
+    inline bool HasCpuData() const { return !cpuReleased_; }
+
+    // Convert the float data to the given component type and release the float data.
+    // Integer types are normalized, so the input is expected in [-1, 1] (signed) or [0, 1] (unsigned).
+    // The 10-10-10-2 format always stores 4 elements per item, with w set to zero if absent.
+    void Quantize(ComponentType componentType);
+
+    // Decode the data to floats, whatever the storage format is.
+    std::vector<float> ToFloat() const;
+
+    // Incremented every time the data changes.
+    inline unsigned int Version() const { return version_; }
+
+    // Does the GPU copy lag behind the CPU data?
+    inline bool NeedsUpload() const { return uploadedVersion_ != version_; }
+
+    // Byte range modified since the last upload.
+    inline size_t DirtyOffset() const { return dirtyBegin_; }
+    inline size_t DirtySize() const { return dirtyEnd_ > dirtyBegin_ ? dirtyEnd_ - dirtyBegin_ : 0; }
+
+    // Called after the dirty range has been uploaded.
+    inline void MarkUploaded() {
+        uploadedVersion_ = version_;
+        dirtyBegin_ = dirtyEnd_ = 0;
+    }
+
+    // Vertex buffer object handle, and the byte offset of the data in it
+    inline unsigned int VBO() const { return gpuBuffer_.Handle(); }
+    inline size_t VBOOffset() const { return gpuBuffer_.Offset(); }
+
+    // GPU storage, released with the attribute
+    inline BufferRange& GpuBuffer() { return gpuBuffer_; }
 
 private:
+    inline size_t FloatCount() const {
+        return view_ != nullptr ? viewSize_ : data_.size();
+    }
+
     AttributeType type_;
     int elementsPerItem_;
     bool normalized_;
+    ComponentType componentType_ = ComponentType::Float;
+    BufferUsage usage_ = BufferUsage::Static;
 
     std::string name_;
 
     std::vector<float> data_;
+    std::vector<unsigned char> packedData_;
+
+    // Non-owning float data
+    const float *view_ = nullptr;
+    size_t viewSize_ = 0;
+
+    // GPU only data
+    bool keepCpuData_ = true;
+    bool cpuReleased_ = false;
+    size_t releasedSize_ = 0;
+
+    // Modification tracking
+    unsigned int version_ = 0;
+    unsigned int uploadedVersion_ = 0;
+    size_t dirtyBegin_ = 0;
+    size_t dirtyEnd_ = 0;
 
-    // Vertex buffer object handle
-    unsigned int vbo_ = 0;
+    // Vertex buffer object
+    BufferRange gpuBuffer_;
 };
 
 using AttributePtr = std::shared_ptr<Attribute>;
@@ -0,0 +1,310 @@
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <numeric>
+#include "vivid/core/BVH.h"
+#include "vivid/utils/JobSystem.h"
+#include "vivid/utils/Parallel.h"
+
+namespace vivid {
+
+static constexpr int kBinCount = 16;
+static constexpr uint32_t kMaxLeafSize = 8;
+// Nodes with fewer primitives are built on the calling thread
+static constexpr uint32_t kParallelThreshold = 1 << 14;
+
+
+// Half of the surface area of a box, zero if it is empty
+static inline float HalfArea(const BoundingBox &box) {
+    if (box.IsEmpty()) {
+        return 0.f;
+    }
+    const Eigen::Vector3f e = box.max - box.min;
+    return e.x() * e.y() + e.y() * e.z() + e.z() * e.x();
+}
+
+
+struct BVH::BuildContext {
+    const std::vector<BoundingBox> &boxes;
+    std::vector<Eigen::Vector3f> centroids;
+    std::atomic<uint32_t> nodeCount{1};
+
+    explicit BuildContext(const std::vector<BoundingBox> &boxes) : boxes(boxes) {}
+};
+
+
+namespace {
+
+struct Bin {
+    BoundingBox box;
+    uint32_t count = 0;
+};
+
+using Bins = std::array<std::array<Bin, kBinCount>, 3>;
+
+// Bounds of the boxes and of their centroids, for the primitives [begin, end) of `primitives`
+struct RangeBounds {
+    BoundingBox box;
+    BoundingBox centroids;
+
+    void Expand(const RangeBounds &other) {
+        box.Expand(other.box);
+        centroids.Expand(other.centroids);
+    }
+};
+
+} // namespace
+
+
+void BVH::Build(const std::vector<BoundingBox> &boxes) {
+    nodes_.clear();
+    boxes_.clear();
+    primitives_.resize(boxes.size());
+    std::iota(primitives_.begin(), primitives_.end(), 0u);
+    if (boxes.empty()) {
+        return;
+    }
+
+    BuildContext ctx(boxes);
+    ctx.centroids.resize(boxes.size());
+    ParallelFor(0, boxes.size(), kParallelThreshold, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            ctx.centroids[i] = boxes[i].Center();
+        }
+    });
+    nodes_.resize(2 * boxes.size() - 1);
+    BuildNode(ctx, 0, 0, static_cast<uint32_t>(boxes.size()), 0);
+    nodes_.resize(ctx.nodeCount.load());
+
+    // Primitive boxes in leaf order, for the overlap queries and for locality
+    boxes_.resize(boxes.size());
+    for (size_t i = 0; i < primitives_.size(); ++i) {
+        boxes_[i] = boxes[primitives_[i]];
+    }
+}
+
+
+void BVH::BuildNode(BuildContext &ctx, uint32_t nodeIndex, uint32_t begin, uint32_t end, int depth) {
+    const uint32_t count = end - begin;
+    // The root is binned on all the threads, the subtrees of large nodes are built as separate jobs
+    const bool parallel = count >= kParallelThreshold;
+    const bool parallelBinning = parallel && depth == 0;
+    std::mutex mutex;
+
+    // Bounds of the node and of the centroids
+    RangeBounds bounds;
+    auto boundRange = [&](size_t first, size_t last) {
+        RangeBounds chunk;
+        for (size_t i = first; i < last; ++i) {
+            const uint32_t p = primitives_[i];
+            chunk.box.Expand(ctx.boxes[p]);
+            chunk.centroids.Expand(ctx.centroids[p]);
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        bounds.Expand(chunk);
+    };
+    if (parallelBinning) {
+        ParallelFor(begin, end, kParallelThreshold, boundRange);
+    } else {
+        boundRange(begin, end);
+    }
+
+    Node &node = nodes_[nodeIndex];
+    node.min = bounds.box.min;
+    node.max = bounds.box.max;
+    auto makeLeaf = [&]() {
+        node.first = begin;
+        node.count = count;
+    };
+    if (count <= 2 || depth >= kMaxDepth) {
+        makeLeaf();
+        return;
+    }
+
+    // Bin the centroids along the 3 axes
+    const Eigen::Vector3f cmin = bounds.centroids.min;
+    const Eigen::Vector3f extent = bounds.centroids.max - cmin;
+    const Eigen::Vector3f scale = (extent.array() > 0.f).select(kBinCount / extent.array(), 0.f);
+    auto binOf = [&](uint32_t p, int axis) {
+        return std::min(kBinCount - 1, static_cast<int>((ctx.centroids[p][axis] - cmin[axis]) * scale[axis]));
+    };
+
+    Bins bins;
+    auto binRange = [&](size_t first, size_t last) {
+        Bins chunk;
+        for (size_t i = first; i < last; ++i) {
+            const uint32_t p = primitives_[i];
+            for (int axis = 0; axis < 3; ++axis) {
+                Bin &bin = chunk[axis][binOf(p, axis)];
+                bin.box.Expand(ctx.boxes[p]);
+                bin.count++;
+            }
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        for (int axis = 0; axis < 3; ++axis) {
+            for (int b = 0; b < kBinCount; ++b) {
+                bins[axis][b].box.Expand(chunk[axis][b].box);
+                bins[axis][b].count += chunk[axis][b].count;
+            }
+        }
+    };
+    if (parallelBinning) {
+        ParallelFor(begin, end, kParallelThreshold, binRange);
+    } else {
+        binRange(begin, end);
+    }
+
+    // Sweep the split planes between the bins. The cost of a split is the number of primitives on each
+    // side weighted by the area of its bounds, relative to the area of the node.
+    float bestCost = std::numeric_limits<float>::max();
+    int bestAxis = -1, bestSplit = 0;
+    for (int axis = 0; axis < 3; ++axis) {
+        if (extent[axis] <= 0.f) {
+            continue;
+        }
+        std::array<float, kBinCount> leftCost{};
+        BoundingBox left;
+        uint32_t leftCount = 0;
+        for (int b = 0; b < kBinCount - 1; ++b) {
+            left.Expand(bins[axis][b].box);
+            leftCount += bins[axis][b].count;
+            leftCost[b] = HalfArea(left) * static_cast<float>(leftCount);
+        }
+        BoundingBox right;
+        uint32_t rightCount = 0;
+        for (int b = kBinCount - 1; b > 0; --b) {
+            right.Expand(bins[axis][b].box);
+            rightCount += bins[axis][b].count;
+            const float cost = leftCost[b - 1] + HalfArea(right) * static_cast<float>(rightCount);
+            if (cost < bestCost) {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = b;
+            }
+        }
+    }
+
+    // A leaf costs one intersection per primitive, a split one traversal step plus its children
+    const float nodeArea = HalfArea(bounds.box);
+    const float leafCost = static_cast<float>(count) * nodeArea;
+    const bool splitWorthIt = bestAxis >= 0 && nodeArea + bestCost < leafCost;
+    if (!splitWorthIt && count <= kMaxLeafSize) {
+        makeLeaf();
+        return;
+    }
+
+    uint32_t mid = begin + count / 2;
+    if (bestAxis >= 0) {
+        auto it = std::partition(primitives_.begin() + begin, primitives_.begin() + end,
+                                 [&](uint32_t p) { return binOf(p, bestAxis) < bestSplit; });
+        mid = static_cast<uint32_t>(it - primitives_.begin());
+    }
+    if (mid == begin || mid == end) {
+        // All the centroids coincide: any split does, in the middle
+        mid = begin + count / 2;
+    }
+
+    const uint32_t leftChild = ctx.nodeCount.fetch_add(2);
+    node.first = leftChild;
+    node.count = 0;
+    if (parallel) {
+        JobSystem &jobs = JobSystem::Instance();
+        JobGroup group;
+        jobs.Run(group, [&, leftChild] { BuildNode(ctx, leftChild, begin, mid, depth + 1); });
+        BuildNode(ctx, leftChild + 1, mid, end, depth + 1);
+        jobs.Wait(group);
+    } else {
+        BuildNode(ctx, leftChild, begin, mid, depth + 1);
+        BuildNode(ctx, leftChild + 1, mid, end, depth + 1);
+    }
+}
+
+
+void BVH::Refit(const std::vector<BoundingBox> &boxes) {
+    if (boxes.size() != primitives_.size()) {
+        std::cerr << "Warning: the BVH is refitted with " << boxes.size() << " boxes instead of "
+                  << primitives_.size() << "!\n";
+        return;
+    }
+    for (size_t i = 0; i < primitives_.size(); ++i) {
+        boxes_[i] = boxes[primitives_[i]];
+    }
+
+    // Children are allocated after their parent, so a reverse pass sees them first
+    for (size_t n = nodes_.size(); n-- > 0; ) {
+        Node &node = nodes_[n];
+        BoundingBox box;
+        if (node.IsLeaf()) {
+            for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+                box.Expand(boxes_[i]);
+            }
+        } else {
+            box = BoundingBox(nodes_[node.first].min, nodes_[node.first].max);
+            box.Expand(BoundingBox(nodes_[node.first + 1].min, nodes_[node.first + 1].max));
+        }
+        node.min = box.min;
+        node.max = box.max;
+    }
+}
+
+
+BoundingBox BVH::Bounds() const {
+    if (nodes_.empty()) {
+        return {};
+    }
+    return {nodes_[0].min, nodes_[0].max};
+}
+
+
+// Visit the primitives whose box passes `overlaps`, pruning the nodes that don't.
+template<typename Overlaps>
+static void QueryNodes(const std::vector<BVH::Node> &nodes, const std::vector<BoundingBox> &boxes,
+                       const std::vector<uint32_t> &primitives, Overlaps &&overlaps,
+                       std::vector<uint32_t> &result) {
+    result.clear();
+    if (nodes.empty()) {
+        return;
+    }
+    uint32_t stack[BVH::kMaxDepth + 2];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const BVH::Node &node = nodes[stack[--top]];
+        if (!overlaps(node.min, node.max)) {
+            continue;
+        }
+        if (node.IsLeaf()) {
+            for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+                if (overlaps(boxes[i].min, boxes[i].max)) {
+                    result.push_back(primitives[i]);
+                }
+            }
+        } else {
+            stack[top++] = node.first + 1;
+            stack[top++] = node.first;
+        }
+    }
+}
+
+
+void BVH::Query(const BoundingBox &box, std::vector<uint32_t> &result) const {
+    QueryNodes(nodes_, boxes_, primitives_, [&box](const Eigen::Vector3f &min, const Eigen::Vector3f &max) {
+        return (min.array() <= box.max.array()).all() && (max.array() >= box.min.array()).all();
+    }, result);
+}
+
+
+void BVH::Query(const BoundingSphere &sphere, std::vector<uint32_t> &result) const {
+    if (sphere.IsEmpty()) {
+        result.clear();
+        return;
+    }
+    const float r2 = sphere.radius * sphere.radius;
+    QueryNodes(nodes_, boxes_, primitives_, [&](const Eigen::Vector3f &min, const Eigen::Vector3f &max) {
+        // Squared distance from the center to the closest point of the box
+        const Eigen::Vector3f closest = sphere.center.cwiseMax(min).cwiseMin(max);
+        return (closest - sphere.center).squaredNorm() <= r2;
+    }, result);
+}
+
+} // namespace vivid
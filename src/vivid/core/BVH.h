@@ -0,0 +1,134 @@
+#pragma once
+
+#include <iostream>
+#include <algorithm>
+#include <array>
+#include <utility>
+#include <limits>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <Eigen/Dense>
+#include "vivid/core/Bounds.h"
+
+namespace vivid {
+
+/* Bounding volume hierarchy over a set of axis-aligned boxes, e.g. the triangles of a mesh or the objects
+ * of a scene. Primitives are referred to by their index in the boxes given to Build().
+ *
+ * The builder splits nodes with the surface area heuristic evaluated on 16 bins per axis, and builds the
+ * subtrees of large nodes as parallel jobs. Refit() updates the bounds of the nodes after the primitives
+ * moved, without changing the tree, which is fine as long as the primitives move coherently.
+ */
+class BVH {
+public:
+    struct Node {
+        Eigen::Vector3f min;
+        Eigen::Vector3f max;
+        uint32_t first;     // first primitive of a leaf, left child of an inner node (the right one follows it)
+        uint32_t count;     // primitive count of a leaf, 0 for an inner node
+
+        inline bool IsLeaf() const { return count > 0; }
+    };
+
+    BVH() = default;
+
+    void Build(const std::vector<BoundingBox> &boxes);
+
+    // Update the node bounds from the new boxes of the same primitives.
+    void Refit(const std::vector<BoundingBox> &boxes);
+
+    inline bool Empty() const { return nodes_.empty(); }
+
+    inline const std::vector<Node>& Nodes() const { return nodes_; }
+
+    // Primitive indices, in leaf order: leaf nodes refer to ranges of this array.
+    inline const std::vector<uint32_t>& Primitives() const { return primitives_; }
+
+    // Bounds of the whole hierarchy
+    BoundingBox Bounds() const;
+
+    // Indices of the primitives whose box overlaps the box or sphere.
+    void Query(const BoundingBox &box, std::vector<uint32_t> &result) const;
+    void Query(const BoundingSphere &sphere, std::vector<uint32_t> &result) const;
+
+    /* Visit the leaves hit by the ray closer than tMax, nearest child first. intersect(primitive, tMax)
+     * tests a primitive and returns true if it is hit closer than tMax, after lowering tMax to the hit
+     * distance, which prunes the farther nodes. Return true if any primitive was hit.
+     */
+    template<typename Intersect>
+    bool Raycast(const Ray &ray, float &tMax, Intersect &&intersect) const;
+
+    // Nodes deeper than this are leaves, whatever their primitive count
+    static constexpr int kMaxDepth = 48;
+
+private:
+    struct BuildContext;
+
+    void BuildNode(BuildContext &ctx, uint32_t nodeIndex, uint32_t begin, uint32_t end, int depth);
+
+    // Ray parameter where the ray enters the node, infinity if it misses it or enters beyond tMax
+    static inline float EnterDistance(const Node &node, const Eigen::Vector3f &origin,
+                                      const Eigen::Vector3f &invDir, float tMax) {
+        const Eigen::Array3f t0 = (node.min - origin).array() * invDir.array();
+        const Eigen::Array3f t1 = (node.max - origin).array() * invDir.array();
+        const float tEnter = std::max(t0.min(t1).maxCoeff(), 0.f);
+        const float tExit = std::min(t0.max(t1).minCoeff(), tMax);
+        return tEnter <= tExit ? tEnter : std::numeric_limits<float>::infinity();
+    }
+
+    std::vector<Node> nodes_;
+    std::vector<uint32_t> primitives_;
+    std::vector<BoundingBox> boxes_;    // box of each primitive, in leaf order
+};
+
+
+template<typename Intersect>
+bool BVH::Raycast(const Ray &ray, float &tMax, Intersect &&intersect) const {
+    if (nodes_.empty()) {
+        return false;
+    }
+    const Eigen::Vector3f invDir = ray.direction.cwiseInverse();
+    constexpr float kInf = std::numeric_limits<float>::infinity();
+    if (EnterDistance(nodes_[0], ray.origin, invDir, tMax) == kInf) {
+        return false;
+    }
+
+    // Nodes to visit and their entry distance, skipped if a closer hit was found meanwhile.
+    // The depth of the tree is bounded by the builder.
+    bool hit = false;
+    std::pair<uint32_t, float> stack[2 * kMaxDepth + 2];
+    int top = 0;
+    stack[top++] = {0, 0.f};
+    while (top > 0) {
+        const auto entry = stack[--top];
+        if (entry.second > tMax) {
+            continue;
+        }
+        const Node &node = nodes_[entry.first];
+        if (node.IsLeaf()) {
+            for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+                hit |= intersect(primitives_[i], tMax);
+            }
+            continue;
+        }
+
+        // Push the farther child first, so that the nearer one is visited first
+        uint32_t near = node.first, far = node.first + 1;
+        float tNear = EnterDistance(nodes_[near], ray.origin, invDir, tMax);
+        float tFar = EnterDistance(nodes_[far], ray.origin, invDir, tMax);
+        if (tFar < tNear) {
+            std::swap(near, far);
+            std::swap(tNear, tFar);
+        }
+        if (tFar != kInf) {
+            stack[top++] = {far, tFar};
+        }
+        if (tNear != kInf) {
+            stack[top++] = {near, tNear};
+        }
+    }
+    return hit;
+}
+
+} // namespace vivid
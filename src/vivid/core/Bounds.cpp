@@ -0,0 +1,101 @@
+#include <cmath>
+#include <algorithm>
+#include <mutex>
+#include "vivid/core/Bounds.h"
+#include "vivid/utils/Parallel.h"
+
+namespace vivid {
+
+BoundingBox BoundingBox::Transformed(const Eigen::Matrix4f &m) const {
+    if (IsEmpty()) {
+        return {};
+    }
+    const Eigen::Array33f a = m.topLeftCorner<3, 3>().array();
+    const Eigen::Array3f t = m.topRightCorner<3, 1>().array();
+    // a(i, j) * min(j) and a(i, j) * max(j) bound the contribution of axis j to axis i
+    const Eigen::Array33f lo = a.rowwise() * min.array().transpose();
+    const Eigen::Array33f hi = a.rowwise() * max.array().transpose();
+    return {t + lo.min(hi).rowwise().sum(), t + lo.max(hi).rowwise().sum()};
+}
+
+
+BoundingSphere BoundingSphere::Transformed(const Eigen::Matrix4f &m) const {
+    if (IsEmpty()) {
+        return {};
+    }
+    const Eigen::Matrix3f a = m.topLeftCorner<3, 3>();
+    const float scale = std::sqrt(a.colwise().squaredNorm().maxCoeff());
+    return {a * center + m.topRightCorner<3, 1>(), radius * scale};
+}
+
+
+// Size of the chunks processed by a thread
+static constexpr size_t kGrainSize = 1 << 16;
+
+
+// Min/max of the items [begin, end). Groups of 4 items are mapped as the columns of a 4*stride matrix, so that
+// the row-wise reductions run on whole SIMD registers, then the 4 lanes of each coordinate are folded.
+static void MinMaxItems(const float *data, size_t stride, size_t begin, size_t end,
+                        Eigen::Vector3f &lo, Eigen::Vector3f &hi) {
+    const auto dims = static_cast<Eigen::Index>(std::min<size_t>(stride, 3));
+    const size_t groupCount = (end - begin) / 4;
+    if (groupCount > 0) {
+        const auto rows = static_cast<Eigen::Index>(4 * stride);
+        Eigen::Map<const Eigen::ArrayXXf> groups(data + begin * stride, rows, static_cast<Eigen::Index>(groupCount));
+        const Eigen::ArrayXf groupMin = groups.rowwise().minCoeff();
+        const Eigen::ArrayXf groupMax = groups.rowwise().maxCoeff();
+        for (size_t i = 0; i < 4; ++i) {
+            const auto first = static_cast<Eigen::Index>(i * stride);
+            lo.head(dims) = lo.head(dims).cwiseMin(groupMin.segment(first, dims).matrix());
+            hi.head(dims) = hi.head(dims).cwiseMax(groupMax.segment(first, dims).matrix());
+        }
+    }
+    for (size_t i = begin + groupCount * 4; i < end; ++i) {
+        Eigen::Map<const Eigen::VectorXf> p(data + i * stride, dims);
+        lo.head(dims) = lo.head(dims).cwiseMin(p);
+        hi.head(dims) = hi.head(dims).cwiseMax(p);
+    }
+}
+
+
+BoundingBox ComputeBoundingBox(const float *data, size_t stride, size_t itemCount) {
+    BoundingBox box;
+    if (data == nullptr || stride == 0 || itemCount == 0) {
+        return box;
+    }
+    std::mutex mutex;
+    ParallelFor(0, itemCount, kGrainSize, [&](size_t begin, size_t end) {
+        BoundingBox chunk;
+        MinMaxItems(data, stride, begin, end, chunk.min, chunk.max);
+        std::lock_guard<std::mutex> lock(mutex);
+        box.Expand(chunk);
+    });
+    // Missing coordinates are zero
+    for (auto i = static_cast<Eigen::Index>(stride); i < 3; ++i) {
+        box.min[i] = box.max[i] = 0.f;
+    }
+    return box;
+}
+
+
+BoundingSphere ComputeBoundingSphere(const float *data, size_t stride, size_t itemCount,
+                                     const Eigen::Vector3f &center) {
+    if (data == nullptr || stride == 0 || itemCount == 0) {
+        return {};
+    }
+    const auto dims = static_cast<Eigen::Index>(std::min<size_t>(stride, 3));
+    // Missing coordinates are zero, they add a constant to the squared distances
+    const float missing = center.tail(3 - dims).squaredNorm();
+    float maxSquaredDistance = 0.f;
+    std::mutex mutex;
+    ParallelFor(0, itemCount, kGrainSize, [&](size_t begin, size_t end) {
+        Eigen::Map<const Eigen::MatrixXf> items(data + begin * stride, static_cast<Eigen::Index>(stride),
+                                                static_cast<Eigen::Index>(end - begin));
+        const float d = (items.topRows(dims).colwise() - center.head(dims)).colwise().squaredNorm().maxCoeff();
+        std::lock_guard<std::mutex> lock(mutex);
+        maxSquaredDistance = std::max(maxSquaredDistance, d);
+    });
+    return {center, std::sqrt(maxSquaredDistance + missing)};
+}
+
+} // namespace vivid
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <limits>
+#include <Eigen/Dense>
+
+namespace vivid {
+
+// Axis-aligned bounding box, empty (min > max) by default.
+struct BoundingBox {
+    Eigen::Vector3f min = Eigen::Vector3f::Constant(std::numeric_limits<float>::max());
+    Eigen::Vector3f max = Eigen::Vector3f::Constant(std::numeric_limits<float>::lowest());
+
+    BoundingBox() = default;
+
+    BoundingBox(const Eigen::Vector3f &min, const Eigen::Vector3f &max) : min(min), max(max) {}
+
+    inline bool IsEmpty() const { return (min.array() > max.array()).any(); }
+
+    inline Eigen::Vector3f Center() const { return 0.5f * (min + max); }
+
+    // Half of the size along each axis
+    inline Eigen::Vector3f Extents() const { return 0.5f * (max - min); }
+
+    inline void Expand(const Eigen::Vector3f &p) {
+        min = min.cwiseMin(p);
+        max = max.cwiseMax(p);
+    }
+
+    inline void Expand(const BoundingBox &box) {
+        min = min.cwiseMin(box.min);
+        max = max.cwiseMax(box.max);
+    }
+
+    inline bool Contains(const Eigen::Vector3f &p) const {
+        return (p.array() >= min.array()).all() && (p.array() <= max.array()).all();
+    }
+
+    // Box of the transformed box, from the 3x3 part and translation of m only (Arvo's method):
+    // no corner is transformed, each axis of the result sums the min/max contributions of the rows.
+    BoundingBox Transformed(const Eigen::Matrix4f &m) const;
+};
+
+
+// Bounding sphere, empty (negative radius) by default.
+struct BoundingSphere {
+    Eigen::Vector3f center = Eigen::Vector3f::Zero();
+    float radius = -1.f;
+
+    BoundingSphere() = default;
+
+    BoundingSphere(const Eigen::Vector3f &center, float radius) : center(center), radius(radius) {}
+
+    inline bool IsEmpty() const { return radius < 0.f; }
+
+    // Sphere enclosing the transformed sphere, scaled by the largest axis scale of m.
+    BoundingSphere Transformed(const Eigen::Matrix4f &m) const;
+};
+
+
+// Half-line origin + t * direction, t >= 0. The direction is not required to be normalized, distances along
+// the ray are then measured in units of its length.
+struct Ray {
+    Eigen::Vector3f origin = Eigen::Vector3f::Zero();
+    Eigen::Vector3f direction = Eigen::Vector3f::UnitZ();
+
+    Ray() = default;
+
+    Ray(const Eigen::Vector3f &origin, const Eigen::Vector3f &direction) : origin(origin), direction(direction) {}
+
+    inline Eigen::Vector3f At(float t) const { return origin + t * direction; }
+
+    // Ray in the frame where m is applied, e.g. in the local frame of an object placed by m
+    inline Ray Transformed(const Eigen::Matrix4f &m) const {
+        return {m.topLeftCorner<3, 3>() * origin + m.topRightCorner<3, 1>(), m.topLeftCorner<3, 3>() * direction};
+    }
+};
+
+
+// Bounds of `itemCount` points of an interleaved float array, using the first min(stride, 3) elements of
+// each item, missing coordinates being zero. Large arrays are processed on several threads.
+BoundingBox ComputeBoundingBox(const float *data, size_t stride, size_t itemCount);
+
+// Sphere centered on `center` through the farthest of the points.
+BoundingSphere ComputeBoundingSphere(const float *data, size_t stride, size_t itemCount,
+                                     const Eigen::Vector3f &center);
+
+} // namespace vivid
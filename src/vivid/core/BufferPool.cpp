@@ -0,0 +1,295 @@
+#include <algorithm>
+#include <glad/glad.h>
+#include "vivid/core/BufferPool.h"
+#include "vivid/core/GLContext.h"
+#include "vivid/core/GLStateCache.h"
+
+namespace vivid {
+
+// Ranges start on this boundary, enough for any vertex or index type
+constexpr size_t kAlignment = 16;
+
+static size_t AlignUp(size_t size) {
+    return (size + kAlignment - 1) & ~(kAlignment - 1);
+}
+
+
+BufferPool::BufferPool(size_t arenaSize)
+    : arenaSize_(AlignUp(arenaSize))
+{}
+
+
+BufferPool::~BufferPool() {
+    for (auto &arena : arenas_) {
+        ReleaseArena(arena);
+    }
+}
+
+
+int BufferPool::CreateArena(size_t capacity) {
+    Arena arena;
+    arena.capacity = capacity;
+    arena.freeBlocks.push_back({0, capacity});
+    glGenBuffers(1, &arena.buffer);
+    GLStateCache::Instance().BindBuffer(GL_COPY_WRITE_BUFFER, arena.buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)capacity, nullptr, GL_STATIC_DRAW);
+
+    // Reuse the slot of a released arena
+    for (size_t i = 0; i < arenas_.size(); ++i) {
+        if (arenas_[i].buffer == 0) {
+            arenas_[i] = std::move(arena);
+            return (int)i;
+        }
+    }
+    arenas_.push_back(std::move(arena));
+    return (int)arenas_.size() - 1;
+}
+
+
+void BufferPool::ReleaseArena(Arena &arena) {
+    if (arena.buffer && GLContext::IsAlive()) {
+        GLStateCache::Instance().ForgetBuffer(arena.buffer);
+        glDeleteBuffers(1, &arena.buffer);
+    }
+    arena = Arena();
+}
+
+
+BufferPool::Handle BufferPool::Allocate(size_t size) {
+    size = AlignUp(std::max<size_t>(size, 1));
+
+    // First fit
+    int arenaIndex = -1;
+    size_t blockIndex = 0;
+    for (size_t i = 0; i < arenas_.size() && arenaIndex < 0; ++i) {
+        const auto &blocks = arenas_[i].freeBlocks;
+        for (size_t j = 0; j < blocks.size(); ++j) {
+            if (blocks[j].size >= size) {
+                arenaIndex = (int)i;
+                blockIndex = j;
+                break;
+            }
+        }
+    }
+    if (arenaIndex < 0) {
+        arenaIndex = CreateArena(std::max(arenaSize_, size));
+        blockIndex = 0;
+    }
+
+    Arena &arena = arenas_[arenaIndex];
+    Block &block = arena.freeBlocks[blockIndex];
+    Allocation allocation;
+    allocation.arena = arenaIndex;
+    allocation.offset = block.offset;
+    allocation.size = size;
+    block.offset += size;
+    block.size -= size;
+    if (block.size == 0) {
+        arena.freeBlocks.erase(arena.freeBlocks.begin() + (long)blockIndex);
+    }
+    arena.used += size;
+    usedBytes_ += size;
+
+    Handle handle;
+    if (!freeHandles_.empty()) {
+        handle = freeHandles_.back();
+        freeHandles_.pop_back();
+        allocations_[handle - 1] = allocation;
+    } else {
+        allocations_.push_back(allocation);
+        handle = (Handle)allocations_.size();
+    }
+    return handle;
+}
+
+
+void BufferPool::Free(Handle handle) {
+    if (handle == kInvalidHandle || handle > allocations_.size() || allocations_[handle - 1].arena < 0) {
+        return;
+    }
+    Allocation &allocation = allocations_[handle - 1];
+    Arena &arena = arenas_[allocation.arena];
+    arena.used -= allocation.size;
+    usedBytes_ -= allocation.size;
+
+    // Insert the block back, merged with its free neighbours
+    auto &blocks = arena.freeBlocks;
+    auto next = std::lower_bound(blocks.begin(), blocks.end(), allocation.offset,
+                                 [](const Block &block, size_t offset) { return block.offset < offset; });
+    auto it = blocks.insert(next, {allocation.offset, allocation.size});
+    if (it + 1 != blocks.end() && it->offset + it->size == (it + 1)->offset) {
+        it->size += (it + 1)->size;
+        blocks.erase(it + 1);
+    }
+    if (it != blocks.begin() && (it - 1)->offset + (it - 1)->size == it->offset) {
+        (it - 1)->size += it->size;
+        blocks.erase(it);
+    }
+
+    // Give the memory of empty arenas back, keeping one to allocate from
+    if (arena.used == 0) {
+        int liveArenas = 0;
+        for (const auto &other : arenas_) {
+            liveArenas += other.buffer != 0 ? 1 : 0;
+        }
+        if (liveArenas > 1) {
+            ReleaseArena(arena);
+        }
+    }
+
+    allocation = Allocation();
+    freeHandles_.push_back(handle);
+}
+
+
+unsigned int BufferPool::Buffer(Handle handle) const {
+    if (handle == kInvalidHandle || handle > allocations_.size() || allocations_[handle - 1].arena < 0) {
+        return 0;
+    }
+    return arenas_[allocations_[handle - 1].arena].buffer;
+}
+
+
+size_t BufferPool::Offset(Handle handle) const {
+    return handle != kInvalidHandle && handle <= allocations_.size() ? allocations_[handle - 1].offset : 0;
+}
+
+
+size_t BufferPool::Size(Handle handle) const {
+    return handle != kInvalidHandle && handle <= allocations_.size() ? allocations_[handle - 1].size : 0;
+}
+
+
+size_t BufferPool::CapacityBytes() const {
+    size_t capacity = 0;
+    for (const auto &arena : arenas_) {
+        capacity += arena.capacity;
+    }
+    return capacity;
+}
+
+
+void BufferPool::Defragment() {
+    // Live ranges, largest first so that big ranges don't end up alone in an arena
+    std::vector<Handle> handles;
+    for (size_t i = 0; i < allocations_.size(); ++i) {
+        if (allocations_[i].arena >= 0) {
+            handles.push_back((Handle)(i + 1));
+        }
+    }
+    std::sort(handles.begin(), handles.end(), [this](Handle a, Handle b) {
+        return allocations_[a - 1].size > allocations_[b - 1].size;
+    });
+
+    // Pack them into new arenas, copying on GPU
+    std::vector<Arena> oldArenas;
+    oldArenas.swap(arenas_);
+    std::vector<size_t> fill;
+    for (Handle handle : handles) {
+        Allocation &allocation = allocations_[handle - 1];
+        int target = -1;
+        for (size_t i = 0; i < arenas_.size(); ++i) {
+            if (arenas_[i].capacity - fill[i] >= allocation.size) {
+                target = (int)i;
+                break;
+            }
+        }
+        if (target < 0) {
+            target = CreateArena(std::max(arenaSize_, allocation.size));
+            fill.push_back(0);
+        }
+
+        GLStateCache::Instance().BindBuffer(GL_COPY_READ_BUFFER, oldArenas[allocation.arena].buffer);
+        GLStateCache::Instance().BindBuffer(GL_COPY_WRITE_BUFFER, arenas_[target].buffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, (GLintptr)allocation.offset,
+                            (GLintptr)fill[target], (GLsizeiptr)allocation.size);
+        allocation.arena = target;
+        allocation.offset = fill[target];
+        fill[target] += allocation.size;
+    }
+
+    for (size_t i = 0; i < arenas_.size(); ++i) {
+        Arena &arena = arenas_[i];
+        arena.used = fill[i];
+        arena.freeBlocks.clear();
+        if (fill[i] < arena.capacity) {
+            arena.freeBlocks.push_back({fill[i], arena.capacity - fill[i]});
+        }
+    }
+    for (auto &arena : oldArenas) {
+        ReleaseArena(arena);
+    }
+    generation_++;
+}
+
+
+BufferRange::~BufferRange() {
+    Release();
+}
+
+
+bool BufferRange::Reserve(size_t size, unsigned int usage, const BufferPoolPtr &pool, const void *data) {
+    if (IsValid() && size <= capacity_ && pool == pool_) {
+        return false;
+    }
+    const unsigned int oldHandle = Handle();
+    const size_t oldOffset = Offset();
+
+    if (pool) {
+        Release();
+        pool_ = pool;
+        allocation_ = pool_->Allocate(size);
+        capacity_ = pool_->Size(allocation_);
+        if (data != nullptr) {
+            Upload(0, size, data);
+        }
+    } else {
+        // Reallocate an owned buffer, the handle doesn't change
+        if (pool_) {
+            Release();
+        }
+        if (!buffer_) {
+            glGenBuffers(1, &buffer_);
+        }
+        GLStateCache::Instance().BindBuffer(GL_COPY_WRITE_BUFFER, buffer_);
+        glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)size, data, usage);
+        capacity_ = size;
+    }
+    return Handle() != oldHandle || Offset() != oldOffset;
+}
+
+
+void BufferRange::Upload(size_t offset, size_t size, const void *data) const {
+    if (size == 0) {
+        return;
+    }
+    GLStateCache::Instance().BindBuffer(GL_COPY_WRITE_BUFFER, Handle());
+    glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)(Offset() + offset), (GLsizeiptr)size, data);
+}
+
+
+unsigned int BufferRange::Handle() const {
+    return pool_ ? pool_->Buffer(allocation_) : buffer_;
+}
+
+
+size_t BufferRange::Offset() const {
+    return pool_ ? pool_->Offset(allocation_) : 0;
+}
+
+
+void BufferRange::Release() {
+    if (pool_) {
+        pool_->Free(allocation_);
+        pool_.reset();
+        allocation_ = BufferPool::kInvalidHandle;
+    }
+    if (buffer_ && GLContext::IsAlive()) {
+        GLStateCache::Instance().ForgetBuffer(buffer_);
+        glDeleteBuffers(1, &buffer_);
+    }
+    buffer_ = 0;
+    capacity_ = 0;
+}
+
+} // namespace vivid
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <iostream>
+#include <memory>
+#include <vector>
+#include <cstdint>
+
+namespace vivid {
+
+/* Suballocates vertex and index ranges from a few large buffer objects (arenas), instead of one buffer
+ * object per attribute. Freed ranges are coalesced and reused, arenas left empty are released, and
+ * Defragment() packs the live ranges into as few arenas as possible.
+ *
+ * Ranges are referred to by handles, since their buffer and offset change when the pool is defragmented.
+ * Every such change increments Generation(), users then rebuild what recorded the old locations.
+ */
+class BufferPool {
+public:
+    using Handle = uint32_t;
+    static constexpr Handle kInvalidHandle = 0;
+
+    explicit BufferPool(size_t arenaSize = 32u << 20);
+
+    ~BufferPool();
+
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    // Suballocate `size` bytes, a new arena is created if none has room.
+    Handle Allocate(size_t size);
+
+    void Free(Handle handle);
+
+    // Buffer object, byte offset and size of a range
+    unsigned int Buffer(Handle handle) const;
+    size_t Offset(Handle handle) const;
+    size_t Size(Handle handle) const;
+
+    // Move the live ranges to the front of new arenas and release the old ones.
+    void Defragment();
+
+    inline unsigned int Generation() const { return generation_; }
+
+    // Bytes in live ranges, and bytes allocated on GPU
+    inline size_t UsedBytes() const { return usedBytes_; }
+    size_t CapacityBytes() const;
+
+private:
+    struct Block {
+        size_t offset;
+        size_t size;
+    };
+
+    struct Arena {
+        unsigned int buffer = 0;
+        size_t capacity = 0;
+        size_t used = 0;
+        std::vector<Block> freeBlocks;   // sorted by offset, never adjacent
+    };
+
+    struct Allocation {
+        int arena = -1;
+        size_t offset = 0;
+        size_t size = 0;
+    };
+
+    int CreateArena(size_t capacity);
+
+    void ReleaseArena(Arena &arena);
+
+    size_t arenaSize_;
+    std::vector<Arena> arenas_;
+    std::vector<Allocation> allocations_;   // indexed by handle - 1
+    std::vector<Handle> freeHandles_;
+    size_t usedBytes_ = 0;
+    unsigned int generation_ = 0;
+};
+
+using BufferPoolPtr = std::shared_ptr<BufferPool>;
+
+
+/* GPU storage of a vertex or index buffer: a buffer object owned by this range, or a range of a pool.
+ * The storage is released on destruction.
+ */
+class BufferRange {
+public:
+    BufferRange() = default;
+
+    ~BufferRange();
+
+    BufferRange(const BufferRange&) = delete;
+    BufferRange& operator=(const BufferRange&) = delete;
+
+    // Make room for `size` bytes, in the pool if any, and upload `data` if the storage is reallocated.
+    // Return true if the storage moved, i.e. its buffer or offset changed.
+    bool Reserve(size_t size, unsigned int usage, const BufferPoolPtr &pool, const void *data);
+
+    // Write `size` bytes at `offset`, relative to the start of the range.
+    void Upload(size_t offset, size_t size, const void *data) const;
+
+    unsigned int Handle() const;
+
+    // Byte offset of the range in its buffer object
+    size_t Offset() const;
+
+    inline size_t Capacity() const { return capacity_; }
+
+    inline bool IsValid() const { return Handle() != 0; }
+
+    void Release();
+
+private:
+    unsigned int buffer_ = 0;
+    size_t capacity_ = 0;
+    BufferPoolPtr pool_;
+    BufferPool::Handle allocation_ = BufferPool::kInvalidHandle;
+};
+
+} // namespace vivid
@@ -1,3 +1,4 @@
+#include <atomic>
 #include <glm/gtc/matrix_transform.hpp>
 #include "vivid/core/Camera.h"
 #include "vivid/utils/GlmUtils.h"
@@ -24,12 +25,65 @@ void Camera::CalcProjectionMatrix() {
     } else if (IsOrthographic()) {
         projMat_ = glm::ortho(left_, right_, bottom_, top_, near_, far_);
     }
+    projChanged_ = true;
 }
 
 
-glm::mat4 Camera::GetViewMatrix() {
-    Eigen::Matrix4d Tcw = transform_.Matrix().inverse();
-    return GlmUtils::eigen2glm(Tcw);
+void Camera::UpdateMatrices() const {
+    if (viewStamp_ == transform_.Stamp() && !projChanged_) {
+        return;
+    }
+    // Inverse of the camera pose, (R^T, -R^T t) unless it is scaled
+    const Eigen::Matrix4f view = transform_.InverseMatrix().cast<float>();
+    viewMat_ = GlmUtils::eigen2glm(view);
+    viewProjMat_ = projMat_ * viewMat_;
+    viewProjEigen_ = GlmUtils::glm2eigen<float>(viewProjMat_);
+    viewStamp_ = transform_.Stamp();
+    projChanged_ = false;
+    static std::atomic<uint64_t> versionCounter(0);
+    version_ = ++versionCounter;
+}
+
+
+const glm::mat4& Camera::GetViewMatrix() const {
+    UpdateMatrices();
+    return viewMat_;
+}
+
+
+const glm::mat4& Camera::GetViewProjectionMatrix() const {
+    UpdateMatrices();
+    return viewProjMat_;
+}
+
+
+bool Camera::IsViewRigid() const {
+    return transform_.IsRigid();
+}
+
+
+uint64_t Camera::GetVersion() const {
+    UpdateMatrices();
+    return version_;
+}
+
+
+Ray Camera::ScreenRay(float x, float y) const {
+    UpdateMatrices();
+    const Eigen::Matrix4f inverse = viewProjEigen_.inverse();
+
+    // Unproject the points of the near and far planes
+    const Eigen::Vector4f nearPoint = inverse * Eigen::Vector4f(x, y, -1.f, 1.f);
+    const Eigen::Vector4f farPoint = inverse * Eigen::Vector4f(x, y, 1.f, 1.f);
+    const Eigen::Vector3f origin = nearPoint.head<3>() / nearPoint.w();
+    const Eigen::Vector3f target = farPoint.head<3>() / farPoint.w();
+    return {origin, (target - origin).normalized()};
+}
+
+
+Frustum Camera::GetFrustum() const {
+    UpdateMatrices();
+    return Frustum(viewProjEigen_);
 }
 
 
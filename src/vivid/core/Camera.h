@@ -4,6 +4,7 @@
 #include <memory>
 #include <vector>
 #include <glm/glm.hpp>
+#include "vivid/core/Frustum.h"
 #include "vivid/core/Object3D.h"
 #include "vivid/core/Transform.h"
 
@@ -22,9 +23,28 @@ public:
 
     void CalcProjectionMatrix();
 
-    inline glm::mat4 GetProjectionMatrix() { return projMat_; }
+    inline const glm::mat4& GetProjectionMatrix() const { return projMat_; }
 
-    glm::mat4 GetViewMatrix();
+    // View and view-projection matrices, cached until the transform or the projection changes
+    const glm::mat4& GetViewMatrix() const;
+    const glm::mat4& GetViewProjectionMatrix() const;
+
+    // True if the view matrix has no scale, so that normal matrices derived from it need no inverse
+    bool IsViewRigid() const;
+
+    // Changes whenever the view or projection matrix changes, and is unique among all cameras
+    uint64_t GetVersion() const;
+
+    // View volume in world frame, from the projection and view matrices
+    Frustum GetFrustum() const;
+
+    // Ray in world frame through a point of the image in normalized device coordinates, x and y in [-1, 1]
+    // with y up, from the near plane. For a cursor at (px, py) in a w x h window:
+    // x = 2 * px / w - 1, y = 1 - 2 * py / h.
+    Ray ScreenRay(float x, float y) const;
+
+    inline float GetNear() const { return near_; }
+    inline float GetFar() const { return far_; }
 
     bool IsPerspective() const {
         return type_ == CameraType::Perspective;
@@ -47,9 +67,20 @@ private:
     // Orthographic parameters
     float left_, right_, bottom_, top_;
 
+    // Refresh the cached matrices if the transform or the projection changed
+    void UpdateMatrices() const;
+
     // Projection matrix
     glm::mat4 projMat_;
 
+    // Cached matrices, computed from the transform with stamp viewStamp_
+    mutable bool projChanged_ = true;
+    mutable glm::mat4 viewMat_;
+    mutable glm::mat4 viewProjMat_;
+    mutable Eigen::Matrix4f viewProjEigen_;
+    mutable uint64_t viewStamp_ = 0;
+    mutable uint64_t version_ = 0;
+
     // Camera type
     CameraType type_;
 };
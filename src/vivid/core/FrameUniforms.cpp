@@ -0,0 +1,83 @@
+#include <glad/glad.h>
+#include "vivid/core/FrameUniforms.h"
+#include "vivid/core/GLContext.h"
+#include "vivid/core/GLStateCache.h"
+
+namespace vivid {
+
+FrameUniforms::~FrameUniforms() {
+    if (buffer_ && GLContext::IsAlive()) {
+        GLStateCache::Instance().ForgetBuffer(buffer_);
+        glDeleteBuffers(1, &buffer_);
+    }
+}
+
+
+FrameUniforms& FrameUniforms::Default() {
+    static FrameUniforms frameUniforms;
+    return frameUniforms;
+}
+
+
+const std::string& FrameUniforms::Glsl() {
+    // Built on first use, for the shader sources initialized statically
+    static const std::string glsl = R"(
+layout(std140) uniform FrameUniforms {
+    mat4 viewMatrix;
+    mat4 projectionMatrix;
+    mat4 viewProjectionMatrix;
+    vec4 cameraPosition;    // xyz in world frame
+    vec4 viewport;          // x, y, width and height in pixels
+    float time;             // seconds
+} uFrame;
+)";
+    return glsl;
+}
+
+
+void FrameUniforms::SetTime(float time) {
+    if (data_.time != time) {
+        data_.time = time;
+        changed_ = true;
+    }
+}
+
+
+void FrameUniforms::SetViewport(int x, int y, int width, int height) {
+    const glm::vec4 viewport(x, y, width, height);
+    if (data_.viewport != viewport) {
+        data_.viewport = viewport;
+        changed_ = true;
+    }
+}
+
+
+void FrameUniforms::Update(const Camera &camera) {
+    const uint64_t version = camera.GetVersion();
+    if (!changed_ && cameraVersion_ == version) {
+        return;
+    }
+
+    data_.viewMatrix = camera.GetViewMatrix();
+    data_.projectionMatrix = camera.GetProjectionMatrix();
+    data_.viewProjectionMatrix = camera.GetViewProjectionMatrix();
+    const Eigen::Vector3d position = camera.GetTransform().Position();
+    data_.cameraPosition = glm::vec4(position.x(), position.y(), position.z(), 1.f);
+
+    GLStateCache &gl = GLStateCache::Instance();
+    if (buffer_ == 0) {
+        glGenBuffers(1, &buffer_);
+        gl.BindBuffer(GL_UNIFORM_BUFFER, buffer_);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameUniformData), &data_, GL_DYNAMIC_DRAW);
+    } else {
+        gl.BindBuffer(GL_UNIFORM_BUFFER, buffer_);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameUniformData), &data_);
+    }
+    gl.BindBufferBase(GL_UNIFORM_BUFFER, kBindingPoint, buffer_);
+
+    cameraVersion_ = version;
+    changed_ = false;
+    uploadCount_++;
+}
+
+} // namespace vivid
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <glm/glm.hpp>
+#include "vivid/core/Camera.h"
+
+namespace vivid {
+
+// Per-frame data shared by all the shaders, laid out as the std140 block declared by FrameUniforms::Glsl()
+struct FrameUniformData {
+    glm::mat4 viewMatrix;
+    glm::mat4 projectionMatrix;
+    glm::mat4 viewProjectionMatrix;
+    glm::vec4 cameraPosition;   // xyz in world frame
+    glm::vec4 viewport;         // x, y, width and height in pixels
+    float time = 0.f;           // seconds
+    float padding[3] = {0.f, 0.f, 0.f};
+};
+
+static_assert(sizeof(FrameUniformData) == 240, "FrameUniformData must match the std140 layout");
+
+
+/* Uniform buffer holding the camera and frame data, bound to a fixed binding point. Shaders declaring the
+ * FrameUniforms block read it from there, so the view and projection matrices are uploaded once per frame
+ * (or camera change) instead of once per draw.
+ */
+class FrameUniforms {
+public:
+    static constexpr unsigned int kBindingPoint = 0;
+
+    FrameUniforms() = default;
+
+    ~FrameUniforms();
+
+    FrameUniforms(const FrameUniforms&) = delete;
+    FrameUniforms& operator=(const FrameUniforms&) = delete;
+
+    // Buffer used by meshes and renderers
+    static FrameUniforms& Default();
+
+    // Declaration of the block, to be inserted in shaders after the #version line. Its members are read
+    // as uFrame.viewMatrix, uFrame.time, etc.
+    static const std::string& Glsl();
+
+    void SetTime(float time);
+    void SetViewport(int x, int y, int width, int height);
+
+    // Upload the data of the camera if it or the frame data changed since the last update, and bind the
+    // buffer to kBindingPoint.
+    void Update(const Camera &camera);
+
+    inline const FrameUniformData& Data() const { return data_; }
+
+    // Number of uploads so far
+    inline unsigned int UploadCount() const { return uploadCount_; }
+
+private:
+    FrameUniformData data_;
+    unsigned int buffer_ = 0;
+
+    // Version of the camera the buffer was last uploaded from
+    uint64_t cameraVersion_ = 0;
+    bool changed_ = true;
+
+    unsigned int uploadCount_ = 0;
+};
+
+} // namespace vivid
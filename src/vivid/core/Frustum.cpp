@@ -0,0 +1,135 @@
+#include <cmath>
+#include <algorithm>
+#include "vivid/core/Frustum.h"
+
+namespace vivid {
+
+void BoxBatch::Clear() {
+    centerX.clear();
+    centerY.clear();
+    centerZ.clear();
+    extentX.clear();
+    extentY.clear();
+    extentZ.clear();
+}
+
+
+void BoxBatch::Add(const BoundingBox &box) {
+    const Eigen::Vector3f c = box.Center();
+    const Eigen::Vector3f e = box.Extents();
+    centerX.push_back(c.x());
+    centerY.push_back(c.y());
+    centerZ.push_back(c.z());
+    extentX.push_back(e.x());
+    extentY.push_back(e.y());
+    extentZ.push_back(e.z());
+}
+
+
+void BoxBatch::Resize(size_t size) {
+    centerX.resize(size);
+    centerY.resize(size);
+    centerZ.resize(size);
+    extentX.resize(size);
+    extentY.resize(size);
+    extentZ.resize(size);
+}
+
+
+void BoxBatch::Set(size_t i, const BoundingBox &box) {
+    const Eigen::Vector3f c = box.Center();
+    const Eigen::Vector3f e = box.Extents();
+    centerX[i] = c.x();
+    centerY[i] = c.y();
+    centerZ[i] = c.z();
+    extentX[i] = e.x();
+    extentY[i] = e.y();
+    extentZ[i] = e.z();
+}
+
+
+Frustum::Frustum(const Eigen::Matrix4f &viewProjection) {
+    // A clip-space point is inside when -w <= x, y, z <= w, i.e. (row3 +/- row_i) . p >= 0
+    const Eigen::RowVector4f r0 = viewProjection.row(0);
+    const Eigen::RowVector4f r1 = viewProjection.row(1);
+    const Eigen::RowVector4f r2 = viewProjection.row(2);
+    const Eigen::RowVector4f r3 = viewProjection.row(3);
+    planes_[0] = (r3 + r0).transpose();
+    planes_[1] = (r3 - r0).transpose();
+    planes_[2] = (r3 + r1).transpose();
+    planes_[3] = (r3 - r1).transpose();
+    planes_[4] = (r3 + r2).transpose();
+    planes_[5] = (r3 - r2).transpose();
+    for (auto &plane : planes_) {
+        const float norm = plane.head<3>().norm();
+        if (norm > 0.f) {
+            plane /= norm;
+        }
+    }
+}
+
+
+bool Frustum::Intersects(const BoundingBox &box) const {
+    if (box.IsEmpty()) {
+        return false;
+    }
+    const Eigen::Vector3f c = box.Center();
+    const Eigen::Vector3f e = box.Extents();
+    for (const auto &plane : planes_) {
+        const Eigen::Vector3f n = plane.head<3>();
+        // The box is outside if even its most inward corner is behind the plane
+        if (n.dot(c) + plane.w() < -n.cwiseAbs().dot(e)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+bool Frustum::Intersects(const BoundingSphere &sphere) const {
+    if (sphere.IsEmpty()) {
+        return false;
+    }
+    for (const auto &plane : planes_) {
+        if (plane.head<3>().dot(sphere.center) + plane.w() < -sphere.radius) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+void Frustum::Cull(const BoxBatch &boxes, std::vector<uint8_t> &visible) const {
+    visible.resize(boxes.Size());
+    Cull(boxes, 0, boxes.Size(), visible);
+}
+
+
+void Frustum::Cull(const BoxBatch &boxes, size_t begin, size_t end, std::vector<uint8_t> &visible) const {
+    constexpr Eigen::Index kBlockSize = 256;
+    using Block = Eigen::Array<float, Eigen::Dynamic, 1, Eigen::ColMajor, kBlockSize, 1>;
+    using ConstMap = Eigen::Map<const Eigen::ArrayXf>;
+
+    const auto last = static_cast<Eigen::Index>(end);
+    Block inside;
+    for (auto first = static_cast<Eigen::Index>(begin); first < last; first += kBlockSize) {
+        const Eigen::Index n = std::min(kBlockSize, last - first);
+        ConstMap cx(boxes.centerX.data() + first, n), cy(boxes.centerY.data() + first, n),
+                cz(boxes.centerZ.data() + first, n);
+        ConstMap ex(boxes.extentX.data() + first, n), ey(boxes.extentY.data() + first, n),
+                ez(boxes.extentZ.data() + first, n);
+
+        // Distance of the center to the plane, plus the projected radius of the box, must be >= 0
+        // for all planes. The minimum over the planes is kept.
+        inside.setConstant(n, 1.f);
+        for (const auto &p : planes_) {
+            const float ax = std::abs(p.x()), ay = std::abs(p.y()), az = std::abs(p.z());
+            inside = inside.min(cx * p.x() + cy * p.y() + cz * p.z() + p.w() + ex * ax + ey * ay + ez * az);
+        }
+        for (Eigen::Index i = 0; i < n; ++i) {
+            visible[first + i] = inside[i] >= 0.f ? 1 : 0;
+        }
+    }
+}
+
+} // namespace vivid
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <Eigen/Dense>
+#include "vivid/core/Bounds.h"
+
+namespace vivid {
+
+// Boxes in struct-of-arrays layout, as centers and half extents, for batched culling.
+struct BoxBatch {
+    std::vector<float> centerX, centerY, centerZ;
+    std::vector<float> extentX, extentY, extentZ;
+
+    inline size_t Size() const { return centerX.size(); }
+
+    void Clear();
+
+    void Add(const BoundingBox &box);
+
+    // Resize to `size` boxes and set box i, e.g. from several threads
+    void Resize(size_t size);
+    void Set(size_t i, const BoundingBox &box);
+};
+
+
+/* The six planes of a view volume: left, right, bottom, top, near, far. Planes are normalized and their
+ * normals point inside, so a point p is inside when dot(n, p) + d >= 0 for all of them.
+ */
+class Frustum {
+public:
+    Frustum() = default;
+
+    // Planes of the clip volume of a projection * view matrix (Gribb-Hartmann), in world frame.
+    explicit Frustum(const Eigen::Matrix4f &viewProjection);
+
+    // Plane i as (nx, ny, nz, d)
+    inline const Eigen::Vector4f& Plane(int i) const { return planes_[i]; }
+
+    // Conservative tests: objects straddling two planes outside a corner may be kept.
+    bool Intersects(const BoundingBox &box) const;
+    bool Intersects(const BoundingSphere &sphere) const;
+
+    // visible[i] = 1 if box i intersects the frustum, 0 otherwise. Boxes are processed a block at a time,
+    // plane by plane, so that the tests run on whole SIMD registers.
+    void Cull(const BoxBatch &boxes, std::vector<uint8_t> &visible) const;
+
+    // Same for the boxes [begin, end) only, `visible` must have one entry per box
+    void Cull(const BoxBatch &boxes, size_t begin, size_t end, std::vector<uint8_t> &visible) const;
+
+private:
+    std::array<Eigen::Vector4f, 6> planes_;
+};
+
+} // namespace vivid
@@ -0,0 +1,21 @@
+#pragma once
+
+namespace vivid {
+
+/* GL objects can only be deleted while their context exists. Application marks the context as gone when it
+ * terminates, so that objects released afterwards (e.g. the static shaders of ShaderImpl) skip the GL calls.
+ */
+class GLContext {
+public:
+    static bool IsAlive() { return Alive(); }
+
+    static void SetAlive(bool alive) { Alive() = alive; }
+
+private:
+    static bool& Alive() {
+        static bool alive = true;
+        return alive;
+    }
+};
+
+} // namespace vivid
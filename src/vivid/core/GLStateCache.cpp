@@ -0,0 +1,270 @@
+#include "vivid/core/GLStateCache.h"
+
+namespace vivid {
+
+constexpr GLuint GLStateCache::kUnknown;
+
+
+GLStateCache& GLStateCache::Instance() {
+    static GLStateCache cache;
+    return cache;
+}
+
+
+GLStateCache::GLStateCache() {
+    Invalidate();
+}
+
+
+void GLStateCache::Invalidate() {
+    program_ = kUnknown;
+    vertexArray_ = kUnknown;
+    buffers_.fill(kUnknown);
+    uniformBindings_.fill(kUnknown);
+    activeUnit_ = kUnknown;
+    for (auto &unit : textures_) {
+        unit.fill(kUnknown);
+    }
+    drawFramebuffer_ = kUnknown;
+    readFramebuffer_ = kUnknown;
+    viewportKnown_ = false;
+    caps_.fill(kUnknown);
+    depthMask_ = kUnknown;
+    blendSource_ = kUnknown;
+    blendDestination_ = kUnknown;
+    cullFace_ = kUnknown;
+}
+
+
+int GLStateCache::BufferSlot(GLenum target) {
+    switch (target) {
+        case GL_ARRAY_BUFFER: return 0;
+        case GL_COPY_READ_BUFFER: return 1;
+        case GL_COPY_WRITE_BUFFER: return 2;
+        case GL_UNIFORM_BUFFER: return 3;
+        case GL_TEXTURE_BUFFER: return 4;
+        default: return -1;
+    }
+}
+
+
+int GLStateCache::TextureSlot(GLenum target) {
+    switch (target) {
+        case GL_TEXTURE_2D: return 0;
+        case GL_TEXTURE_CUBE_MAP: return 1;
+        case GL_TEXTURE_BUFFER: return 2;
+        case GL_TEXTURE_2D_MULTISAMPLE: return 3;
+        default: return -1;
+    }
+}
+
+
+int GLStateCache::CapSlot(GLenum cap) {
+    switch (cap) {
+        case GL_DEPTH_TEST: return 0;
+        case GL_BLEND: return 1;
+        case GL_CULL_FACE: return 2;
+        case GL_SCISSOR_TEST: return 3;
+        case GL_STENCIL_TEST: return 4;
+        case GL_POLYGON_OFFSET_FILL: return 5;
+        case GL_PROGRAM_POINT_SIZE: return 6;
+        case GL_MULTISAMPLE: return 7;
+        default: return -1;
+    }
+}
+
+
+void GLStateCache::UseProgram(GLuint program) {
+    if (Changed(program_, program)) {
+        glUseProgram(program);
+    }
+}
+
+
+void GLStateCache::BindVertexArray(GLuint vertexArray) {
+    if (Changed(vertexArray_, vertexArray)) {
+        glBindVertexArray(vertexArray);
+    }
+}
+
+
+void GLStateCache::BindBuffer(GLenum target, GLuint buffer) {
+    const int slot = BufferSlot(target);
+    if (slot < 0) {
+        issued_++;
+        glBindBuffer(target, buffer);
+    } else if (Changed(buffers_[slot], buffer)) {
+        glBindBuffer(target, buffer);
+    }
+}
+
+
+void GLStateCache::BindBufferBase(GLenum target, GLuint index, GLuint buffer) {
+    // Also binds the generic binding point of the target
+    const int slot = BufferSlot(target);
+    if (target == GL_UNIFORM_BUFFER && index < kUniformBindings) {
+        if (Changed(uniformBindings_[index], buffer)) {
+            glBindBufferBase(target, index, buffer);
+            buffers_[slot] = buffer;
+        }
+        return;
+    }
+    issued_++;
+    glBindBufferBase(target, index, buffer);
+    if (slot >= 0) {
+        buffers_[slot] = buffer;
+    }
+}
+
+
+void GLStateCache::ActiveTexture(GLuint unit) {
+    if (Changed(activeUnit_, unit)) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+    }
+}
+
+
+void GLStateCache::BindTexture(GLenum target, GLuint texture) {
+    const int slot = TextureSlot(target);
+    if (activeUnit_ >= kTextureUnits || slot < 0) {
+        issued_++;
+        glBindTexture(target, texture);
+    } else if (Changed(textures_[activeUnit_][slot], texture)) {
+        glBindTexture(target, texture);
+    }
+}
+
+
+void GLStateCache::BindTexture(GLuint unit, GLenum target, GLuint texture) {
+    const int slot = TextureSlot(target);
+    if (unit < kTextureUnits && slot >= 0 && textures_[unit][slot] == texture) {
+        skipped_++;
+        return;
+    }
+    ActiveTexture(unit);
+    BindTexture(target, texture);
+}
+
+
+void GLStateCache::BindFramebuffer(GLenum target, GLuint framebuffer) {
+    const bool draw = target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER;
+    const bool read = target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER;
+    if ((!draw || drawFramebuffer_ == framebuffer) && (!read || readFramebuffer_ == framebuffer)) {
+        skipped_++;
+        return;
+    }
+    issued_++;
+    glBindFramebuffer(target, framebuffer);
+    if (draw) {
+        drawFramebuffer_ = framebuffer;
+    }
+    if (read) {
+        readFramebuffer_ = framebuffer;
+    }
+}
+
+
+void GLStateCache::Viewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+    const std::array<GLint, 4> viewport{x, y, width, height};
+    if (viewportKnown_ && viewport_ == viewport) {
+        skipped_++;
+        return;
+    }
+    issued_++;
+    glViewport(x, y, width, height);
+    viewport_ = viewport;
+    viewportKnown_ = true;
+}
+
+
+void GLStateCache::SetEnabled(GLenum cap, bool enabled) {
+    const int slot = CapSlot(cap);
+    if (slot >= 0 && !Changed(caps_[slot], enabled ? 1 : 0)) {
+        return;
+    }
+    if (slot < 0) {
+        issued_++;
+    }
+    if (enabled) {
+        glEnable(cap);
+    } else {
+        glDisable(cap);
+    }
+}
+
+
+void GLStateCache::DepthMask(bool write) {
+    if (Changed(depthMask_, write ? 1 : 0)) {
+        glDepthMask(write ? GL_TRUE : GL_FALSE);
+    }
+}
+
+
+void GLStateCache::BlendFunc(GLenum source, GLenum destination) {
+    if (blendSource_ == source && blendDestination_ == destination) {
+        skipped_++;
+        return;
+    }
+    issued_++;
+    glBlendFunc(source, destination);
+    blendSource_ = source;
+    blendDestination_ = destination;
+}
+
+
+void GLStateCache::CullFace(GLenum face) {
+    if (Changed(cullFace_, face)) {
+        glCullFace(face);
+    }
+}
+
+
+void GLStateCache::ForgetProgram(GLuint program) {
+    if (program_ == program) {
+        program_ = kUnknown;
+    }
+}
+
+
+void GLStateCache::ForgetVertexArray(GLuint vertexArray) {
+    if (vertexArray_ == vertexArray) {
+        vertexArray_ = kUnknown;
+    }
+}
+
+
+void GLStateCache::ForgetBuffer(GLuint buffer) {
+    for (GLuint &binding : buffers_) {
+        if (binding == buffer) {
+            binding = kUnknown;
+        }
+    }
+    for (GLuint &binding : uniformBindings_) {
+        if (binding == buffer) {
+            binding = kUnknown;
+        }
+    }
+}
+
+
+void GLStateCache::ForgetTexture(GLuint texture) {
+    for (auto &unit : textures_) {
+        for (GLuint &binding : unit) {
+            if (binding == texture) {
+                binding = kUnknown;
+            }
+        }
+    }
+}
+
+
+void GLStateCache::ForgetFramebuffer(GLuint framebuffer) {
+    if (drawFramebuffer_ == framebuffer) {
+        drawFramebuffer_ = kUnknown;
+    }
+    if (readFramebuffer_ == framebuffer) {
+        readFramebuffer_ = kUnknown;
+    }
+}
+
+} // namespace vivid
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <iostream>
+#include <array>
+#include <cstdint>
+#include <glad/glad.h>
+
+namespace vivid {
+
+/* Shadow copy of the GL state set by vivid, to drop the calls that would set it to its current value.
+ *
+ * Tracked: the program, vertex array, buffers of the non-indexed targets (the element array buffer belongs to
+ * the vertex array and is always set), the uniform buffer binding points, the textures of each unit, the
+ * framebuffers, the viewport, the depth mask, blend function, cull face and the usual enable flags. Anything
+ * else is passed through. The cache only knows the calls made through it: code changing the tracked state
+ * directly, e.g. ImGui, must be followed by Invalidate(). Deleted objects must be forgotten, as their names
+ * can be reused.
+ */
+class GLStateCache {
+public:
+    static GLStateCache& Instance();
+
+    GLStateCache(const GLStateCache&) = delete;
+    GLStateCache& operator=(const GLStateCache&) = delete;
+
+    // Forget all the state, the next call of each kind is issued
+    void Invalidate();
+
+    void UseProgram(GLuint program);
+    void BindVertexArray(GLuint vertexArray);
+    void BindBuffer(GLenum target, GLuint buffer);
+    void BindBufferBase(GLenum target, GLuint index, GLuint buffer);
+
+    // Bind to the active unit, or to `unit` after activating it
+    void ActiveTexture(GLuint unit);
+    void BindTexture(GLenum target, GLuint texture);
+    void BindTexture(GLuint unit, GLenum target, GLuint texture);
+
+    // GL_FRAMEBUFFER sets both the draw and read framebuffers
+    void BindFramebuffer(GLenum target, GLuint framebuffer);
+    void Viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+
+    void Enable(GLenum cap) { SetEnabled(cap, true); }
+    void Disable(GLenum cap) { SetEnabled(cap, false); }
+    void SetEnabled(GLenum cap, bool enabled);
+    void DepthMask(bool write);
+    void BlendFunc(GLenum source, GLenum destination);
+    void CullFace(GLenum face);
+
+    // Called before deleting an object, its bindings become unknown
+    void ForgetProgram(GLuint program);
+    void ForgetVertexArray(GLuint vertexArray);
+    void ForgetBuffer(GLuint buffer);
+    void ForgetTexture(GLuint texture);
+    void ForgetFramebuffer(GLuint framebuffer);
+
+    // Calls issued to GL and dropped as redundant, since the last reset
+    inline uint64_t IssuedCount() const { return issued_; }
+    inline uint64_t SkippedCount() const { return skipped_; }
+    inline void ResetCounters() { issued_ = skipped_ = 0; }
+
+private:
+    static constexpr GLuint kUnknown = 0xFFFFFFFF;
+    static constexpr int kBufferTargets = 5;
+    static constexpr int kUniformBindings = 16;
+    static constexpr int kTextureUnits = 32;
+    static constexpr int kTextureTargets = 4;
+    static constexpr int kCaps = 8;
+
+    GLStateCache();
+
+    // Slot of a tracked target or flag, -1 if it isn't tracked
+    static int BufferSlot(GLenum target);
+    static int TextureSlot(GLenum target);
+    static int CapSlot(GLenum cap);
+
+    // Count a call, return true if it must be issued
+    inline bool Changed(GLuint &cached, GLuint value) {
+        if (cached == value) {
+            skipped_++;
+            return false;
+        }
+        cached = value;
+        issued_++;
+        return true;
+    }
+
+    GLuint program_;
+    GLuint vertexArray_;
+    std::array<GLuint, kBufferTargets> buffers_;
+    std::array<GLuint, kUniformBindings> uniformBindings_;
+    GLuint activeUnit_;
+    std::array<std::array<GLuint, kTextureTargets>, kTextureUnits> textures_;
+    GLuint drawFramebuffer_;
+    GLuint readFramebuffer_;
+    std::array<GLint, 4> viewport_;
+    bool viewportKnown_;
+    std::array<GLuint, kCaps> caps_;        // 0 or 1, kUnknown
+    GLuint depthMask_;
+    GLuint blendSource_;
+    GLuint blendDestination_;
+    GLuint cullFace_;
+
+    uint64_t issued_ = 0;
+    uint64_t skipped_ = 0;
+};
+
+} // namespace vivid
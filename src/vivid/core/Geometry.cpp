@@ -3,11 +3,46 @@
 //
 
 #include "Geometry.h"
+#include "GLContext.h"
+#include "GLStateCache.h"
 #include <glad/glad.h>
+#include <algorithm>
+#include <cstring>
 #include <utility>
+#include "vivid/utils/MeshOptimizer.h"
+#include "vivid/utils/Parallel.h"
 
 namespace vivid {
 
+static GLenum GLComponentType(ComponentType type) {
+    switch (type) {
+        case ComponentType::Float: return GL_FLOAT;
+        case ComponentType::HalfFloat: return GL_HALF_FLOAT;
+        case ComponentType::Byte: return GL_BYTE;
+        case ComponentType::UnsignedByte: return GL_UNSIGNED_BYTE;
+        case ComponentType::Short: return GL_SHORT;
+        case ComponentType::UnsignedShort: return GL_UNSIGNED_SHORT;
+        case ComponentType::Int2_10_10_10_Rev: return GL_INT_2_10_10_10_REV;
+        default: return GL_FLOAT;
+    }
+}
+
+
+static GLenum GLUsage(BufferUsage usage) {
+    switch (usage) {
+        case BufferUsage::Static: return GL_STATIC_DRAW;
+        case BufferUsage::Dynamic: return GL_DYNAMIC_DRAW;
+        case BufferUsage::Stream: return GL_STREAM_DRAW;
+        default: return GL_STATIC_DRAW;
+    }
+}
+
+
+static bool IsStream(const std::shared_ptr<Attribute> &attr) {
+    return attr->Usage() == BufferUsage::Stream;
+}
+
+
 Geometry::Geometry(const std::vector<float> *positions,
                    const std::vector<float> *uvs,
                    const std::vector<float> *normals) {
@@ -26,155 +61,720 @@ Geometry::Geometry(const std::vector<float> *positions,
 }
 
 
+Geometry::Geometry(std::vector<float> &&positions,
+                   std::vector<float> &&uvs,
+                   std::vector<float> &&normals) {
+    if (!positions.empty()) {
+        AddAttribute(std::make_shared<Attribute>(AttributeType::Position, 3, false, std::move(positions)));
+    }
+    if (!uvs.empty()) {
+        AddAttribute(std::make_shared<Attribute>(AttributeType::TexCoord0, 2, false, std::move(uvs)));
+    }
+    if (!normals.empty()) {
+        AddAttribute(std::make_shared<Attribute>(AttributeType::Normal, 3, false, std::move(normals)));
+    }
+}
+
+
+Geometry::~Geometry() {
+    ResetVertexArrays();
+}
+
+
 void Geometry::AddAttribute(std::shared_ptr<Attribute> attr) {
-    attributes_[attr->Name()] = std::move(attr);
+    const AttributeType type = attr->Type();
+    attributes_[type] = std::move(attr);
+    if (type == AttributeType::Position) {
+        boxSource_ = sphereSource_ = nullptr;
+    }
+    // Vertex arrays created before don't point to the new attribute
+    ResetVertexArrays();
+}
+
+
+void Geometry::SetUsage(BufferUsage usage) {
+    for (const auto &attr : attributes_) {
+        if (attr) {
+            attr->SetUsage(usage);
+        }
+    }
+}
+
+
+void Geometry::SetBufferPool(const BufferPoolPtr &pool) {
+    pool_ = pool;
+    poolGeneration_ = pool_ ? pool_->Generation() : 0;
+
+    // Move everything to the new storage on the next draw
+    ResetVertexArrays();
+    for (const auto &attr : attributes_) {
+        if (attr && !IsStream(attr)) {
+            attr->GpuBuffer().Release();
+            attr->MarkDirty();
+        }
+    }
+    interleavedBuffer_.Release();
+    indexBuffer_.Release();
+    indexVersion_++;
+}
+
+
+void Geometry::SetKeepCpuData(bool keep) {
+    for (const auto &attr : attributes_) {
+        if (attr) {
+            attr->SetKeepCpuData(keep);
+        }
+    }
 }
 
 
 void Geometry::SetIndex(std::vector<unsigned int> &indices, bool useMove) {
     indices_ = useMove ? std::move(indices) : indices;
+    indexVersion_++;
 }
 
 
-void Geometry::Translate(float x, float y, float z) {
-    if (attributes_.find("position") == attributes_.end()) {
+void Geometry::SetDrawRanges(const std::vector<DrawRange> &ranges) {
+    drawRanges_ = ranges;
+    // Byte offsets depend on the index type, they are computed on upload
+    indexVersion_++;
+}
+
+
+void Geometry::SetIndexType(IndexType type) {
+    indexType_ = type;
+    indexVersion_++;
+}
+
+
+void Geometry::Optimize(bool reorderVertices) {
+    const auto &position = attributes_[AttributeType::Position];
+    if (indices_.size() < 3 || !position) {
+        return;
+    }
+    if (!drawRanges_.empty()) {
+        std::cerr << "Warning: a geometry with draw ranges can't be optimized!\n";
         return;
     }
-    std::vector<float> positions = attributes_["position"]->GetData();
-    for (int i = 0; i < positions.size(); i += 3) {
-        positions[i] += x;
-        positions[i + 1] += y;
-        positions[i + 2] += z;
+    const auto vertexCount = static_cast<size_t>(position->ItemCount());
+    MeshOptimizer::OptimizeVertexCache(indices_, vertexCount);
+    indexVersion_++;
+    if (!reorderVertices) {
+        return;
+    }
+
+    for (const auto &attr : attributes_) {
+        if (attr && (!attr->HasCpuData() || (size_t)attr->ItemCount() != vertexCount)) {
+            std::cerr << "Warning: attribute (" << attr->Name() << ") can't be reordered, "
+                      << "vertex fetch optimization is skipped!\n";
+            return;
+        }
+    }
+    std::vector<unsigned int> remap = MeshOptimizer::OptimizeVertexFetch(indices_, vertexCount);
+    for (const auto &attr : attributes_) {
+        if (attr) {
+            attr->RemapItems(remap);
+        }
     }
-    attributes_["position"]->SetData(positions);
+}
+
+
+void Geometry::Translate(float x, float y, float z) {
+    Eigen::Matrix4f m = Eigen::Matrix4f::Identity();
+    m.topRightCorner<3, 1>() = Eigen::Vector3f(x, y, z);
+    Transform(m);
 }
 
 
 void Geometry::Rotate(float angle, const Eigen::Vector3f &axis) {
-    Eigen::AngleAxisf rotation(angle, axis);
-    if (attributes_.find("position") != attributes_.end()) {
-        std::vector<float> positions = attributes_["position"]->GetData();
-        for (int i = 0; i < positions.size(); i += 3) {
-            Eigen::Vector3f v(positions[i], positions[i + 1], positions[i + 2]);
-            v = rotation * v;
-            positions[i] = v.x();
-            positions[i + 1] = v.y();
-            positions[i + 2] = v.z();
-        }
-        attributes_["position"]->SetData(positions);
+    Eigen::Matrix4f m = Eigen::Matrix4f::Identity();
+    m.topLeftCorner<3, 3>() = Eigen::AngleAxisf(angle, axis).toRotationMatrix();
+    Transform(m);
+}
+
+
+void Geometry::Transform(const Eigen::Matrix4f &m) {
+    const Eigen::Matrix3f a = m.topLeftCorner<3, 3>();
+    const Eigen::Vector3f t = m.topRightCorner<3, 1>();
+
+    const auto &positions = attributes_[AttributeType::Position];
+    if (positions && !positions->IsFloat() && positions->Normalized()) {
+        std::cerr << "Warning: normalized quantized positions can't be transformed without clamping, "
+                     "the geometry is left as is!\n";
+        return;
+    }
+    if (positions) {
+        TransformAttribute(positions, a, t, false);
     }
 
-    if (attributes_.find("normal") != attributes_.end()) {
-        std::vector<float> normals = attributes_["normal"]->GetData();
-        for (int i = 0; i < normals.size(); i += 3) {
-            Eigen::Vector3f v(normals[i], normals[i + 1], normals[i + 2]);
-            v = rotation * v;
-            normals[i] = v.x();
-            normals[i + 1] = v.y();
-            normals[i + 2] = v.z();
+    // Directions are not affected by a translation
+    if (a.isIdentity()) {
+        return;
+    }
+    if (attributes_[AttributeType::Normal]) {
+        TransformAttribute(attributes_[AttributeType::Normal], a.inverse().transpose(), Eigen::Vector3f::Zero(), true);
+    }
+    if (attributes_[AttributeType::Tangent]) {
+        TransformAttribute(attributes_[AttributeType::Tangent], a, Eigen::Vector3f::Zero(), true);
+    }
+}
+
+
+// Transform the items [begin, end) of an interleaved float array. Items are gathered into blocks of
+// struct-of-arrays so that the 3x3 product, translation and normalization are vectorized over the block.
+static void TransformItems(float *data, size_t stride, size_t begin, size_t end,
+                           const Eigen::Matrix3f &a, const Eigen::Vector3f &t, bool normalize) {
+    constexpr int kBlockSize = 256;
+    using Block = Eigen::Matrix<float, Eigen::Dynamic, 3, Eigen::ColMajor, kBlockSize, 3>;
+    using Column = Eigen::Array<float, Eigen::Dynamic, 1, Eigen::ColMajor, kBlockSize, 1>;
+    const Eigen::Matrix3f aT = a.transpose();
+    Block in, out;
+    Column scale;
+
+    for (size_t first = begin; first < end; first += kBlockSize) {
+        const auto n = static_cast<Eigen::Index>(std::min<size_t>(kBlockSize, end - first));
+        float *items = data + first * stride;
+        in.resize(n, 3);
+        for (Eigen::Index i = 0; i < n; ++i) {
+            in(i, 0) = items[i * stride];
+            in(i, 1) = items[i * stride + 1];
+            in(i, 2) = items[i * stride + 2];
+        }
+
+        out.noalias() = in * aT;
+        out.rowwise() += t.transpose();
+        if (normalize) {
+            scale = out.rowwise().squaredNorm().array();
+            scale = (scale > 0.f).select(scale.rsqrt(), 1.f);
+            out.array().colwise() *= scale;
+        }
+
+        for (Eigen::Index i = 0; i < n; ++i) {
+            items[i * stride] = out(i, 0);
+            items[i * stride + 1] = out(i, 1);
+            items[i * stride + 2] = out(i, 2);
         }
-        attributes_["normal"]->SetData(normals);
     }
 }
 
 
+void Geometry::TransformAttribute(const std::shared_ptr<Attribute> &attr, const Eigen::Matrix3f &a,
+                                  const Eigen::Vector3f &t, bool normalize) {
+    if (!attr->HasCpuData()) {
+        std::cerr << "Warning: the CPU data of attribute (" << attr->Name() << ") has been released!\n";
+        return;
+    }
+    if (attr->ElementsPerItem() < 3) {
+        std::cerr << "Warning: attribute (" << attr->Name() << ") has less than 3 elements per item!\n";
+        return;
+    }
+
+    constexpr size_t kGrainSize = 1 << 16;
+    const auto stride = static_cast<size_t>(attr->ElementsPerItem());
+    const auto itemCount = static_cast<size_t>(attr->ItemCount());
+    auto transform = [&](float *data) {
+        ParallelFor(0, itemCount, kGrainSize, [&](size_t begin, size_t end) {
+            TransformItems(data, stride, begin, end, a, t, normalize);
+        });
+    };
+
+    if (attr->IsFloat()) {
+        // In place, only a view is copied
+        transform(attr->MutableData());
+        attr->MarkDirty();
+        return;
+    }
+
+    // Quantized attributes are decoded, transformed and quantized again with the same format, which rounds
+    // the values again each time.
+    const ComponentType componentType = attr->GetComponentType();
+    std::vector<float> data = attr->ToFloat();
+    transform(data.data());
+    attr->SetData(data, true);
+    attr->Quantize(componentType);
+}
+
+
+// Float positions of an attribute, quantized positions are decoded into `decoded`.
+static const float* PositionData(const Attribute &attr, std::vector<float> &decoded) {
+    if (attr.IsFloat()) {
+        return attr.Data();
+    }
+    decoded = attr.ToFloat();
+    return decoded.data();
+}
+
+
+const BoundingBox& Geometry::GetBoundingBox() const {
+    const auto &positions = attributes_[AttributeType::Position];
+    if (!positions) {
+        boundingBox_ = BoundingBox();
+        return boundingBox_;
+    }
+    if (boxSource_ == positions.get() && boxVersion_ == positions->Version()) {
+        return boundingBox_;
+    }
+    if (!positions->HasCpuData()) {
+        std::cerr << "Warning: the CPU data of the positions has been released, the bounds are not updated!\n";
+        return boundingBox_;
+    }
+
+    std::vector<float> decoded;
+    boundingBox_ = ComputeBoundingBox(PositionData(*positions, decoded), positions->ElementsPerItem(),
+                                      positions->ItemCount());
+    boxSource_ = positions.get();
+    boxVersion_ = positions->Version();
+    return boundingBox_;
+}
+
+
+const BoundingSphere& Geometry::GetBoundingSphere() const {
+    const auto &positions = attributes_[AttributeType::Position];
+    if (!positions) {
+        boundingSphere_ = BoundingSphere();
+        return boundingSphere_;
+    }
+    if (sphereSource_ == positions.get() && sphereVersion_ == positions->Version()) {
+        return boundingSphere_;
+    }
+    if (!positions->HasCpuData()) {
+        std::cerr << "Warning: the CPU data of the positions has been released, the bounds are not updated!\n";
+        return boundingSphere_;
+    }
+
+    // Centered on the box, which is close to the smallest sphere for most meshes and cheap to compute.
+    const BoundingBox &box = GetBoundingBox();
+    if (box.IsEmpty()) {
+        boundingSphere_ = BoundingSphere();
+    } else {
+        std::vector<float> decoded;
+        boundingSphere_ = ComputeBoundingSphere(PositionData(*positions, decoded), positions->ElementsPerItem(),
+                                                positions->ItemCount(), box.Center());
+    }
+    sphereSource_ = positions.get();
+    sphereVersion_ = positions->Version();
+    return boundingSphere_;
+}
+
+
 unsigned int Geometry::SubmitToGPU(std::shared_ptr<Shader> program) {
+    // Create GL buffers and submit data
+    UpdateVertexBuffers();
+    UpdateIndexBuffer();
+
     unsigned int vao;
     // Create vertex array
     glGenVertexArrays(1, &vao);
 
     // Bind the vertex array
-    glBindVertexArray(vao);
-
-    // Create GL buffers and submit data
-    for (const auto &it : attributes_) {
-        UpdateAttribute(it.second);
-    }
+    GLStateCache::Instance().BindVertexArray(vao);
 
-    // Submit index buffer
-    if (!indices_.empty()) {
-        glGenBuffers(1, &ebo_);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo_);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizei)(indices_.size() * sizeof(unsigned int)), &indices_[0], GL_STATIC_DRAW);
+    // Bind index buffer
+    if (indexBuffer_.IsValid()) {
+        GLStateCache::Instance().BindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer_.Handle());
     }
 
     // Set vertex attribute pointer
-    const std::map<int, std::string>& attributeLocations = program->AttributeLocations();
-    for (const auto &it : attributeLocations) {
-        const int loc = it.first;
-        const std::string& name = it.second;
-        if (attributes_.find(name) != attributes_.end()) {
-            const auto& attr = attributes_[name];
-            glBindBuffer(GL_ARRAY_BUFFER, attr->VBO());
-            glEnableVertexAttribArray(loc);
-            glVertexAttribPointer(loc,                          // attribute location
-                                  attr->ElementsPerItem(),      // size
-                                  GL_FLOAT,                        // type
-                                  attr->Normalized(),              // normalized ?
-                                  (GLsizei)attr->ItemSize(),     // stride
-                                  (GLvoid*)0                          // array buffer offset
-                                  );
-        }
-    }
-
-    // Unbind the vertex array
-    glBindVertexArray(0);
+    const VertexLayout &layout = program->GetVertexLayout();
+    for (int i = 0; i < kAttribNum; ++i) {
+        const auto type = static_cast<AttributeType>(i);
+        const auto &attr = attributes_[i];
+        if (!attr || !layout.Has(type)) {
+            continue;
+        }
+        const int loc = layout.Location(type);
+        glEnableVertexAttribArray(loc);
+        if (IsStream(attr)) {
+            const auto &ring = streamBuffers_[i];
+            SetAttributePointer(loc, attr, ring->Handle(), attr->ItemSize(), ring->Offset());
+        } else if (interleaved_) {
+            SetAttributePointer(loc, attr, interleavedBuffer_.Handle(), interleavedStride_,
+                                interleavedBuffer_.Offset() + interleavedOffsets_[i]);
+        } else {
+            SetAttributePointer(loc, attr, attr->VBO(), attr->ItemSize(), attr->VBOOffset());
+        }
+    }
 
+    // Left bound, Bind() binds it next
     return vao;
 }
 
 
+void Geometry::SetAttributePointer(int loc, const std::shared_ptr<Attribute> &attr,
+                                   unsigned int vbo, size_t stride, size_t offset) {
+    GLStateCache::Instance().BindBuffer(GL_ARRAY_BUFFER, vbo);
+    glVertexAttribPointer(loc,                          // attribute location
+                          attr->ElementsPerItem(),      // size
+                          GLComponentType(attr->GetComponentType()),   // type
+                          attr->Normalized(),              // normalized ?
+                          (GLsizei)stride,               // stride
+                          (GLvoid*)offset                     // array buffer offset
+                          );
+}
+
+
+void Geometry::UpdateVertexBuffers() {
+    // The bounds can't be computed anymore once the positions are released
+    const auto &positions = attributes_[AttributeType::Position];
+    if (positions && !positions->KeepCpuData() && positions->NeedsUpload()) {
+        GetBoundingSphere();
+    }
+
+    for (const auto &attr : attributes_) {
+        if (attr && IsStream(attr)) {
+            UpdateStreamAttribute(attr);
+        }
+    }
+
+    if (interleaved_) {
+        if (UpdateInterleavedBuffer()) {
+            return;
+        }
+        // Fall back to separate buffers, the vertex arrays must point to the new buffers
+        interleaved_ = false;
+        interleavedBuffer_.Release();
+        ResetVertexArrays();
+        for (const auto &attr : attributes_) {
+            if (attr) {
+                attr->MarkDirty();
+            }
+        }
+    }
+
+    for (const auto &attr : attributes_) {
+        if (attr && !IsStream(attr)) {
+            UpdateAttribute(attr);
+        }
+    }
+}
+
+
 void Geometry::UpdateAttribute(const std::shared_ptr<Attribute>& attr) {
-    const bool isNewBuffer = !attr->VBO();
+    if (attr->VBO() && !attr->NeedsUpload()) {
+        return;
+    }
 
-    // Create GL buffer
-    if (isNewBuffer) {
-        unsigned int vbo = 0;
-        glGenBuffers(1, &vbo);
-        attr->SetVBO(vbo);
+    // Submit data.
+    // Reallocate only if the data outgrows the buffer, otherwise upload the modified range.
+    BufferRange &buffer = attr->GpuBuffer();
+    if (!buffer.IsValid() || attr->TotalSize() > buffer.Capacity()) {
+        if (buffer.Reserve(attr->TotalSize(), GLUsage(attr->Usage()), pool_, attr->RawData())) {
+            // The vertex arrays point to the old location
+            ResetVertexArrays();
+        }
+    } else if (attr->DirtySize() > 0) {
+        const size_t offset = attr->DirtyOffset();
+        const size_t size = std::min(attr->DirtySize(), attr->TotalSize() - offset);
+        buffer.Upload(offset, size, static_cast<const unsigned char*>(attr->RawData()) + offset);
+    }
+    attr->MarkUploaded();
+    if (!attr->KeepCpuData()) {
+        attr->ReleaseCpuData();
     }
+}
 
-    // Bind buffer and submit data
-    glBindBuffer(GL_ARRAY_BUFFER, attr->VBO());
-    if (isNewBuffer) {
-        glBufferData(GL_ARRAY_BUFFER, (GLsizei)(attr->TotalSize()), attr->GetData().data(), GL_STATIC_DRAW);
-    } else {
-        glBufferSubData(GL_ARRAY_BUFFER, 0, (GLsizei)(attr->TotalSize()), attr->GetData().data());
+
+void Geometry::UpdateStreamAttribute(const std::shared_ptr<Attribute> &attr) {
+    auto &ring = streamBuffers_[attr->Type()];
+    if (!ring) {
+        ring = std::make_shared<RingBuffer>();
+        streamMask_ |= 1u << attr->Type();
+    }
+    if (!attr->NeedsUpload()) {
+        return;
     }
 
+    // Streamed data is rewritten as a whole, into the region the GPU isn't reading.
+    if (attr->TotalSize() > 0) {
+        ring->Write(attr->RawData(), attr->TotalSize());
+    }
+    attr->MarkUploaded();
+    if (!attr->KeepCpuData()) {
+        attr->ReleaseCpuData();
+    }
 }
 
 
-void Geometry::Draw(std::shared_ptr<Shader> program, int drawMode) {
-    const std::string &attributeLocationsStr = program->AttributeLocationsStr();
-    unsigned int vao = 0;
-    if (vaos_.find(attributeLocationsStr) == vaos_.end()) {
-        vao = SubmitToGPU(program);
-        vaos_[attributeLocationsStr] = vao;
+void Geometry::UpdateIndexBuffer() {
+    if (indexBuffer_.IsValid() && indexVersion_ == uploadedIndexVersion_) {
+        return;
+    }
+    if (indices_.empty()) {
+        uploadedIndexVersion_ = indexVersion_;
+        return;
+    }
+
+    // Pick the narrowest index type that fits the largest index
+    const unsigned int maxIndex = *std::max_element(indices_.begin(), indices_.end());
+    GLenum glIndexType = GL_UNSIGNED_INT;
+    if (indexType_ == IndexType::UnsignedByte && maxIndex <= 0xff) {
+        glIndexType = GL_UNSIGNED_BYTE;
+    } else if (indexType_ != IndexType::UnsignedInt && maxIndex <= 0xffff) {
+        glIndexType = GL_UNSIGNED_SHORT;
+    }
+    glIndexType_ = glIndexType;
+
+    std::vector<unsigned char> narrowed;
+    const void *data = indices_.data();
+    size_t size = indices_.size() * sizeof(unsigned int);
+    if (glIndexType == GL_UNSIGNED_SHORT) {
+        narrowed.resize(indices_.size() * sizeof(uint16_t));
+        auto *dst = reinterpret_cast<uint16_t*>(narrowed.data());
+        std::transform(indices_.begin(), indices_.end(), dst, [](unsigned int i) { return (uint16_t)i; });
+    } else if (glIndexType == GL_UNSIGNED_BYTE) {
+        narrowed.resize(indices_.size());
+        std::transform(indices_.begin(), indices_.end(), narrowed.begin(), [](unsigned int i) { return (uint8_t)i; });
+    }
+    if (!narrowed.empty()) {
+        data = narrowed.data();
+        size = narrowed.size();
+    }
+
+    // The element array binding belongs to the vertex array, so the upload goes through another target.
+    // The existing vertex arrays know nothing about a new index buffer.
+    if (!indexBuffer_.IsValid() || size > indexBuffer_.Capacity()) {
+        if (indexBuffer_.Reserve(size, GL_STATIC_DRAW, pool_, data)) {
+            ResetVertexArrays();
+        }
     } else {
-        vao = vaos_[attributeLocationsStr];
+        indexBuffer_.Upload(0, size, data);
     }
+    uploadedIndexVersion_ = indexVersion_;
+    UpdateDrawOffsets();
+}
 
-    // TODO: check if any attribute needs update
 
-    // Bind vertex array
-    glBindVertexArray(vao);
+void Geometry::UpdateDrawOffsets() {
+    size_t indexSize = sizeof(unsigned int);
+    if (glIndexType_ == GL_UNSIGNED_SHORT) {
+        indexSize = sizeof(uint16_t);
+    } else if (glIndexType_ == GL_UNSIGNED_BYTE) {
+        indexSize = sizeof(uint8_t);
+    }
+    drawCounts_.clear();
+    drawOffsets_.clear();
+    drawBaseVertices_.clear();
+    for (const auto &range : drawRanges_) {
+        drawCounts_.push_back((GLsizei)range.indexCount);
+        drawOffsets_.push_back((const void*)(indexBuffer_.Offset() + range.firstIndex * indexSize));
+        drawBaseVertices_.push_back(range.baseVertex);
+    }
+}
 
-    // Draw
-    if (indices_.empty()) {
-        glDrawArrays(drawMode, 0, (GLsizei)attributes_["position"]->ItemCount());
+
+bool Geometry::UpdateInterleavedBuffer() {
+    // Streamed attributes live in their own ring buffers
+    std::vector<AttributePtr> attributes;
+    for (const auto &attr : attributes_) {
+        if (attr && !IsStream(attr)) {
+            attributes.push_back(attr);
+        }
+    }
+    if (attributes.empty()) {
+        return true;
+    }
+
+    // Compute the offset of each attribute and the vertex stride
+    const int itemCount = attributes.front()->ItemCount();
+    std::array<size_t, kAttribNum> offsets{};
+    size_t stride = 0;
+    bool dynamic = false;
+    for (const auto &attr : attributes) {
+        dynamic = dynamic || attr->Usage() == BufferUsage::Dynamic;
+        if (attr->ItemCount() != itemCount) {
+            std::cerr << "Warning: attribute (" << attr->Name() << ") has " << attr->ItemCount()
+                      << " items, expected " << itemCount << ". Fall back to separate vertex buffers.\n";
+            return false;
+        }
+        offsets[attr->Type()] = stride;
+        // Keep every attribute 4-byte aligned, e.g. 3 unsigned byte colors take 4 bytes
+        stride += (attr->ItemSize() + 3) & ~size_t(3);
+    }
+
+    // A new layout invalidates the attribute pointers recorded in the vertex arrays
+    if (stride != interleavedStride_ || offsets != interleavedOffsets_) {
+        interleavedStride_ = stride;
+        interleavedOffsets_ = offsets;
+        ResetVertexArrays();
+    }
+
+    // Find the range of vertices to upload
+    int firstItem = itemCount;
+    int lastItem = 0;
+    const bool fullUpload = !interleavedBuffer_.IsValid() || interleavedBuffer_.Capacity() < stride * itemCount;
+    for (const auto &attr : attributes) {
+        if (fullUpload || attr->DirtySize() == attr->TotalSize()) {
+            firstItem = 0;
+            lastItem = itemCount;
+        } else if (attr->NeedsUpload()) {
+            const size_t itemSize = attr->ItemSize();
+            firstItem = std::min(firstItem, (int)(attr->DirtyOffset() / itemSize));
+            lastItem = std::max(lastItem, (int)((attr->DirtyOffset() + attr->DirtySize() + itemSize - 1) / itemSize));
+        }
+    }
+    lastItem = std::min(lastItem, itemCount);
+    if (firstItem >= lastItem) {
+        return true;
+    }
+
+    // Every attribute is needed to re-pack the vertices
+    for (const auto &attr : attributes) {
+        if (!attr->HasCpuData()) {
+            std::cerr << "Warning: the CPU data of attribute (" << attr->Name() << ") has been released, "
+                      << "set data of all attributes to update an interleaved geometry!\n";
+            for (const auto &other : attributes) {
+                other->MarkUploaded();
+            }
+            return true;
+        }
+    }
+
+    // Pack the attributes vertex by vertex
+    std::vector<unsigned char> vertices(interleavedStride_ * (lastItem - firstItem));
+    for (const auto &attr : attributes) {
+        const size_t itemSize = attr->ItemSize();
+        const auto *src = static_cast<const unsigned char*>(attr->RawData()) + firstItem * itemSize;
+        unsigned char *dst = vertices.data() + interleavedOffsets_[attr->Type()];
+        for (int i = firstItem; i < lastItem; ++i) {
+            memcpy(dst, src, itemSize);
+            src += itemSize;
+            dst += interleavedStride_;
+        }
+    }
+    for (const auto &attr : attributes) {
+        attr->MarkUploaded();
+        if (!attr->KeepCpuData()) {
+            attr->ReleaseCpuData();
+        }
+    }
+
+    // Submit data, reallocate only if the vertices outgrow the buffer
+    if (fullUpload) {
+        if (interleavedBuffer_.Reserve(vertices.size(), dynamic ? GL_DYNAMIC_DRAW : GL_STATIC_DRAW,
+                                       pool_, vertices.data())) {
+            ResetVertexArrays();
+        }
     } else {
-        glDrawElements(drawMode, (GLsizei)indices_.size(), GL_UNSIGNED_INT, 0);
+        interleavedBuffer_.Upload(firstItem * interleavedStride_, vertices.size(), vertices.data());
     }
+    return true;
+}
+
 
-    // Unbind the vertex array
-    glBindVertexArray(0);
+void Geometry::ResetVertexArrays() {
+    for (const auto &it : vaos_) {
+        if (GLContext::IsAlive()) {
+            GLStateCache::Instance().ForgetVertexArray(it.second);
+            glDeleteVertexArrays(1, &it.second);
+        }
+    }
+    vaos_.clear();
 }
 
 
+VertexLayout Geometry::LayoutFor(const Shader &program) const {
+    VertexLayout layout = program.GetVertexLayout();
+    for (int i = 0; i < kAttribNum; ++i) {
+        const auto type = static_cast<AttributeType>(i);
+        if (!layout.Has(type)) {
+            continue;
+        }
+        if (attributes_[i]) {
+            layout.SetFormat(type, *attributes_[i]);
+        } else {
+            layout.SetLocation(type, -1);
+        }
+    }
+    return layout;
+}
 
 
+void Geometry::Draw(std::shared_ptr<Shader> program, int drawMode) {
+    // The vertex array stays bound, the next draw of the geometry doesn't bind it again
+    Bind(program);
+    DrawBound(drawMode);
+}
 
 
+void Geometry::Bind(const std::shared_ptr<Shader> &program) {
+    // The pool has moved its ranges, the vertex arrays and index offsets are outdated
+    if (pool_ && pool_->Generation() != poolGeneration_) {
+        poolGeneration_ = pool_->Generation();
+        ResetVertexArrays();
+        UpdateDrawOffsets();
+    }
+
+    // Upload the data modified since the last draw
+    UpdateVertexBuffers();
+    UpdateIndexBuffer();
+
+    // The layout includes the attribute formats, so quantizing an attribute gets a new vertex array
+    const VertexLayout layout = LayoutFor(*program);
+    const uint64_t layoutHash = layout.Hash();
+    unsigned int vao = 0;
+    for (const auto &it : vaos_) {
+        if (it.first == layoutHash) {
+            vao = it.second;
+            break;
+        }
+    }
+    if (vao == 0) {
+        vao = SubmitToGPU(program);
+        vaos_.emplace_back(layoutHash, vao);
+    }
+
+    // Bind vertex array
+    GLStateCache::Instance().BindVertexArray(vao);
+
+    // Point streamed attributes to the region written last
+    const uint32_t streamed = streamMask_ & layout.Mask();
+    for (int i = 0; streamed != 0 && i < kAttribNum; ++i) {
+        if (streamed & (1u << i)) {
+            const auto &attr = attributes_[i];
+            const auto &ring = streamBuffers_[i];
+            SetAttributePointer(layout.Location(static_cast<AttributeType>(i)), attr,
+                                ring->Handle(), attr->ItemSize(), ring->Offset());
+        }
+    }
+}
+
+
+void Geometry::DrawBound(int drawMode, int instanceCount) {
+    if (instanceCount <= 0) {
+        return;
+    }
+    if (indices_.empty()) {
+        const auto &position = attributes_[AttributeType::Position];
+        const GLsizei count = position ? (GLsizei)position->ItemCount() : 0;
+        if (instanceCount == 1) {
+            glDrawArrays(drawMode, 0, count);
+        } else {
+            glDrawArraysInstanced(drawMode, 0, count, instanceCount);
+        }
+    } else if (!drawRanges_.empty()) {
+        if (instanceCount == 1) {
+            glMultiDrawElementsBaseVertex(drawMode, drawCounts_.data(), glIndexType_, drawOffsets_.data(),
+                                          (GLsizei)drawCounts_.size(), drawBaseVertices_.data());
+        } else {
+            for (size_t i = 0; i < drawCounts_.size(); ++i) {
+                glDrawElementsInstancedBaseVertex(drawMode, drawCounts_[i], glIndexType_, drawOffsets_[i],
+                                                  instanceCount, drawBaseVertices_[i]);
+            }
+        }
+    } else if (instanceCount == 1) {
+        glDrawElements(drawMode, (GLsizei)indices_.size(), glIndexType_, (const void*)indexBuffer_.Offset());
+    } else {
+        glDrawElementsInstanced(drawMode, (GLsizei)indices_.size(), glIndexType_,
+                                (const void*)indexBuffer_.Offset(), instanceCount);
+    }
+
+    // Keep the regions read by this draw from being overwritten until the GPU is done
+    for (const auto &ring : streamBuffers_) {
+        if (ring) {
+            ring->Fence();
+        }
+    }
+}
+
 
-} // namespace vivid
\ No newline at end of file
+} // namespace vivid
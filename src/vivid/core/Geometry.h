@@ -1,56 +1,204 @@
 #pragma once
 
 #include <iostream>
-#include <map>
+#include <array>
+#include <vector>
 #include <memory>
 #include <glad/glad.h>
 #include <Eigen/Dense>
 #include "Attribute.h"
+#include "Bounds.h"
+#include "BufferPool.h"
+#include "RingBuffer.h"
 #include "Shader.h"
+#include "VertexLayout.h"
 
 
 namespace vivid {
 
+// Storage type of the index buffer.
+enum class IndexType : int {
+    Auto = 0,       // 16-bit when all indices fit, 32-bit otherwise
+    UnsignedByte,   // only when requested, most GPUs convert 8-bit indices on the fly
+    UnsignedShort,
+    UnsignedInt
+};
+
+// A sub-mesh of a geometry: `indexCount` indices from `firstIndex`, offset by `baseVertex`.
+struct DrawRange {
+    unsigned int firstIndex;
+    unsigned int indexCount;
+    int baseVertex;
+};
+
 class Geometry {
 public:
     Geometry() = default;
 
+    // Delete the vertex arrays, the buffers are released by their owners.
+    virtual ~Geometry();
+
+    Geometry(const Geometry&) = delete;
+    Geometry& operator=(const Geometry&) = delete;
+
     Geometry(const std::vector<float> *positions,
              const std::vector<float> *uvs,
              const std::vector<float> *normals);
 
+    // Take over the vertex data without copying it, empty vectors are skipped.
+    Geometry(std::vector<float> &&positions,
+             std::vector<float> &&uvs,
+             std::vector<float> &&normals);
+
+    // Add an attribute, replacing the one of the same type if any.
     void AddAttribute(std::shared_ptr<Attribute> attr);
 
+    // The attribute of the given type, null if absent.
+    inline const AttributePtr& GetAttribute(AttributeType type) const { return attributes_[type]; }
+
     void SetIndex(std::vector<unsigned int> &indices, bool useMove = false);
 
+    inline const std::vector<unsigned int>& GetIndex() const { return indices_; }
+
+    // Draw only these ranges of the index buffer, with a single multi-draw call.
+    // Indices are relative to the base vertex of their range, which keeps them small.
+    void SetDrawRanges(const std::vector<DrawRange> &ranges);
+    inline const std::vector<DrawRange>& GetDrawRanges() const { return drawRanges_; }
+
+    // Index type used on GPU, indices that don't fit the requested type fall back to a wider one.
+    void SetIndexType(IndexType type);
+
+    // Reorder the triangles for the post-transform vertex cache, then the vertices in the order they are
+    // first used. Vertex reordering changes the vertex indices, so it can be turned off for geometries
+    // whose attributes are later updated by index (e.g. UpdateItems or streamed attributes).
+    // Only indexed triangle lists are optimized.
+    void Optimize(bool reorderVertices = true);
+
     void Translate(float x, float y, float z);
 
     void Rotate(float angle, const Eigen::Vector3f &axis);
 
+    // Transform the vertices in place: positions by the affine part of m, normals by its inverse transpose
+    // and tangents by its linear part. Large attributes are processed on several threads.
+    // Quantized attributes are decoded and quantized again, losing precision on every call: transform before
+    // quantizing. Positions in a normalized format are refused, as they would be clamped to [-1, 1].
+    void Transform(const Eigen::Matrix4f &m);
+
+    // Bounds of the positions, computed on first use and again after the positions change.
+    // Once the CPU data of the positions is released, the last bounds are kept.
+    const BoundingBox& GetBoundingBox() const;
+    const BoundingSphere& GetBoundingSphere() const;
+
+    // Pack all attributes into one vertex buffer (position, normal, uv, ... of a vertex are
+    // stored contiguously) instead of one buffer per attribute. Must be set before the first draw.
+    inline void SetInterleaved(bool interleaved) { interleaved_ = interleaved; }
+    inline bool IsInterleaved() const { return interleaved_; }
+
+    // Set the usage of all the attributes, e.g. BufferUsage::Stream for data rewritten every frame.
+    // Must be set before the first draw.
+    void SetUsage(BufferUsage usage);
+
+    // Suballocate the vertex and index buffers from a pool instead of owning one buffer object each,
+    // streamed attributes excepted. The data is uploaded again on the next draw.
+    void SetBufferPool(const BufferPoolPtr &pool);
+    inline const BufferPoolPtr& GetBufferPool() const { return pool_; }
+
+    // Keep the CPU copy of all the attributes after uploading? Releasing it halves the memory of
+    // static geometry, at the price of Translate/Rotate and partial updates.
+    void SetKeepCpuData(bool keep);
+
     // Submit this geometry to GPU.
     unsigned int SubmitToGPU(std::shared_ptr<Shader> program);
 
     // Draw
     void Draw(std::shared_ptr<Shader> program, int drawMode = GL_TRIANGLES);
 
+    // Upload the modified data and bind the vertex array for the program, so that the caller can add
+    // per-instance attributes before DrawBound().
+    void Bind(const std::shared_ptr<Shader> &program);
+
+    // Draw with the vertex array bound by Bind(), which stays bound. More than one instance uses
+    // instanced drawing.
+    void DrawBound(int drawMode = GL_TRIANGLES, int instanceCount = 1);
+
 
 protected:
 
-    static void UpdateAttribute(const std::shared_ptr<Attribute>& attr);
+    // Upload the vertex data modified since the last upload.
+    void UpdateVertexBuffers();
+
+    void UpdateAttribute(const std::shared_ptr<Attribute>& attr);
+
+    // Write the attribute into the next region of its ring buffer
+    void UpdateStreamAttribute(const std::shared_ptr<Attribute>& attr);
+
+    static void SetAttributePointer(int loc, const std::shared_ptr<Attribute>& attr,
+                                    unsigned int vbo, size_t stride, size_t offset);
+
+    void UpdateIndexBuffer();
 
-    // The attributes of this geometry.
-    std::map<std::string, std::shared_ptr<Attribute>> attributes_;
+    // Byte offsets of the draw ranges in the index buffer
+    void UpdateDrawOffsets();
+
+    // Compute v = a * v + t for the xyz of every item, optionally normalized, keeping the storage format.
+    static void TransformAttribute(const std::shared_ptr<Attribute> &attr, const Eigen::Matrix3f &a,
+                                   const Eigen::Vector3f &t, bool normalize);
+
+    // Build or update the interleaved vertex buffer. Return false if the attributes can't be interleaved.
+    bool UpdateInterleavedBuffer();
+
+    // Delete vertex arrays, they are recreated on the next draw.
+    void ResetVertexArrays();
+
+    // Format of the attributes of this geometry, for the attribute types used by the shader.
+    VertexLayout LayoutFor(const Shader &program) const;
+
+    // The attributes of this geometry, indexed by AttributeType.
+    std::array<AttributePtr, kAttribNum> attributes_;
 
     // Indices
     std::vector<unsigned int> indices_;
+    unsigned int indexVersion_ = 0;
+    unsigned int uploadedIndexVersion_ = 0;
+    IndexType indexType_ = IndexType::Auto;
+    unsigned int glIndexType_ = GL_UNSIGNED_INT;   // type of the uploaded indices
 
-    // Vertex array object handles.
-    // We create a vertex array object for each attributeLocations, so that we can
-    // render the same geometry with different shaders.
-    std::map<std::string, unsigned int> vaos_;
+    // Sub-meshes, and the arguments of glMultiDrawElementsBaseVertex derived from them
+    std::vector<DrawRange> drawRanges_;
+    std::vector<GLsizei> drawCounts_;
+    std::vector<const void*> drawOffsets_;
+    std::vector<GLint> drawBaseVertices_;
 
-    // Index buffer object handle
-    unsigned int ebo_ = 0;
+    // Vertex array object handles.
+    // We create a vertex array object for each vertex layout, so that we can
+    // render the same geometry with different shaders. A geometry sees a handful of layouts at most,
+    // so a linear search on the layout hash is the fastest lookup.
+    std::vector<std::pair<uint64_t, unsigned int>> vaos_;
+
+    // Index buffer object
+    BufferRange indexBuffer_;
+
+    // Pool of the vertex and index buffers, if any, and its generation when the vertex arrays were built
+    BufferPoolPtr pool_;
+    unsigned int poolGeneration_ = 0;
+
+    // Interleaved vertex buffer
+    bool interleaved_ = false;
+    BufferRange interleavedBuffer_;
+    size_t interleavedStride_ = 0;
+    std::array<size_t, kAttribNum> interleavedOffsets_{};   // byte offset of each attribute in a vertex
+
+    // Cached bounds, and the position attribute and version they were computed from
+    mutable BoundingBox boundingBox_;
+    mutable BoundingSphere boundingSphere_;
+    mutable const Attribute *boxSource_ = nullptr;
+    mutable const Attribute *sphereSource_ = nullptr;
+    mutable unsigned int boxVersion_ = 0;
+    mutable unsigned int sphereVersion_ = 0;
+
+    // Ring buffers of the attributes with BufferUsage::Stream, they are never interleaved.
+    std::array<RingBufferPtr, kAttribNum> streamBuffers_;
+    uint32_t streamMask_ = 0;   // bit i is set if attribute type i is streamed
 
 };
 
@@ -0,0 +1,243 @@
+#include <algorithm>
+#include <utility>
+#include <glad/glad.h>
+#include "vivid/core/InstancedMesh.h"
+#include "vivid/core/GLContext.h"
+#include "vivid/core/GLStateCache.h"
+
+namespace vivid {
+
+// Texture units of the instance texture buffers, above the ones used by materials
+constexpr int kMatrixTextureUnit = 14;
+constexpr int kColorTextureUnit = 15;
+
+static const UniformHandle kInstanceMatrices("uInstanceMatrices");
+static const UniformHandle kInstanceColors("uInstanceColors");
+
+
+InstancedMesh::InstancedMesh(GeometryPtr geometry, MaterialPtr material, int instanceCount)
+    : Mesh(std::move(geometry), std::move(material))
+{
+    SetInstanceCount(instanceCount);
+}
+
+
+InstancedMesh::~InstancedMesh() {
+    if (!GLContext::IsAlive()) {
+        return;
+    }
+    GLStateCache &gl = GLStateCache::Instance();
+    gl.ForgetTexture(matrixTexture_);
+    gl.ForgetTexture(colorTexture_);
+    gl.ForgetBuffer(matrixBuffer_);
+    gl.ForgetBuffer(colorBuffer_);
+    glDeleteTextures(1, &matrixTexture_);
+    glDeleteTextures(1, &colorTexture_);
+    glDeleteBuffers(1, &matrixBuffer_);
+    glDeleteBuffers(1, &colorBuffer_);
+}
+
+
+void InstancedMesh::SetInstanceCount(int count) {
+    const int oldCount = instanceCount_;
+    instanceCount_ = std::max(count, 0);
+    matrices_.resize(instanceCount_ * 16);
+    colors_.resize(instanceCount_ * 4, 255);
+    for (int i = oldCount; i < instanceCount_; ++i) {
+        Eigen::Map<Eigen::Matrix4f> matrix(&matrices_[i * 16]);
+        matrix.setIdentity();
+    }
+    dirtyBegin_ = 0;
+    dirtyEnd_ = instanceCount_;
+    boundsBegin_ = 0;
+    boundsEnd_ = instanceCount_;
+}
+
+
+void InstancedMesh::SetMatrixAt(int index, const Eigen::Matrix4f &m) {
+    if (index < 0 || index >= instanceCount_) {
+        std::cerr << "Warning: instance " << index << " out of range!\n";
+        return;
+    }
+    Eigen::Map<Eigen::Matrix4f> matrix(&matrices_[index * 16]);
+    matrix = m;
+    dirtyBegin_ = dirtyEnd_ > dirtyBegin_ ? std::min(dirtyBegin_, index) : index;
+    dirtyEnd_ = std::max(dirtyEnd_, index + 1);
+    boundsBegin_ = boundsEnd_ > boundsBegin_ ? std::min(boundsBegin_, index) : index;
+    boundsEnd_ = std::max(boundsEnd_, index + 1);
+}
+
+
+void InstancedMesh::SetTransformAt(int index, const Eigen::Vector3f &position,
+                                   const Eigen::Quaternionf &rotation, const Eigen::Vector3f &scale) {
+    Eigen::Matrix4f m = Eigen::Matrix4f::Identity();
+    m.topLeftCorner<3, 3>() = rotation.toRotationMatrix() * scale.asDiagonal();
+    m.topRightCorner<3, 1>() = position;
+    SetMatrixAt(index, m);
+}
+
+
+Eigen::Matrix4f InstancedMesh::GetMatrixAt(int index) const {
+    if (index < 0 || index >= instanceCount_) {
+        return Eigen::Matrix4f::Identity();
+    }
+    return Eigen::Map<const Eigen::Matrix4f>(&matrices_[index * 16]);
+}
+
+
+void InstancedMesh::SetColorAt(int index, const glm::vec3 &color, float alpha) {
+    if (index < 0 || index >= instanceCount_) {
+        std::cerr << "Warning: instance " << index << " out of range!\n";
+        return;
+    }
+    const glm::vec4 rgba = glm::clamp(glm::vec4(color, alpha), 0.f, 1.f) * 255.f + 0.5f;
+    for (int k = 0; k < 4; ++k) {
+        colors_[index * 4 + k] = static_cast<unsigned char>(rgba[k]);
+    }
+    dirtyBegin_ = dirtyEnd_ > dirtyBegin_ ? std::min(dirtyBegin_, index) : index;
+    dirtyEnd_ = std::max(dirtyEnd_, index + 1);
+}
+
+
+const BoundingBox& InstancedMesh::GetBoundingBox() const {
+    const BoundingBox &geometryBox = Mesh::GetBoundingBox();
+    if (geometryBox.min != boundsGeometry_.min || geometryBox.max != boundsGeometry_.max) {
+        boundsGeometry_ = geometryBox;
+        boundsBegin_ = 0;
+        boundsEnd_ = instanceCount_;
+    }
+    if (boundsEnd_ > boundsBegin_ || instanceBoxes_.size() != static_cast<size_t>(instanceCount_)) {
+        instanceBoxes_.resize(instanceCount_);
+        const int end = std::min(boundsEnd_, instanceCount_);
+        for (int i = boundsBegin_; i < end; ++i) {
+            instanceBoxes_[i] = geometryBox.Transformed(Eigen::Map<const Eigen::Matrix4f>(&matrices_[i * 16]));
+        }
+        bounds_ = BoundingBox();
+        for (const BoundingBox &box : instanceBoxes_) {
+            bounds_.Expand(box);
+        }
+        boundingSphere_ = bounds_.IsEmpty() ? BoundingSphere()
+                                            : BoundingSphere(bounds_.Center(), bounds_.Extents().norm());
+        boundsBegin_ = boundsEnd_ = 0;
+    }
+    return bounds_;
+}
+
+
+const BoundingSphere& InstancedMesh::GetBoundingSphere() const {
+    GetBoundingBox();
+    return boundingSphere_;
+}
+
+
+void InstancedMesh::UpdateInstanceBuffers() {
+    if (!matrixBuffer_) {
+        glGenBuffers(1, &matrixBuffer_);
+        glGenBuffers(1, &colorBuffer_);
+    }
+
+    if (instanceCount_ > bufferCapacity_) {
+        // Reallocate, leaving room to grow
+        bufferCapacity_ = instanceCount_ + instanceCount_ / 2;
+        GLStateCache::Instance().BindBuffer(GL_ARRAY_BUFFER, matrixBuffer_);
+        glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)(bufferCapacity_ * 16 * sizeof(float)), nullptr, GL_DYNAMIC_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, (GLsizeiptr)(matrices_.size() * sizeof(float)), matrices_.data());
+        GLStateCache::Instance().BindBuffer(GL_ARRAY_BUFFER, colorBuffer_);
+        glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)(bufferCapacity_ * 4), nullptr, GL_DYNAMIC_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, (GLsizeiptr)colors_.size(), colors_.data());
+    } else if (dirtyEnd_ > dirtyBegin_) {
+        const int end = std::min(dirtyEnd_, instanceCount_);
+        GLStateCache::Instance().BindBuffer(GL_ARRAY_BUFFER, matrixBuffer_);
+        glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)(dirtyBegin_ * 16 * sizeof(float)),
+                        (GLsizeiptr)((end - dirtyBegin_) * 16 * sizeof(float)), &matrices_[dirtyBegin_ * 16]);
+        GLStateCache::Instance().BindBuffer(GL_ARRAY_BUFFER, colorBuffer_);
+        glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)(dirtyBegin_ * 4),
+                        (GLsizeiptr)((end - dirtyBegin_) * 4), &colors_[dirtyBegin_ * 4]);
+    }
+    dirtyBegin_ = dirtyEnd_ = 0;
+}
+
+
+void InstancedMesh::BindInstanceAttributes(const ShaderPtr &shader, bool bind) {
+    if (locationShader_.lock() != shader) {
+        locationShader_ = shader;
+        matrixLocation_ = shader->GetAttributeLocation("instanceMatrix");
+        colorLocation_ = shader->GetAttributeLocation("instanceColor");
+    }
+
+    // A mat4 attribute takes 4 consecutive locations, one per column
+    if (matrixLocation_ >= 0) {
+        GLStateCache::Instance().BindBuffer(GL_ARRAY_BUFFER, matrixBuffer_);
+        for (int i = 0; i < 4; ++i) {
+            const GLuint loc = matrixLocation_ + i;
+            if (bind) {
+                glEnableVertexAttribArray(loc);
+                glVertexAttribPointer(loc, 4, GL_FLOAT, GL_FALSE, 16 * sizeof(float),
+                                      (GLvoid*)(i * 4 * sizeof(float)));
+                glVertexAttribDivisor(loc, 1);
+            } else {
+                // Leave the vertex array of the geometry as it was for non-instanced draws
+                glVertexAttribDivisor(loc, 0);
+                glDisableVertexAttribArray(loc);
+            }
+        }
+    }
+    if (colorLocation_ >= 0) {
+        GLStateCache::Instance().BindBuffer(GL_ARRAY_BUFFER, colorBuffer_);
+        if (bind) {
+            glEnableVertexAttribArray(colorLocation_);
+            glVertexAttribPointer(colorLocation_, 4, GL_UNSIGNED_BYTE, GL_TRUE, 4, (GLvoid*)0);
+            glVertexAttribDivisor(colorLocation_, 1);
+        } else {
+            glVertexAttribDivisor(colorLocation_, 0);
+            glDisableVertexAttribArray(colorLocation_);
+        }
+    }
+}
+
+
+void InstancedMesh::BindInstanceTextures(const ShaderPtr &shader) {
+    if (!matrixTexture_) {
+        glGenTextures(1, &matrixTexture_);
+        GLStateCache::Instance().BindTexture(GL_TEXTURE_BUFFER, matrixTexture_);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, matrixBuffer_);
+        glGenTextures(1, &colorTexture_);
+        GLStateCache::Instance().BindTexture(GL_TEXTURE_BUFFER, colorTexture_);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA8, colorBuffer_);
+    }
+
+    GLStateCache &gl = GLStateCache::Instance();
+    gl.BindTexture(kMatrixTextureUnit, GL_TEXTURE_BUFFER, matrixTexture_);
+    shader->SetInt(kInstanceMatrices, kMatrixTextureUnit);
+    gl.BindTexture(kColorTextureUnit, GL_TEXTURE_BUFFER, colorTexture_);
+    shader->SetInt(kInstanceColors, kColorTextureUnit);
+}
+
+
+void InstancedMesh::Draw(const CameraPtr& cam, const ShaderPtr& shader, int drawMode, bool useMaterial) {
+    if (instanceCount_ == 0) {
+        return;
+    }
+    shader->Use();
+
+    // The matrices of the mesh apply to all the instances
+    SetMatrixUniforms(cam, shader);
+    if (material_ != nullptr && useMaterial) {
+        material_->SetUniforms(shader);
+    }
+
+    UpdateInstanceBuffers();
+
+    if (shader->HasUniform(kInstanceMatrices)) {
+        BindInstanceTextures(shader);
+        geometry_->Bind(shader);
+        geometry_->DrawBound(drawMode, instanceCount_);
+    } else {
+        geometry_->Bind(shader);
+        BindInstanceAttributes(shader, true);
+        geometry_->DrawBound(drawMode, instanceCount_);
+        BindInstanceAttributes(shader, false);
+    }
+}
+
+} // namespace vivid
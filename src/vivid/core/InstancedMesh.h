@@ -0,0 +1,97 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <memory>
+#include <glm/glm.hpp>
+#include <Eigen/Dense>
+#include "vivid/core/Mesh.h"
+
+namespace vivid {
+
+/* Many copies of a geometry drawn in a single call. Each instance has its own transform (with the scale
+ * baked in) and color, stored in instance buffers.
+ *
+ * The shader reads them either as vertex attributes `instanceMatrix` (mat4) and `instanceColor` (vec4),
+ * advanced once per instance, or from the texture buffers `uInstanceMatrices` (4 texels per instance) and
+ * `uInstanceColors` indexed by gl_InstanceID, for shaders without enough free attribute locations.
+ * See ShaderImpl::GetInstancedShader() and ShaderImpl::GetInstancedTextureBufferShader().
+ */
+class InstancedMesh : public Mesh {
+public:
+    InstancedMesh(GeometryPtr geometry, MaterialPtr material, int instanceCount);
+
+    ~InstancedMesh();
+
+    InstancedMesh(const InstancedMesh&) = delete;
+    InstancedMesh& operator=(const InstancedMesh&) = delete;
+
+    inline int InstanceCount() const { return instanceCount_; }
+
+    // New instances get the identity transform and white color.
+    void SetInstanceCount(int count);
+
+    // Transform of an instance, relative to the transform of the mesh.
+    void SetMatrixAt(int index, const Eigen::Matrix4f &m);
+
+    void SetTransformAt(int index, const Eigen::Vector3f &position,
+                        const Eigen::Quaternionf &rotation = Eigen::Quaternionf::Identity(),
+                        const Eigen::Vector3f &scale = Eigen::Vector3f::Ones());
+
+    Eigen::Matrix4f GetMatrixAt(int index) const;
+
+    // Color of an instance, stored as 8-bit RGBA.
+    void SetColorAt(int index, const glm::vec3 &color, float alpha = 1.f);
+
+    // Union of the bounds of the instances, in the frame of the mesh. The box of an instance is only
+    // recomputed after its matrix changes, or the bounds of the geometry do.
+    const BoundingBox& GetBoundingBox() const override;
+
+    // Sphere enclosing GetBoundingBox()
+    const BoundingSphere& GetBoundingSphere() const override;
+
+    void Draw(const CameraPtr& cam, const ShaderPtr& shader,
+              int drawMode = GL_TRIANGLES, bool useMaterial = true) override;
+
+private:
+    // Upload the instances modified since the last draw
+    void UpdateInstanceBuffers();
+
+    void BindInstanceAttributes(const ShaderPtr &shader, bool bind);
+
+    void BindInstanceTextures(const ShaderPtr &shader);
+
+    int instanceCount_ = 0;
+
+    std::vector<float> matrices_;        // 16 floats per instance, column-major
+    std::vector<unsigned char> colors_;  // RGBA per instance
+
+    // Instances modified since the last upload
+    int dirtyBegin_ = 0;
+    int dirtyEnd_ = 0;
+
+    // Bounds of each instance and their union, with the instances moved since and the geometry bounds used
+    mutable std::vector<BoundingBox> instanceBoxes_;
+    mutable BoundingBox bounds_;
+    mutable BoundingSphere boundingSphere_;
+    mutable BoundingBox boundsGeometry_;
+    mutable int boundsBegin_ = 0;
+    mutable int boundsEnd_ = 0;
+
+    unsigned int matrixBuffer_ = 0;
+    unsigned int colorBuffer_ = 0;
+    int bufferCapacity_ = 0;   // in instances
+
+    // Texture buffers viewing the instance buffers
+    unsigned int matrixTexture_ = 0;
+    unsigned int colorTexture_ = 0;
+
+    // Attribute locations of the last shader
+    std::weak_ptr<Shader> locationShader_;
+    int matrixLocation_ = -1;
+    int colorLocation_ = -1;
+};
+
+using InstancedMeshPtr = std::shared_ptr<InstancedMesh>;
+
+} // namespace vivid
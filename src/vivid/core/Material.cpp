@@ -3,3 +3,22 @@
 //
 
 #include "Material.h"
+
+namespace vivid {
+
+const ShaderPtr& Material::GetShader() const {
+    if (shader_ != nullptr || variants_ == nullptr) {
+        return shader_;
+    }
+    return variants_->Get(FeatureMask());
+}
+
+
+
+void Material::SubmitShader() const {
+    if (shader_ == nullptr && variants_ != nullptr) {
+        variants_->Submit(FeatureMask());
+    }
+}
+
+} // namespace vivid
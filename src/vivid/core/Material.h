@@ -2,7 +2,9 @@
 
 #include <iostream>
 #include <memory>
+#include <cstdint>
 #include "vivid/core/Shader.h"
+#include "vivid/core/ShaderVariants.h"
 
 
 namespace vivid {
@@ -11,8 +13,38 @@ class Material {
 public:
     Material() = default;
 
+    virtual ~Material() = default;
+
     virtual void SetUniforms(const ShaderPtr &shader) = 0;
 
+    // Shader used when the material is drawn by a Renderer: the shader set, else the variant of the features
+    // of the material, null if neither is set
+    inline void SetShader(const ShaderPtr &shader) { shader_ = shader; }
+    const ShaderPtr& GetShader() const;
+
+    // Variants chosen by FeatureMask() when no shader is set
+    inline void SetShaderVariants(const ShaderVariantsPtr &variants) { variants_ = variants; }
+    inline const ShaderVariantsPtr& GetShaderVariants() const { return variants_; }
+
+    // Start building the variant of the material in the background, e.g. after loading a model, so that
+    // GetShader() doesn't wait for it. Nothing to do if a shader is set.
+    void SubmitShader() const;
+
+    // Features used by the material, one bit per define of its shader variants
+    virtual uint32_t FeatureMask() const { return 0; }
+
+    // Transparent materials are drawn after the opaque ones, back to front, alpha blended without depth writes.
+    inline void SetTransparent(bool transparent) { transparent_ = transparent; }
+    inline bool IsTransparent() const { return transparent_; }
+
+    // Handle of the main texture, used to group the draws sharing textures. 0 if none.
+    virtual unsigned int TextureKey() const { return 0; }
+
+protected:
+    ShaderPtr shader_;
+    ShaderVariantsPtr variants_;
+    bool transparent_ = false;
+
 };
 
 using MaterialPtr = std::shared_ptr<Material>;
@@ -1,50 +1,23 @@
 #include <glad/glad.h>
 #include <utility>
 #include "vivid/core/Mesh.h"
+#include "vivid/core/FrameUniforms.h"
 #include "vivid/utils/GlmUtils.h"
 
 namespace vivid {
 
 Mesh::Mesh(GeometryPtr geometry, MaterialPtr material, int renderOrder)
-    : Object3D(), geometry_(std::move(geometry)), material_(std::move(material)), renderOrder_(renderOrder)
-{}
+    : Object3D(), geometry_(std::move(geometry)), material_(std::move(material))
+{
+    renderOrder_ = renderOrder;
+}
 
 
 void Mesh::Draw(const CameraPtr& cam, const ShaderPtr& shader, int drawMode, bool useMaterial) {
-    // Bind ?
+    // Bind, skipped if the program is in use already
     shader->Use();
 
-    if (cam != nullptr) {
-        // Set built-in uniforms
-        const glm::mat4 modelMatrix = GetModelMatrix();
-        const glm::mat4 viewMatrix = cam->GetViewMatrix();
-        glm::mat4 modelViewMatrix = viewMatrix * modelMatrix;
-        glm::mat4 mvp = cam->GetProjectionMatrix() * modelViewMatrix;
-        glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(modelViewMatrix)));
-        glm::mat3 normalMatrixW = glm::transpose(glm::inverse(glm::mat3(modelMatrix)));
-
-        if (shader->HasUniform("modelMatrix")) {
-            shader->SetMat4("modelMatrix", modelMatrix);
-        }
-        if (shader->HasUniform("viewMatrix")) {
-            shader->SetMat3("viewMatrix", cam->GetViewMatrix());
-        }
-        if (shader->HasUniform("modelViewMatrix")) {
-            shader->SetMat4("modelViewMatrix", modelViewMatrix);
-        }
-        if (shader->HasUniform("projectionMatrix")) {
-            shader->SetMat4("projectionMatrix", cam->GetProjectionMatrix());
-        }
-        if (shader->HasUniform("MVP")) {
-            shader->SetMat4("MVP", mvp);
-        }
-        if (shader->HasUniform("normalMatrix")) {
-            shader->SetMat3("normalMatrix", normalMatrix);
-        }
-        if (shader->HasUniform("normalMatrixW")) {
-            shader->SetMat3("normalMatrixW", normalMatrixW);
-        }
-    }
+    SetMatrixUniforms(cam, shader);
 
     if (material_ != nullptr && useMaterial) {
         material_->SetUniforms(shader);
@@ -65,8 +38,81 @@ void Mesh::Draw(const CameraPtr& cam, const ShaderPtr& shader, int drawMode, boo
 }
 
 
+void Mesh::SetMatrixUniforms(const CameraPtr& cam, const ShaderPtr& shader) const {
+    static const UniformHandle kModelMatrix("modelMatrix");
+    static const UniformHandle kViewMatrix("viewMatrix");
+    static const UniformHandle kModelViewMatrix("modelViewMatrix");
+    static const UniformHandle kProjectionMatrix("projectionMatrix");
+    static const UniformHandle kMVP("MVP");
+    static const UniformHandle kNormalMatrix("normalMatrix");
+    static const UniformHandle kNormalMatrixW("normalMatrixW");
+
+    if (cam != nullptr) {
+        // The camera matrices are read from the frame uniform buffer, uploaded once per camera change
+        if (shader->UsesFrameUniforms()) {
+            FrameUniforms::Default().Update(*cam);
+        }
+
+        // Set built-in uniforms
+        const glm::mat4 modelMatrix = GetModelMatrix();
+        const glm::mat4 &viewMatrix = cam->GetViewMatrix();
+        const glm::mat4 modelViewMatrix = viewMatrix * modelMatrix;
+
+        if (shader->HasUniform(kModelMatrix)) {
+            shader->SetMat4(kModelMatrix, modelMatrix);
+        }
+        if (shader->HasUniform(kViewMatrix)) {
+            shader->SetMat3(kViewMatrix, glm::mat3(viewMatrix));
+        }
+        if (shader->HasUniform(kModelViewMatrix)) {
+            shader->SetMat4(kModelViewMatrix, modelViewMatrix);
+        }
+        if (shader->HasUniform(kProjectionMatrix)) {
+            shader->SetMat4(kProjectionMatrix, cam->GetProjectionMatrix());
+        }
+        if (shader->HasUniform(kMVP)) {
+            shader->SetMat4(kMVP, cam->GetViewProjectionMatrix() * modelMatrix);
+        }
+
+        // The inverse transpose of a rotation is itself
+        const bool rigid = transform_.IsRigid();
+        if (shader->HasUniform(kNormalMatrix)) {
+            const glm::mat3 modelView3(modelViewMatrix);
+            shader->SetMat3(kNormalMatrix, rigid && cam->IsViewRigid()
+                                           ? modelView3 : glm::transpose(glm::inverse(modelView3)));
+        }
+        if (shader->HasUniform(kNormalMatrixW)) {
+            const glm::mat3 model3(modelMatrix);
+            shader->SetMat3(kNormalMatrixW, rigid ? model3 : glm::transpose(glm::inverse(model3)));
+        }
+    }
+}
+
+
 glm::mat4 Mesh::GetModelMatrix() const {
-    return GlmUtils::eigen2glm(transform_.Matrix());
+    return GlmUtils::eigen2glm(transform_.MatrixF());
+}
+
+
+const BoundingBox& Mesh::GetBoundingBox() const {
+    static const BoundingBox empty;
+    return geometry_ != nullptr ? geometry_->GetBoundingBox() : empty;
+}
+
+
+const BoundingSphere& Mesh::GetBoundingSphere() const {
+    static const BoundingSphere empty;
+    return geometry_ != nullptr ? geometry_->GetBoundingSphere() : empty;
+}
+
+
+BoundingBox Mesh::GetWorldBoundingBox() const {
+    return GetBoundingBox().Transformed(transform_.MatrixF());
+}
+
+
+BoundingSphere Mesh::GetWorldBoundingSphere() const {
+    return GetBoundingSphere().Transformed(transform_.MatrixF());
 }
 
 
@@ -20,8 +20,8 @@ public:
          MaterialPtr material,
          int renderOrder = 0);
 
-    void Draw(const CameraPtr& cam, const ShaderPtr& shader,
-              int drawMode = GL_TRIANGLES, bool useMaterial = true);
+    virtual void Draw(const CameraPtr& cam, const ShaderPtr& shader,
+                      int drawMode = GL_TRIANGLES, bool useMaterial = true);
 
     void SetMaterial(const MaterialPtr& material) {
         material_ = material;
@@ -31,12 +31,37 @@ public:
         return material_;
     }
 
+    GeometryPtr GetGeometry() const {
+        return geometry_;
+    }
+
+    // Primitive type used when drawn by a Renderer, e.g. GL_POINTS for point clouds
+    void SetDrawMode(int drawMode) {
+        drawMode_ = drawMode;
+    }
+
+    int GetDrawMode() const {
+        return drawMode_;
+    }
+
     glm::mat4 GetModelMatrix() const;
 
-private:
+    // Bounds of what the mesh draws in its own frame, those of the geometry unless overridden, e.g. by
+    // InstancedMesh. Empty without a geometry.
+    virtual const BoundingBox& GetBoundingBox() const;
+    virtual const BoundingSphere& GetBoundingSphere() const;
+
+    // Bounds in world frame, derived from the local bounds and the transform.
+    BoundingBox GetWorldBoundingBox() const;
+    BoundingSphere GetWorldBoundingSphere() const;
+
+protected:
+    // Set the matrices used by the shader, e.g. MVP and normalMatrix.
+    void SetMatrixUniforms(const CameraPtr& cam, const ShaderPtr& shader) const;
+
     GeometryPtr geometry_;
     MaterialPtr material_;
-    int renderOrder_;
+    int drawMode_ = GL_TRIANGLES;
 };
 
 using MeshPtr = std::shared_ptr<Mesh>;
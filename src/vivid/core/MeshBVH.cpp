@@ -0,0 +1,267 @@
+#include <algorithm>
+#include <unordered_set>
+#include "vivid/core/MeshBVH.h"
+#include "vivid/core/InstancedMesh.h"
+
+namespace vivid {
+
+bool MeshBVH::ReadTriangles(const Geometry &geometry, std::vector<BoundingBox> &boxes) {
+    triangles_.clear();
+    boxes.clear();
+    const auto &positions = geometry.GetAttribute(AttributeType::Position);
+    if (!positions) {
+        return false;
+    }
+    if (!positions->HasCpuData()) {
+        std::cerr << "Warning: the CPU data of the positions has been released, no BVH is built!\n";
+        return false;
+    }
+
+    std::vector<float> decoded;
+    const float *data = positions->Data();
+    if (data == nullptr) {
+        decoded = positions->ToFloat();
+        data = decoded.data();
+    }
+    const int stride = positions->ElementsPerItem();
+    const auto vertexCount = static_cast<size_t>(positions->ItemCount());
+    if (stride < 3) {
+        std::cerr << "Warning: the positions have less than 3 elements per item, no BVH is built!\n";
+        return false;
+    }
+    auto vertex = [&](size_t i) {
+        return Eigen::Vector3f(data[i * stride], data[i * stride + 1], data[i * stride + 2]);
+    };
+
+    // The triangles of each draw range, or of the whole index or vertex list
+    const auto &indices = geometry.GetIndex();
+    std::vector<DrawRange> ranges = geometry.GetDrawRanges();
+    if (ranges.empty()) {
+        const size_t count = indices.empty() ? vertexCount : indices.size();
+        ranges.push_back({0, static_cast<unsigned int>(count), 0});
+    }
+    size_t triangleCount = 0;
+    for (const auto &range : ranges) {
+        triangleCount = std::max<size_t>(triangleCount, (range.firstIndex + range.indexCount) / 3);
+    }
+    // Triangles outside the ranges are degenerate, so that triangle i stays at index i
+    triangles_.assign(triangleCount, {Eigen::Vector3f::Zero(), Eigen::Vector3f::Zero(), Eigen::Vector3f::Zero()});
+    boxes.assign(triangleCount, BoundingBox());
+
+    for (const auto &range : ranges) {
+        for (size_t k = range.firstIndex; k + 2 < range.firstIndex + range.indexCount; k += 3) {
+            size_t v[3];
+            for (int j = 0; j < 3; ++j) {
+                v[j] = indices.empty() ? k + j : static_cast<size_t>(indices[k + j] + range.baseVertex);
+            }
+            if (v[0] >= vertexCount || v[1] >= vertexCount || v[2] >= vertexCount) {
+                continue;
+            }
+            const Eigen::Vector3f a = vertex(v[0]), b = vertex(v[1]), c = vertex(v[2]);
+            triangles_[k / 3] = {a, b - a, c - a};
+            BoundingBox &box = boxes[k / 3];
+            box.Expand(a);
+            box.Expand(b);
+            box.Expand(c);
+        }
+    }
+
+    source_ = positions.get();
+    sourceVersion_ = positions->Version();
+    return true;
+}
+
+
+bool MeshBVH::Build(const Geometry &geometry) {
+    std::vector<BoundingBox> boxes;
+    if (!ReadTriangles(geometry, boxes)) {
+        bvh_.Build({});
+        return false;
+    }
+    bvh_.Build(boxes);
+    return true;
+}
+
+
+bool MeshBVH::Refit(const Geometry &geometry) {
+    const size_t triangleCount = triangles_.size();
+    std::vector<BoundingBox> boxes;
+    if (!ReadTriangles(geometry, boxes)) {
+        return false;
+    }
+    if (triangles_.size() != triangleCount) {
+        std::cerr << "Warning: the triangles have changed, the BVH is rebuilt!\n";
+        bvh_.Build(boxes);
+        return true;
+    }
+    bvh_.Refit(boxes);
+    return true;
+}
+
+
+bool MeshBVH::Raycast(const Ray &ray, TriangleHit &hit, float maxDistance) const {
+    float tMax = maxDistance;
+    return bvh_.Raycast(ray, tMax, [&](uint32_t i, float &t) {
+        // Moller-Trumbore
+        const Triangle &tri = triangles_[i];
+        const Eigen::Vector3f p = ray.direction.cross(tri.ac);
+        const float det = tri.ab.dot(p);
+        if (std::abs(det) < 1e-12f) {
+            return false;
+        }
+        const float invDet = 1.f / det;
+        const Eigen::Vector3f s = ray.origin - tri.a;
+        const float u = s.dot(p) * invDet;
+        if (u < 0.f || u > 1.f) {
+            return false;
+        }
+        const Eigen::Vector3f q = s.cross(tri.ab);
+        const float v = ray.direction.dot(q) * invDet;
+        if (v < 0.f || u + v > 1.f) {
+            return false;
+        }
+        const float distance = tri.ac.dot(q) * invDet;
+        if (distance < 0.f || distance >= t) {
+            return false;
+        }
+        t = distance;
+        hit.triangle = i;
+        hit.distance = distance;
+        hit.u = u;
+        hit.v = v;
+        return true;
+    });
+}
+
+
+void MeshBVH::Query(const BoundingBox &box, std::vector<uint32_t> &triangles) const {
+    bvh_.Query(box, triangles);
+}
+
+
+void MeshBVH::Query(const BoundingSphere &sphere, std::vector<uint32_t> &triangles) const {
+    bvh_.Query(sphere, triangles);
+}
+
+
+void SceneBVH::Build(Scene &scene) {
+    scene.Update();
+    meshes_.clear();
+    for (Mesh *mesh : scene.NodeMeshes()) {
+        if (mesh != nullptr && mesh->GetGeometry() != nullptr) {
+            meshes_.push_back(mesh);
+        }
+    }
+
+    // Forget the triangle BVHs of the geometries that are gone
+    std::unordered_set<const Geometry*> geometries;
+    for (Mesh *mesh : meshes_) {
+        geometries.insert(mesh->GetGeometry().get());
+    }
+    for (auto it = geometryBVHs_.begin(); it != geometryBVHs_.end(); ) {
+        it = geometries.count(it->first) > 0 ? std::next(it) : geometryBVHs_.erase(it);
+    }
+
+    UpdateBoxes();
+    bvh_.Build(boxes_);
+}
+
+
+void SceneBVH::Refit() {
+    UpdateBoxes();
+    bvh_.Refit(boxes_);
+}
+
+
+void SceneBVH::UpdateBoxes() {
+    boxes_.resize(meshes_.size());
+    for (size_t i = 0; i < meshes_.size(); ++i) {
+        boxes_[i] = meshes_[i]->GetWorldBoundingBox();
+    }
+}
+
+
+const MeshBVH* SceneBVH::GeometryBVH(const Geometry &geometry) const {
+    auto &bvh = geometryBVHs_[&geometry];
+    const auto &positions = geometry.GetAttribute(AttributeType::Position);
+    if (!positions) {
+        return nullptr;
+    }
+    if (bvh != nullptr && bvh->Source() == positions.get() && bvh->SourceVersion() == positions->Version()) {
+        return bvh.get();
+    }
+    if (bvh == nullptr) {
+        bvh.reset(new MeshBVH());
+    }
+    if (!bvh->Build(geometry)) {
+        return nullptr;
+    }
+    return bvh.get();
+}
+
+
+bool SceneBVH::Raycast(const Ray &ray, RaycastHit &hit) const {
+    hit = RaycastHit();
+    float tMax = std::numeric_limits<float>::infinity();
+    const bool found = bvh_.Raycast(ray, tMax, [&](uint32_t i, float &t) {
+        Mesh *mesh = meshes_[i];
+        // Points and lines have no triangles to hit
+        if (!mesh->IsVisible() || mesh->GetDrawMode() != GL_TRIANGLES) {
+            return false;
+        }
+        const MeshBVH *meshBVH = GeometryBVH(*mesh->GetGeometry());
+        if (meshBVH == nullptr) {
+            return false;
+        }
+
+        // The local ray keeps the parametrization of the world ray, so distances compare across meshes
+        const Eigen::Matrix4f toMesh = mesh->GetTransform().InverseMatrix().cast<float>();
+        const auto *instanced = dynamic_cast<const InstancedMesh*>(mesh);
+        const int instanceCount = instanced != nullptr ? instanced->InstanceCount() : 1;
+        bool found = false;
+        for (int k = 0; k < instanceCount; ++k) {
+            const Eigen::Matrix4f toLocal = instanced != nullptr
+                                            ? Eigen::Matrix4f(instanced->GetMatrixAt(k).inverse() * toMesh)
+                                            : toMesh;
+            TriangleHit triangleHit;
+            if (!meshBVH->Raycast(ray.Transformed(toLocal), triangleHit, t)) {
+                continue;
+            }
+            t = triangleHit.distance;
+            hit.mesh = mesh;
+            hit.instance = instanced != nullptr ? k : -1;
+            hit.triangle = triangleHit.triangle;
+            hit.distance = triangleHit.distance;
+            hit.u = triangleHit.u;
+            hit.v = triangleHit.v;
+            found = true;
+        }
+        return found;
+    });
+    if (found) {
+        hit.point = ray.At(hit.distance);
+    }
+    return found;
+}
+
+
+void SceneBVH::Query(const BoundingBox &box, std::vector<Mesh*> &meshes) const {
+    std::vector<uint32_t> indices;
+    bvh_.Query(box, indices);
+    meshes.clear();
+    for (uint32_t i : indices) {
+        meshes.push_back(meshes_[i]);
+    }
+}
+
+
+void SceneBVH::Query(const BoundingSphere &sphere, std::vector<Mesh*> &meshes) const {
+    std::vector<uint32_t> indices;
+    bvh_.Query(sphere, indices);
+    meshes.clear();
+    for (uint32_t i : indices) {
+        meshes.push_back(meshes_[i]);
+    }
+}
+
+} // namespace vivid
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include <Eigen/Dense>
+#include "vivid/core/BVH.h"
+#include "vivid/core/Geometry.h"
+#include "vivid/core/Mesh.h"
+#include "vivid/core/Scene.h"
+
+namespace vivid {
+
+// Intersection of a ray with a triangle: the hit point is (1 - u - v) * a + u * b + v * c,
+// at origin + distance * direction.
+struct TriangleHit {
+    uint32_t triangle = 0;  // index of the triangle in the index list (or vertex list) of the geometry
+    float distance = std::numeric_limits<float>::infinity();
+    float u = 0.f;
+    float v = 0.f;
+};
+
+
+/* BVH over the triangles of a geometry, in its local frame. Indexed and non-indexed triangle lists are
+ * supported, with their draw ranges if any.
+ */
+class MeshBVH {
+public:
+    MeshBVH() = default;
+
+    // Build over the triangles of the geometry. Return false if its positions are not available on CPU.
+    bool Build(const Geometry &geometry);
+
+    // Update the bounds after the positions changed, the triangles must be the same.
+    bool Refit(const Geometry &geometry);
+
+    // Nearest triangle hit closer than maxDistance
+    bool Raycast(const Ray &ray, TriangleHit &hit,
+                 float maxDistance = std::numeric_limits<float>::infinity()) const;
+
+    // Triangles whose bounds overlap the box or sphere
+    void Query(const BoundingBox &box, std::vector<uint32_t> &triangles) const;
+    void Query(const BoundingSphere &sphere, std::vector<uint32_t> &triangles) const;
+
+    inline size_t TriangleCount() const { return triangles_.size(); }
+
+    // Position attribute and version the BVH was built or refitted from
+    inline const Attribute* Source() const { return source_; }
+    inline unsigned int SourceVersion() const { return sourceVersion_; }
+
+private:
+    // Vertex a and the edges b - a, c - a of a triangle, as used by the intersection test
+    struct Triangle {
+        Eigen::Vector3f a;
+        Eigen::Vector3f ab;
+        Eigen::Vector3f ac;
+    };
+
+    // Read the triangles from the geometry, and their bounds
+    bool ReadTriangles(const Geometry &geometry, std::vector<BoundingBox> &boxes);
+
+    BVH bvh_;
+    std::vector<Triangle> triangles_;
+    const Attribute *source_ = nullptr;
+    unsigned int sourceVersion_ = 0;
+};
+
+
+// Nearest mesh hit by a ray, in world frame.
+struct RaycastHit {
+    Mesh *mesh = nullptr;
+    int instance = -1;          // instance hit if the mesh is an InstancedMesh
+    uint32_t triangle = 0;
+    float distance = std::numeric_limits<float>::infinity();
+    float u = 0.f;
+    float v = 0.f;
+    Eigen::Vector3f point = Eigen::Vector3f::Zero();
+};
+
+
+/* Two-level BVH of a scene: a BVH over the world bounds of the meshes, and a triangle BVH per geometry in
+ * its local frame, built on first use and rebuilt when the positions change. Moving meshes only need a
+ * Refit() of the top level.
+ */
+class SceneBVH {
+public:
+    SceneBVH() = default;
+
+    // Build over the meshes of the scene, with their current world transforms.
+    void Build(Scene &scene);
+
+    // Update the mesh bounds after the meshes moved.
+    void Refit();
+
+    // Nearest visible mesh hit by a ray in world frame. Only meshes drawn as GL_TRIANGLES can be hit, every
+    // instance of an InstancedMesh is tested.
+    bool Raycast(const Ray &ray, RaycastHit &hit) const;
+
+    // Meshes whose world bounds overlap the box or sphere
+    void Query(const BoundingBox &box, std::vector<Mesh*> &meshes) const;
+    void Query(const BoundingSphere &sphere, std::vector<Mesh*> &meshes) const;
+
+    inline const std::vector<Mesh*>& Meshes() const { return meshes_; }
+
+private:
+    // World bounds of the meshes
+    void UpdateBoxes();
+
+    // Triangle BVH of a geometry, null if it can't be built
+    const MeshBVH* GeometryBVH(const Geometry &geometry) const;
+
+    BVH bvh_;
+    std::vector<Mesh*> meshes_;
+    std::vector<BoundingBox> boxes_;
+
+    // Built lazily by the const queries
+    mutable std::unordered_map<const Geometry*, std::unique_ptr<MeshBVH>> geometryBVHs_;
+};
+
+} // namespace vivid
@@ -1,7 +1,10 @@
+#include <algorithm>
 #include "vivid/core/Object3D.h"
 
 namespace vivid {
 
+static unsigned int hierarchyVersion = 0;
+
 Object3D::Object3D() {
     name_ = "";
     parent_ = nullptr;
@@ -12,8 +15,31 @@ Object3D::Object3D() {
 
 
 void Object3D::AddChild(const std::shared_ptr<Object3D> &child) {
+    if (child->parent_ == this) {
+        return;
+    }
+    if (child->parent_ != nullptr) {
+        child->parent_->RemoveChild(child);
+    }
     child->SetParent(this);
     children_.push_back(child);
+    hierarchyVersion++;
+}
+
+
+void Object3D::RemoveChild(const std::shared_ptr<Object3D> &child) {
+    auto it = std::find(children_.begin(), children_.end(), child);
+    if (it == children_.end()) {
+        return;
+    }
+    child->SetParent(nullptr);
+    children_.erase(it);
+    hierarchyVersion++;
+}
+
+
+unsigned int Object3D::HierarchyVersion() {
+    return hierarchyVersion;
 }
 
 
@@ -11,20 +11,47 @@ class Object3D {
 public:
     Object3D();
 
+    virtual ~Object3D() = default;
+
     inline void SetName(const std::string& name) { name_ = name; }
     inline std::string GetName() { return name_; }
 
     inline void SetParent(Object3D* parent) { parent_ = parent; }
     inline Object3D* GetParent() { return parent_; }
 
+    // Transform in world frame. A root object is placed with it, the world transform of a child is
+    // computed from its local transform by TransformTree::Update() and overwritten there.
     inline void SetTransform(const Transform& tf) { transform_ = tf; }
     inline Transform& GetTransform() { return transform_; }
+    inline const Transform& GetTransform() const { return transform_; }
+
+    // Transform relative to the parent, unused by root objects.
+    inline void SetLocalTransform(const Transform& tf) { localTransform_ = tf; }
+    inline Transform& GetLocalTransform() { return localTransform_; }
 
+    // The child is removed from its previous parent, if any.
     void AddChild(const std::shared_ptr<Object3D> &child);
+    void RemoveChild(const std::shared_ptr<Object3D> &child);
     inline const std::vector<std::shared_ptr<Object3D> > &GetChildren() { return children_; }
 
+    // Incremented whenever a child is added or removed anywhere, so that flattened hierarchies know
+    // when to rebuild.
+    static unsigned int HierarchyVersion();
+
     void LookAt(const Eigen::Vector3d& target, const Eigen::Vector3d& up = Eigen::Vector3d::UnitY());
 
+    // A hidden object hides its descendants too
+    inline void SetVisible(bool visible) { isVisible_ = visible; }
+    inline bool IsVisible() const { return isVisible_; }
+
+    // Objects with a lower render order are drawn first, in [-128, 127]
+    inline void SetRenderOrder(int order) { renderOrder_ = order; }
+    inline int GetRenderOrder() const { return renderOrder_; }
+
+    // Skip the object when it is outside the view frustum
+    inline void SetFrustumCulled(bool culled) { frustumCulled_ = culled; }
+    inline bool IsFrustumCulled() const { return frustumCulled_; }
+
 protected:
     // automatically assigned, unique within process.
     int id_;
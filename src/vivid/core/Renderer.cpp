@@ -0,0 +1,254 @@
+#include <algorithm>
+#include <array>
+#include <glad/glad.h>
+#include "vivid/core/Renderer.h"
+#include "vivid/core/FrameUniforms.h"
+#include "vivid/core/GLStateCache.h"
+#include "vivid/utils/Parallel.h"
+
+namespace vivid {
+
+// Bit widths of the key fields
+static constexpr int kDepthBits = 24;
+static constexpr int kMaterialBits = 12;
+static constexpr int kTextureBits = 11;
+static constexpr int kShaderBits = 8;
+static constexpr int kTransparentShift = 55;
+static constexpr int kOrderShift = 56;
+
+// Work per job of the parallel passes
+static constexpr size_t kItemsPerJob = 1024;
+static constexpr size_t kBoxesPerJob = 4096;
+
+
+uint32_t Renderer::DenseId(std::unordered_map<uintptr_t, uint32_t> &ids, uintptr_t key) {
+    auto it = ids.find(key);
+    if (it == ids.end()) {
+        it = ids.emplace(key, static_cast<uint32_t>(ids.size())).first;
+    }
+    return it->second;
+}
+
+
+// Ids beyond the width of their field share the last value, which only makes the grouping coarser
+static uint64_t Saturate(uint32_t id, int bits) {
+    return std::min<uint64_t>(id, (1u << bits) - 1);
+}
+
+
+void Renderer::Collect(const Scene &scene, const CameraPtr &camera, const ShaderPtr &shader) {
+    queue_.clear();
+    shaders_.clear();
+    shaderIds_.clear();
+    textureIds_.clear();
+    materialIds_.clear();
+
+    // Visible meshes, with the state fields of their key. The ids are given in order of first use,
+    // which needs a serial pass.
+    const TransformTree &tree = scene.GetTransformTree();
+    const auto &nodes = tree.Nodes();
+    const auto &meshes = scene.NodeMeshes();
+    bool missingShader = false;
+    for (size_t i = 0; i < nodes.size(); ) {
+        if (!nodes[i]->IsVisible()) {
+            i = tree.SubtreeEnd(i);
+            continue;
+        }
+        Mesh *mesh = meshes[i];
+        if (mesh == nullptr || mesh->GetGeometry() == nullptr) {
+            ++i;
+            continue;
+        }
+
+        const Material *material = mesh->GetMaterial().get();
+        const ShaderPtr &meshShader = shader != nullptr || material == nullptr ? shader : material->GetShader();
+        if (meshShader == nullptr) {
+            missingShader = true;
+            ++i;
+            continue;
+        }
+
+        // Bounds are cached on first use, which must not happen concurrently for shared geometries
+        mesh->GetBoundingBox();
+        mesh->GetBoundingSphere();
+
+        const uint32_t shaderIndex = DenseId(shaderIds_, reinterpret_cast<uintptr_t>(meshShader.get()));
+        if (shaderIndex == shaders_.size()) {
+            shaders_.push_back(meshShader);
+        }
+        const uint64_t shaderId = Saturate(shaderIndex, kShaderBits);
+        const uint64_t textureId = Saturate(DenseId(textureIds_, material != nullptr ? material->TextureKey() : 0),
+                                            kTextureBits);
+        const uint64_t materialId = Saturate(DenseId(materialIds_, reinterpret_cast<uintptr_t>(material)),
+                                             kMaterialBits);
+        const auto order = static_cast<uint64_t>(std::min(std::max(mesh->GetRenderOrder() + 128, 0), 255));
+        const bool transparent = material != nullptr && material->IsTransparent();
+
+        uint64_t key = order << kOrderShift;
+        if (transparent) {
+            key |= 1ull << kTransparentShift
+                   | shaderId << (kTextureBits + kMaterialBits)
+                   | textureId << kMaterialBits
+                   | materialId;
+        } else {
+            key |= shaderId << (kTextureBits + kMaterialBits + kDepthBits)
+                   | textureId << (kMaterialBits + kDepthBits)
+                   | materialId << kDepthBits;
+        }
+        queue_.push_back({key, mesh, shaderIndex, static_cast<uint32_t>(i)});
+        ++i;
+    }
+
+    if (missingShader && !warnedMissingShader_) {
+        std::cerr << "Warning: meshes without a material shader are not rendered!\n";
+        warnedMissingShader_ = true;
+    }
+
+    // Depth and world bounds of the items, in parallel. Only the depth along the view direction is needed.
+    const Eigen::Matrix4d view = camera->GetTransform().InverseMatrix();
+    const Eigen::RowVector4d viewZ = view.row(2);
+    const double depthScale = static_cast<double>((1u << kDepthBits) - 1) / std::max(camera->GetFar(), 1e-6f);
+    cullBoxes_.Resize(queue_.size());
+    cullTested_.assign(queue_.size(), 0);
+    ParallelFor(0, queue_.size(), kItemsPerJob, [&](size_t begin, size_t end) {
+        for (size_t j = begin; j < end; ++j) {
+            RenderItem &item = queue_[j];
+            const Eigen::Matrix4d &world = tree.WorldMatrix(item.node);
+
+            // View depth of the center of the bounds
+            const BoundingSphere &sphere = item.mesh->GetBoundingSphere();
+            const Eigen::Vector4d center = sphere.IsEmpty() ? Eigen::Vector4d::UnitW()
+                                                            : Eigen::Vector4d(sphere.center.x(), sphere.center.y(),
+                                                                              sphere.center.z(), 1.0);
+            const double depth = -viewZ.dot(world * center);
+            const auto quantizedDepth = static_cast<uint64_t>(
+                    std::min(std::max(depth * depthScale, 0.0), static_cast<double>((1u << kDepthBits) - 1)));
+            if ((item.key >> kTransparentShift) & 1) {
+                const uint64_t invertedDepth = ((1u << kDepthBits) - 1) - quantizedDepth;
+                item.key |= invertedDepth << (kShaderBits + kTextureBits + kMaterialBits);
+            } else {
+                item.key |= quantizedDepth;
+            }
+
+            // World bounds to test against the frustum, empty bounds are never culled
+            if (frustumCulling_ && item.mesh->IsFrustumCulled()) {
+                const BoundingBox box = item.mesh->GetBoundingBox().Transformed(world.cast<float>());
+                if (!box.IsEmpty()) {
+                    cullBoxes_.Set(j, box);
+                    cullTested_[j] = 1;
+                }
+            }
+        }
+    });
+
+    Cull(camera);
+}
+
+
+void Renderer::Cull(const CameraPtr &camera) {
+    culledCount_ = 0;
+    if (std::find(cullTested_.begin(), cullTested_.end(), 1) == cullTested_.end()) {
+        return;
+    }
+    const Frustum frustum = camera->GetFrustum();
+    cullVisible_.resize(cullBoxes_.Size());
+    ParallelFor(0, cullBoxes_.Size(), kBoxesPerJob, [&](size_t begin, size_t end) {
+        frustum.Cull(cullBoxes_, begin, end, cullVisible_);
+    });
+
+    // Remove the culled items, keeping the order of the others
+    size_t kept = 0;
+    for (size_t j = 0; j < queue_.size(); ++j) {
+        if (cullTested_[j] && !cullVisible_[j]) {
+            culledCount_++;
+        } else {
+            queue_[kept++] = queue_[j];
+        }
+    }
+    queue_.resize(kept);
+}
+
+
+void Renderer::SortQueue() {
+    const size_t n = queue_.size();
+    if (n < 2) {
+        return;
+    }
+
+    // Histograms of the 8 bytes in a single pass
+    std::array<std::array<size_t, 256>, 8> counts{};
+    for (const auto &item : queue_) {
+        for (int b = 0; b < 8; ++b) {
+            counts[b][(item.key >> (8 * b)) & 0xff]++;
+        }
+    }
+
+    scratch_.resize(n);
+    for (int b = 0; b < 8; ++b) {
+        auto &count = counts[b];
+        if (count[(queue_[0].key >> (8 * b)) & 0xff] == n) {
+            continue;
+        }
+        // Prefix sums give the first slot of each bucket
+        size_t offset = 0;
+        for (auto &c : count) {
+            const size_t bucketSize = c;
+            c = offset;
+            offset += bucketSize;
+        }
+        for (const auto &item : queue_) {
+            scratch_[count[(item.key >> (8 * b)) & 0xff]++] = item;
+        }
+        queue_.swap(scratch_);
+    }
+}
+
+
+void Renderer::Render(Scene &scene, const CameraPtr &camera, const ShaderPtr &shader) {
+    scene.Update();
+    Collect(scene, camera, shader);
+    SortQueue();
+
+    // Camera data shared by all the draws
+    FrameUniforms::Default().Update(*camera);
+
+    shaderChanges_ = 0;
+    materialChanges_ = 0;
+    uint32_t lastShader = UINT32_MAX;
+    const Material *lastMaterial = nullptr;
+    GLStateCache &gl = GLStateCache::Instance();
+    bool depthWrite = true;
+    for (const auto &item : queue_) {
+        // Transparent meshes are alpha blended, and test the depth without writing it
+        const bool transparent = (item.key >> kTransparentShift) & 1;
+        if (transparent == depthWrite) {
+            depthWrite = !transparent;
+            gl.DepthMask(depthWrite);
+            gl.SetEnabled(GL_BLEND, transparent);
+            if (transparent) {
+                gl.BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+            }
+        }
+
+        // Uniforms belong to a program, the material is set again after a program change
+        if (item.shader != lastShader) {
+            lastShader = item.shader;
+            lastMaterial = nullptr;
+            shaderChanges_++;
+        }
+        const Material *material = item.mesh->GetMaterial().get();
+        const bool materialChanged = material != lastMaterial;
+        if (materialChanged) {
+            lastMaterial = material;
+            materialChanges_++;
+        }
+
+        item.mesh->Draw(camera, shaders_[item.shader], item.mesh->GetDrawMode(), materialChanged);
+    }
+    if (!depthWrite) {
+        gl.DepthMask(true);
+        gl.Disable(GL_BLEND);
+    }
+}
+
+} // namespace vivid
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <iostream>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include "vivid/core/Camera.h"
+#include "vivid/core/Frustum.h"
+#include "vivid/core/Mesh.h"
+#include "vivid/core/Scene.h"
+#include "vivid/core/Shader.h"
+
+namespace vivid {
+
+/* Draws the visible meshes of a scene through a render queue sorted by a 64-bit key, so that draws sharing
+ * a shader, textures and material are consecutive, opaque meshes are drawn front to back for early depth
+ * rejection, and transparent meshes back to front after them. The frame preparation (transform update,
+ * queue building and culling) runs on the JobSystem, only the draw calls are issued from the calling thread.
+ * Transparent meshes are blended with (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA), GL_BLEND is disabled again
+ * once they are drawn.
+ *
+ * Key layout, from the most significant bit:
+ *   opaque:      render order (8) | 0 | shader (8) | texture (11) | material (12) | depth (24)
+ *   transparent: render order (8) | 1 | inverted depth (24) | shader (8) | texture (11) | material (12)
+ */
+class Renderer {
+public:
+    Renderer() = default;
+
+    // Update the scene and draw its visible meshes with the shader of their material,
+    // or with `shader` for all of them if not null.
+    void Render(Scene &scene, const CameraPtr &camera, const ShaderPtr &shader = nullptr);
+
+    // Skip the meshes outside the camera frustum, except those with frustum culling turned off
+    inline void SetFrustumCulling(bool enabled) { frustumCulling_ = enabled; }
+    inline bool FrustumCulling() const { return frustumCulling_; }
+
+    // Number of meshes drawn, and culled, by the last Render()
+    inline size_t DrawCount() const { return queue_.size(); }
+    inline size_t CulledCount() const { return culledCount_; }
+
+    // Number of program and material changes in the last Render()
+    inline size_t ShaderChanges() const { return shaderChanges_; }
+    inline size_t MaterialChanges() const { return materialChanges_; }
+
+private:
+    struct RenderItem {
+        uint64_t key;
+        Mesh *mesh;
+        uint32_t shader;    // index in shaders_
+        uint32_t node;      // index in the transform tree of the scene
+    };
+
+    // Build the queue from the visible meshes. The ids are assigned on the calling thread, the depths
+    // and world bounds are computed in parallel.
+    void Collect(const Scene &scene, const CameraPtr &camera, const ShaderPtr &shader);
+
+    // Test the world bounds gathered by Collect() against the frustum in parallel batches,
+    // and drop the items outside.
+    void Cull(const CameraPtr &camera);
+
+    // Dense id of a pointer or handle in this frame, in order of first use
+    static uint32_t DenseId(std::unordered_map<uintptr_t, uint32_t> &ids, uintptr_t key);
+
+    // LSD radix sort of the queue on the keys, 8 bits per pass. Passes where all keys share the same byte
+    // are skipped, which leaves a handful of passes in practice.
+    void SortQueue();
+
+    std::vector<RenderItem> queue_;
+    std::vector<RenderItem> scratch_;
+
+    // Shaders of this frame, and the per-frame ids of shaders, textures and materials
+    std::vector<ShaderPtr> shaders_;
+    std::unordered_map<uintptr_t, uint32_t> shaderIds_;
+    std::unordered_map<uintptr_t, uint32_t> textureIds_;
+    std::unordered_map<uintptr_t, uint32_t> materialIds_;
+
+    // Frustum culling: world boxes of the items, whether they are tested and the test results
+    bool frustumCulling_ = true;
+    BoxBatch cullBoxes_;
+    std::vector<uint8_t> cullTested_;
+    std::vector<uint8_t> cullVisible_;
+    size_t culledCount_ = 0;
+
+    size_t shaderChanges_ = 0;
+    size_t materialChanges_ = 0;
+    bool warnedMissingShader_ = false;
+};
+
+} // namespace vivid
@@ -0,0 +1,100 @@
+#include <cstring>
+#include "vivid/core/RingBuffer.h"
+#include "vivid/core/GLContext.h"
+#include "vivid/core/GLStateCache.h"
+
+namespace vivid {
+
+RingBuffer::RingBuffer(int regionCount)
+    : regionCount_(regionCount), fences_(regionCount, nullptr)
+{
+    glGenBuffers(1, &buffer_);
+}
+
+
+RingBuffer::~RingBuffer() {
+    if (!GLContext::IsAlive()) {
+        return;
+    }
+    for (auto &fence : fences_) {
+        if (fence) {
+            glDeleteSync(fence);
+        }
+    }
+    GLStateCache::Instance().ForgetBuffer(buffer_);
+    glDeleteBuffers(1, &buffer_);
+}
+
+
+size_t RingBuffer::Write(const void *data, size_t size) {
+    GLStateCache::Instance().BindBuffer(GL_ARRAY_BUFFER, buffer_);
+
+    if (size > regionSize_) {
+        // Grow with some headroom so that slowly growing data doesn't reallocate every frame
+        Reallocate(size + size / 2);
+    } else {
+        FenceCurrent();
+        current_ = (current_ + 1) % regionCount_;
+        WaitFence(current_);
+    }
+
+    // The fence guarantees the GPU doesn't read this region anymore, so there is no need to synchronize.
+    const size_t offset = Offset();
+    void *dst = glMapBufferRange(GL_ARRAY_BUFFER, (GLintptr)offset, (GLsizeiptr)size,
+                                 GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+    if (dst != nullptr) {
+        memcpy(dst, data, size);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+    } else {
+        glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)offset, (GLsizeiptr)size, data);
+    }
+    return offset;
+}
+
+
+void RingBuffer::FenceCurrent() {
+    if (!read_) {
+        return;
+    }
+    if (fences_[current_]) {
+        glDeleteSync(fences_[current_]);
+    }
+    fences_[current_] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    read_ = false;
+}
+
+
+void RingBuffer::Reallocate(size_t regionSize) {
+    // Orphan the old storage, the driver releases it once the pending draws are done
+    for (auto &fence : fences_) {
+        if (fence) {
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+    }
+    regionSize_ = (regionSize + 255) & ~size_t(255);
+    current_ = 0;
+    read_ = false;
+    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)(regionSize_ * regionCount_), nullptr, GL_STREAM_DRAW);
+}
+
+
+void RingBuffer::WaitFence(int region) {
+    GLsync &fence = fences_[region];
+    if (!fence) {
+        return;
+    }
+    // Flush on the first wait so the fence is guaranteed to signal
+    GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+    while (true) {
+        GLenum ret = glClientWaitSync(fence, flags, 1000000);   // 1 ms
+        if (ret == GL_ALREADY_SIGNALED || ret == GL_CONDITION_SATISFIED || ret == GL_WAIT_FAILED) {
+            break;
+        }
+        flags = 0;
+    }
+    glDeleteSync(fence);
+    fence = nullptr;
+}
+
+} // namespace vivid
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <iostream>
+#include <memory>
+#include <vector>
+#include <glad/glad.h>
+
+namespace vivid {
+
+/* A vertex buffer split into several regions that are written in turn. While the GPU still reads the
+ * region written in the previous frame, the CPU writes the next one, so uploads never wait for the
+ * pipeline to drain. A fence guards every region against being overwritten before the GPU is done with it.
+ */
+class RingBuffer {
+public:
+    explicit RingBuffer(int regionCount = 3);
+
+    ~RingBuffer();
+
+    RingBuffer(const RingBuffer&) = delete;
+    RingBuffer& operator=(const RingBuffer&) = delete;
+
+    // Write data into the next region and return its byte offset in the buffer.
+    size_t Write(const void *data, size_t size);
+
+    // Guard the region written last, call it after the draw commands that read it. The fence itself is only
+    // inserted when the next Write() leaves the region, once per write however many draws read it, and
+    // after all of them.
+    inline void Fence() { read_ = true; }
+
+    // Byte offset of the region written last
+    inline size_t Offset() const { return current_ * regionSize_; }
+
+    inline unsigned int Handle() const { return buffer_; }
+
+private:
+    void Reallocate(size_t regionSize);
+
+    void WaitFence(int region);
+
+    // Insert the fence of the current region if draws read it since it was written
+    void FenceCurrent();
+
+    unsigned int buffer_ = 0;
+    size_t regionSize_ = 0;
+    int regionCount_;
+    int current_ = 0;
+    bool read_ = false;
+
+    std::vector<GLsync> fences_;
+};
+
+using RingBufferPtr = std::shared_ptr<RingBuffer>;
+
+} // namespace vivid
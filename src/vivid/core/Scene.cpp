@@ -0,0 +1,24 @@
+#include "vivid/core/Scene.h"
+
+namespace vivid {
+
+Scene::Scene() : Object3D(), tree_(this, false) {}
+
+
+void Scene::Update() {
+    tree_.Update();
+
+    // The tree has been rebuilt if the hierarchy changed, find the meshes of the new nodes.
+    if (built_ && hierarchyVersion_ == Object3D::HierarchyVersion()) {
+        return;
+    }
+    const auto &nodes = tree_.Nodes();
+    nodeMeshes_.resize(nodes.size());
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        nodeMeshes_[i] = dynamic_cast<Mesh*>(nodes[i]);
+    }
+    hierarchyVersion_ = Object3D::HierarchyVersion();
+    built_ = true;
+}
+
+} // namespace vivid
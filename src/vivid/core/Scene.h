@@ -0,0 +1,44 @@
+#pragma once
+
+#include <iostream>
+#include <memory>
+#include <vector>
+#include "vivid/core/Object3D.h"
+#include "vivid/core/Mesh.h"
+#include "vivid/core/TransformTree.h"
+
+namespace vivid {
+
+/* Container of the objects drawn by a Renderer. Objects added to the scene are placed with their world
+ * transform, their descendants with their local transform. The scene keeps the hierarchy flattened in a
+ * TransformTree, and the meshes of its nodes, both refreshed when objects are added or removed.
+ */
+class Scene : public Object3D {
+public:
+    Scene();
+
+    Scene(const Scene&) = delete;
+    Scene& operator=(const Scene&) = delete;
+
+    inline void Add(const std::shared_ptr<Object3D> &object) { AddChild(object); }
+    inline void Remove(const std::shared_ptr<Object3D> &object) { RemoveChild(object); }
+
+    // Update the world transforms of the objects whose transform changed since the last update.
+    void Update();
+
+    // Flattened hierarchy of the objects of the scene, without the scene itself. Valid after Update().
+    inline const TransformTree& GetTransformTree() const { return tree_; }
+
+    // Mesh of each node of the tree, null for the other objects. Valid after Update().
+    inline const std::vector<Mesh*>& NodeMeshes() const { return nodeMeshes_; }
+
+private:
+    TransformTree tree_;
+    std::vector<Mesh*> nodeMeshes_;
+    unsigned int hierarchyVersion_ = 0;
+    bool built_ = false;
+};
+
+using ScenePtr = std::shared_ptr<Scene>;
+
+} // namespace vivid
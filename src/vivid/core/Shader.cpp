@@ -1,29 +1,79 @@
+#include <algorithm>
+#include <cstring>
+#include <deque>
 #include <fstream>
+#include <mutex>
 #include <sstream>
 #include <vector>
 #include <glad/glad.h>
 #include "vivid/core/Shader.h"
 #include "vivid/core/Attribute.h"
+#include "vivid/core/FrameUniforms.h"
+#include "vivid/core/GLContext.h"
+#include "vivid/core/GLStateCache.h"
+#include "vivid/core/ShaderCache.h"
+#include "vivid/core/ShaderSource.h"
 
 
 namespace vivid {
 
-bool CompileShader(GLuint shaderHandle, const char* shaderCode) {
-    glShaderSource(shaderHandle, 1, &shaderCode, nullptr);
-    glCompileShader(shaderHandle);
-
-    // Check vertex shader
-    GLint result = GL_FALSE;
-    glGetShaderiv(shaderHandle, GL_COMPILE_STATUS, &result);
-    if (result == GL_FALSE) {
-        int infoLength;
-        glGetShaderiv(shaderHandle, GL_INFO_LOG_LENGTH, &infoLength);
-        std::vector<char> errMessage(infoLength + 1);
-        glGetShaderInfoLog(shaderHandle, infoLength, nullptr, &errMessage[0]);
-        printf("%s\n", &errMessage[0]);
-        return false;
+// Names of the uniform handles, indexed by id
+namespace {
+struct HandleRegistry {
+    std::mutex mutex;
+    std::unordered_map<std::string, uint32_t> ids;
+    std::deque<std::string> names;      // stable references
+};
+
+HandleRegistry& Registry() {
+    static HandleRegistry registry;
+    return registry;
+}
+} // namespace
+
+
+UniformHandle::UniformHandle(const std::string &name) {
+    HandleRegistry &registry = Registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    auto it = registry.ids.find(name);
+    if (it == registry.ids.end()) {
+        it = registry.ids.emplace(name, static_cast<uint32_t>(registry.names.size())).first;
+        registry.names.push_back(name);
+    }
+    id_ = it->second;
+}
+
+
+const std::string& UniformHandle::Name() const {
+    static const std::string invalid;
+    if (!IsValid()) {
+        return invalid;
     }
-    return true;
+    HandleRegistry &registry = Registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    return registry.names[id_];
+}
+
+
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+// Info log of a shader or program
+static std::string ShaderLog(GLuint shader) {
+    int length = 0;
+    glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &length);
+    std::vector<char> log(length + 1, 0);
+    glGetShaderInfoLog(shader, length, nullptr, log.data());
+    return log.data();
+}
+
+static std::string ProgramLog(GLuint program) {
+    int length = 0;
+    glGetProgramiv(program, GL_INFO_LOG_LENGTH, &length);
+    std::vector<char> log(length + 1, 0);
+    glGetProgramInfoLog(program, length, nullptr, log.data());
+    return log.data();
 }
 
 
@@ -38,50 +88,138 @@ Shader::Shader(const char* vertexShaderCode, const char* fragmentShaderCode) {
 }
 
 
-void Shader::Create(const char *vertexShaderCode, const char *fragmentShaderCode) {
+Shader::Shader(unsigned int programHandle) {
+    programHandle_ = programHandle;
+    Setup();
+}
 
-    // Create the shaders
-    GLuint vertShaderID = glCreateShader(GL_VERTEX_SHADER);
-    GLuint fragShaderID = glCreateShader(GL_FRAGMENT_SHADER);
 
-    // Compile vertex shader and check
-    if (!CompileShader(vertShaderID, vertexShaderCode)) {
-        std::cerr << "failed to compile vertex shader!";
-        exit(-1);
+Shader::~Shader() {
+    if (programHandle_ && GLContext::IsAlive()) {
+        GLStateCache::Instance().ForgetProgram(programHandle_);
+        glDeleteProgram(programHandle_);
     }
+}
 
-    // Compile fragment shader and check
-    if (!CompileShader(fragShaderID, fragmentShaderCode)) {
-        std::cerr << "failed to compile fragment shader!";
-        exit(-1);
+
+bool Shader::ParallelCompileSupported() {
+    static int supported = -1;
+    if (supported < 0) {
+        supported = 0;
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint i = 0; i < count; ++i) {
+            const auto *name = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+            if (name != nullptr && (strcmp(name, "GL_KHR_parallel_shader_compile") == 0
+                                    || strcmp(name, "GL_ARB_parallel_shader_compile") == 0)) {
+                supported = 1;
+                break;
+            }
+        }
+    }
+    return supported == 1;
+}
+
+
+ProgramBuild Shader::SubmitProgram(const char* vertexShaderCode, const char* fragmentShaderCode,
+                                   const std::string &defines) {
+    // Resolve the shared chunks, see ShaderSource
+    ProgramBuild build;
+    build.vertexSource = ShaderSource::Preprocess(vertexShaderCode, defines);
+    build.fragmentSource = ShaderSource::Preprocess(fragmentShaderCode, defines);
+
+    // Reuse the binary of a previous run if the driver accepts it
+    ShaderCache &cache = ShaderCache::Instance();
+    build.program = cache.Load(build.vertexSource.c_str(), build.fragmentSource.c_str());
+    if (build.program != 0) {
+        build.cached = true;
+        return build;
     }
 
-    // Link the program
-    GLuint programID = glCreateProgram();
-    glAttachShader(programID, vertShaderID);
-    glAttachShader(programID, fragShaderID);
-    glLinkProgram(programID);
-
-    // Check the program
-    GLint ret;
-    glGetProgramiv(programID, GL_LINK_STATUS, &ret);
-    if (ret == GL_FALSE) {
-        int infoLength;
-        glGetProgramiv(programID, GL_INFO_LOG_LENGTH, &infoLength);
-        std::vector<char> errMessage(infoLength + 1);
-        glGetProgramInfoLog(programID, infoLength, nullptr, &errMessage[0]);
-        printf("%s\n", &errMessage[0]);
-        std::cerr << "failed to link program!";
+    // The statuses are only queried by FinishProgram(), so the driver doesn't have to wait for the compiler
+    const char *vertexCode = build.vertexSource.c_str();
+    const char *fragmentCode = build.fragmentSource.c_str();
+    build.vertexShader = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(build.vertexShader, 1, &vertexCode, nullptr);
+    glCompileShader(build.vertexShader);
+    build.fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(build.fragmentShader, 1, &fragmentCode, nullptr);
+    glCompileShader(build.fragmentShader);
+
+    // Link the program, keeping its binary retrievable for the cache
+    build.program = glCreateProgram();
+    glAttachShader(build.program, build.vertexShader);
+    glAttachShader(build.program, build.fragmentShader);
+    if (cache.IsSupported()) {
+        glProgramParameteri(build.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+    glLinkProgram(build.program);
+    return build;
+}
+
+
+bool Shader::IsProgramReady(const ProgramBuild &build) {
+    if (build.program == 0 || build.cached || !ParallelCompileSupported()) {
+        return true;
+    }
+    GLint completed = GL_FALSE;
+    glGetProgramiv(build.program, GL_COMPLETION_STATUS_KHR, &completed);
+    return completed == GL_TRUE;
+}
+
+
+unsigned int Shader::FinishProgram(ProgramBuild &build, std::string &error) {
+    GLuint program = build.program;
+    if (program != 0 && !build.cached) {
+        // Compile errors first, the link fails with them anyway
+        GLint status = GL_FALSE;
+        glGetShaderiv(build.vertexShader, GL_COMPILE_STATUS, &status);
+        if (status == GL_FALSE) {
+            error += "failed to compile vertex shader:\n" + ShaderLog(build.vertexShader);
+        }
+        glGetShaderiv(build.fragmentShader, GL_COMPILE_STATUS, &status);
+        if (status == GL_FALSE) {
+            error += "failed to compile fragment shader:\n" + ShaderLog(build.fragmentShader);
+        }
+        if (error.empty()) {
+            glGetProgramiv(program, GL_LINK_STATUS, &status);
+            if (status == GL_FALSE) {
+                error += "failed to link program:\n" + ProgramLog(program);
+            }
+        }
+
+        // Detach program and delete shaders
+        glDetachShader(program, build.vertexShader);
+        glDetachShader(program, build.fragmentShader);
+        glDeleteShader(build.vertexShader);
+        glDeleteShader(build.fragmentShader);
+        if (error.empty()) {
+            ShaderCache::Instance().Store(program, build.vertexSource.c_str(), build.fragmentSource.c_str());
+        } else {
+            glDeleteProgram(program);
+            program = 0;
+        }
+    }
+    build = ProgramBuild();
+    return program;
+}
+
+
+void Shader::Create(const char *vertexShaderCode, const char *fragmentShaderCode) {
+    ProgramBuild build = SubmitProgram(vertexShaderCode, fragmentShaderCode);
+    std::string error;
+    programHandle_ = FinishProgram(build, error);
+    if (programHandle_ == 0) {
+        std::cerr << error;
         exit(-1);
     }
+    Setup();
+}
 
-    // Detach program and delete shaders
-    glDetachShader(programID, vertShaderID);
-    glDetachShader(programID, fragShaderID);
-    glDeleteShader(vertShaderID);
-    glDeleteShader(fragShaderID);
 
-    programHandle_ = programID;
+void Shader::Setup() {
+    // Left in use, for the uniforms set right after creation
+    Use();
 
     // Get attribute locations
     ExtractAttributeLocations();
@@ -89,106 +227,241 @@ void Shader::Create(const char *vertexShaderCode, const char *fragmentShaderCode
     // Extract uniforms
     ExtractUniformLocations();
 
+    BindUniformBlocks();
 }
 
 
 void Shader::ExtractAttributeLocations() {
-    glUseProgram(programHandle_);
-    attributeLocations_.clear();
+    vertexLayout_ = VertexLayout();
+    uint32_t usedLocations = 0;
     for (int i = 0; i < kAttribNum; i++) {
         auto attrType = static_cast<AttributeType>(i);
         std::string name = AttributeName(attrType);
         int loc = glGetAttribLocation(programHandle_, name.c_str());
         if (loc >= 0) {
-            if (attributeLocations_.count(loc) > 0) {
+            if (usedLocations & (1u << loc)) {
                 std::cerr << "Error: find repeated attribute locations in the shader!\n";
                 exit(-1);
             }
-            attributeLocations_[loc] = name;
+            usedLocations |= 1u << loc;
+            vertexLayout_.SetLocation(attrType, loc);
             std::cout << "attribute=" << name << ", location=" << loc << std::endl;
         }
     }
+}
 
-    // Convert attribute locations to a string
-    std::stringstream ss;
-    for (auto& it : attributeLocations_) {
-        ss << it.second << "_" << it.first << "_";
-    }
-    attributeLocationsStr_ = ss.str();
-    std::cout << "attribute locations str: " << attributeLocationsStr_ << std::endl;
+
+int Shader::GetAttributeLocation(const std::string &name) const {
+    return glGetAttribLocation(programHandle_, name.c_str());
 }
 
 
 void Shader::ExtractUniformLocations() {
-    glUseProgram(programHandle_);
-    activeUniforms_.clear();
+    uniforms_.clear();
+    uniformIndices_.clear();
+    handleLocations_.clear();
+
+    auto addUniform = [this](const std::string &name, GLenum type, int arraySize) {
+        const int location = glGetUniformLocation(programHandle_, name.c_str());
+        if (location < 0) {
+            return;
+        }
+        uniformIndices_[name] = uniforms_.size();
+        uniforms_.push_back({name, static_cast<unsigned int>(type), location, arraySize});
+
+        const uint32_t id = UniformHandle(name).Id();
+        if (id >= handleLocations_.size()) {
+            handleLocations_.resize(id + 1, -1);
+        }
+        handleLocations_[id] = location;
+    };
+
     int numUniforms = 0;
     glGetProgramiv(programHandle_, GL_ACTIVE_UNIFORMS, &numUniforms);
-    std::vector<GLchar> nameData(32);
+    int maxNameLength = 0;
+    glGetProgramiv(programHandle_, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+    std::vector<GLchar> nameData(std::max(maxNameLength, 1));
     for (int i = 0; i < numUniforms; i++) {
-        GLsizei arraySize = 0;
+        GLint arraySize = 0;
         GLenum type = 0;
         GLsizei actualLength = 0;
         glGetActiveUniform(programHandle_, (GLuint)i, (GLsizei)nameData.size(), &actualLength, &arraySize, &type, &nameData[0]);
+        GLint blockIndex = -1;
+        const GLuint index = i;
+        glGetActiveUniformsiv(programHandle_, 1, &index, GL_UNIFORM_BLOCK_INDEX, &blockIndex);
+        if (blockIndex >= 0) {
+            continue;
+        }
         std::string name((char*)nameData.data(), actualLength);
-        Uniform uniform;
-        uniform.name = name;
-        uniform.type = static_cast<unsigned int>(type);
-        activeUniforms_[name] = uniform;
+
+        // Arrays are reported by their first element: list the array and every element
+        const size_t bracket = name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0
+                               ? name.size() - 3 : std::string::npos;
+        if (bracket != std::string::npos) {
+            const std::string base = name.substr(0, bracket);
+            addUniform(base, type, arraySize);
+            for (int e = 0; e < arraySize; ++e) {
+                addUniform(base + "[" + std::to_string(e) + "]", type, 1);
+            }
+        } else {
+            addUniform(name, type, arraySize);
+        }
         std::cout << "uniform=" << name << ", type=" << type << std::endl;
     }
 }
 
 
-void Shader::Use() const {
-    // Bind
-    glUseProgram(programHandle_);
+void Shader::BindUniformBlocks() {
+    const GLuint frameBlock = glGetUniformBlockIndex(programHandle_, "FrameUniforms");
+    usesFrameUniforms_ = frameBlock != GL_INVALID_INDEX;
+    if (usesFrameUniforms_) {
+        glUniformBlockBinding(programHandle_, frameBlock, FrameUniforms::kBindingPoint);
+    }
+}
+
 
+void Shader::Use() const {
+    // Bind, unless the program is in use already
+    GLStateCache::Instance().UseProgram(programHandle_);
 }
 
 
 void Shader::SetBool(const std::string &name, bool value) const {
-    CheckUniformName(name);
-    glUniform1i(glGetUniformLocation(programHandle_, name.c_str()), (int)value);
+    const int location = CheckedLocation(name);
+    glUniform1i(location, (int)value);
 }
 
 void Shader::SetInt(const std::string &name, int value) const {
-    CheckUniformName(name);
-    glUniform1i(glGetUniformLocation(programHandle_, name.c_str()), value);
+    const int location = CheckedLocation(name);
+    glUniform1i(location, value);
 }
 
 void Shader::SetFloat(const std::string &name, float value) const {
-    CheckUniformName(name);
-    glUniform1f(glGetUniformLocation(programHandle_, name.c_str()), value);
+    const int location = CheckedLocation(name);
+    glUniform1f(location, value);
 }
 
 void Shader::SetMat4(const std::string &name, const glm::mat4 &m) const {
-    CheckUniformName(name);
-    glUniformMatrix4fv(glGetUniformLocation(programHandle_, name.c_str()),
-                                 1, GL_FALSE, &m[0][0]);
+    const int location = CheckedLocation(name);
+    glUniformMatrix4fv(location, 1, GL_FALSE, &m[0][0]);
 }
 
 void Shader::SetMat3(const std::string &name, const glm::mat3 &m) const {
-    CheckUniformName(name);
-    glUniformMatrix3fv(glGetUniformLocation(programHandle_, name.c_str()),
-                                 1, GL_FALSE, &m[0][0]);
+    const int location = CheckedLocation(name);
+    glUniformMatrix3fv(location, 1, GL_FALSE, &m[0][0]);
 }
 
 void Shader::SetVec3(const std::string &name, const glm::vec3 &v) const {
-    CheckUniformName(name);
-    glUniform3fv(glGetUniformLocation(programHandle_, name.c_str()), 1, &v[0]);
+    const int location = CheckedLocation(name);
+    glUniform3fv(location, 1, &v[0]);
 }
 
 void Shader::SetVec4(const std::string &name, const glm::vec4 &v) const {
-    CheckUniformName(name);
-    glUniform4fv(glGetUniformLocation(programHandle_, name.c_str()), 1, &v[0]);
+    const int location = CheckedLocation(name);
+    glUniform4fv(location, 1, &v[0]);
+}
+
+
+void Shader::SetBool(UniformHandle handle, bool value) const {
+    const int location = GetUniformLocation(handle);
+    glUniform1i(location, (int)value);
+}
+
+void Shader::SetInt(UniformHandle handle, int value) const {
+    const int location = GetUniformLocation(handle);
+    glUniform1i(location, value);
+}
+
+void Shader::SetFloat(UniformHandle handle, float value) const {
+    const int location = GetUniformLocation(handle);
+    glUniform1f(location, value);
+}
+
+void Shader::SetMat4(UniformHandle handle, const glm::mat4 &m) const {
+    const int location = GetUniformLocation(handle);
+    glUniformMatrix4fv(location, 1, GL_FALSE, &m[0][0]);
+}
+
+void Shader::SetMat3(UniformHandle handle, const glm::mat3 &m) const {
+    const int location = GetUniformLocation(handle);
+    glUniformMatrix3fv(location, 1, GL_FALSE, &m[0][0]);
+}
+
+void Shader::SetVec3(UniformHandle handle, const glm::vec3 &v) const {
+    const int location = GetUniformLocation(handle);
+    glUniform3fv(location, 1, &v[0]);
+}
+
+void Shader::SetVec4(UniformHandle handle, const glm::vec4 &v) const {
+    const int location = GetUniformLocation(handle);
+    glUniform4fv(location, 1, &v[0]);
+}
+
+
+void Shader::SetIntArray(const std::string &name, const int *values, int count) const {
+    const int location = CheckedLocation(name);
+    glUniform1iv(location, count, values);
+}
+
+void Shader::SetFloatArray(const std::string &name, const float *values, int count) const {
+    const int location = CheckedLocation(name);
+    glUniform1fv(location, count, values);
+}
+
+void Shader::SetVec3Array(const std::string &name, const glm::vec3 *values, int count) const {
+    const int location = CheckedLocation(name);
+    glUniform3fv(location, count, &values[0][0]);
+}
+
+void Shader::SetVec4Array(const std::string &name, const glm::vec4 *values, int count) const {
+    const int location = CheckedLocation(name);
+    glUniform4fv(location, count, &values[0][0]);
+}
+
+void Shader::SetMat4Array(const std::string &name, const glm::mat4 *values, int count) const {
+    const int location = CheckedLocation(name);
+    glUniformMatrix4fv(location, count, GL_FALSE, &values[0][0][0]);
+}
+
+
+void Shader::SetIntArray(UniformHandle handle, const int *values, int count) const {
+    const int location = GetUniformLocation(handle);
+    glUniform1iv(location, count, values);
+}
+
+void Shader::SetFloatArray(UniformHandle handle, const float *values, int count) const {
+    const int location = GetUniformLocation(handle);
+    glUniform1fv(location, count, values);
+}
+
+void Shader::SetVec3Array(UniformHandle handle, const glm::vec3 *values, int count) const {
+    const int location = GetUniformLocation(handle);
+    glUniform3fv(location, count, &values[0][0]);
+}
+
+void Shader::SetVec4Array(UniformHandle handle, const glm::vec4 *values, int count) const {
+    const int location = GetUniformLocation(handle);
+    glUniform4fv(location, count, &values[0][0]);
+}
+
+void Shader::SetMat4Array(UniformHandle handle, const glm::mat4 *values, int count) const {
+    const int location = GetUniformLocation(handle);
+    glUniformMatrix4fv(location, count, GL_FALSE, &values[0][0][0]);
+}
+
+
+int Shader::GetUniformLocation(const std::string &name) const {
+    auto it = uniformIndices_.find(name);
+    return it != uniformIndices_.end() ? uniforms_[it->second].location : -1;
 }
 
 
-void Shader::CheckUniformName(const std::string &name) const {
-    if (!HasUniform(name)) {
+int Shader::CheckedLocation(const std::string &name) const {
+    const int location = GetUniformLocation(name);
+    if (location < 0) {
         std::cerr << "Warning: uniform (" << name << ") not found in the shader!\n";
     }
+    return location;
 }
 
 
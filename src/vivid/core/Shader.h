@@ -1,26 +1,75 @@
 #pragma once
 
 #include <iostream>
+#include <cstdint>
 #include <glm/glm.hpp>
-#include <map>
 #include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "VertexLayout.h"
 
 namespace vivid {
 
 struct Uniform {
-    std::string name;
+    std::string name;       // array elements are listed as name[i]
     unsigned int type;
+    int location;
+    int arraySize;          // 1 for non-array uniforms and array elements
 };
 
+
+/* Process-wide id of a uniform name, valid for all shaders. Resolve the name once, e.g. in a static, then
+ * set the uniform of any shader without string handling: the location is an index away.
+ */
+class UniformHandle {
+public:
+    UniformHandle() = default;
+
+    explicit UniformHandle(const std::string &name);
+
+    inline uint32_t Id() const { return id_; }
+    inline bool IsValid() const { return id_ != kInvalidId; }
+
+    const std::string& Name() const;
+
+private:
+    static constexpr uint32_t kInvalidId = UINT32_MAX;
+    uint32_t id_ = kInvalidId;
+};
+
+/* Program being compiled and linked by the driver, see Shader::SubmitProgram(). */
+struct ProgramBuild {
+    unsigned int program = 0;
+    unsigned int vertexShader = 0;
+    unsigned int fragmentShader = 0;
+    bool cached = false;            // loaded from the ShaderCache, already linked
+
+    // Preprocessed sources, for the cache
+    std::string vertexSource;
+    std::string fragmentSource;
+};
+
+
 class Shader {
 public:
     Shader();
 
+    // Legacy: compile and link the program, and exit on errors. vivid itself doesn't use it: build with
+    // SubmitProgram() and FinishProgram(), or a ShaderLibrary, which report errors instead.
     Shader(const char* vertexShaderCode, const char* fragmentShaderCode);
 
+    // Take a linked program, e.g. from FinishProgram()
+    explicit Shader(unsigned int programHandle);
+
+    ~Shader();
+
+    Shader(const Shader&) = delete;
+    Shader& operator=(const Shader&) = delete;
+
     void Use() const;
 
-    // Set uniforms
+    // Set uniforms of this shader, which must be in use. Uniforms missing from the shader are reported.
     void SetBool(const std::string& name, bool value) const;
     void SetInt(const std::string& name, int value) const;
     void SetFloat(const std::string& name, float value) const;
@@ -29,33 +78,103 @@ public:
     void SetVec3(const std::string& name, const glm::vec3 &v) const;
     void SetVec4(const std::string& name, const glm::vec4 &v) const;
 
-    const std::map<int, std::string>& AttributeLocations() const {
-        return attributeLocations_;
+    // Same with a handle, without any lookup. Uniforms missing from the shader are skipped silently.
+    void SetBool(UniformHandle handle, bool value) const;
+    void SetInt(UniformHandle handle, int value) const;
+    void SetFloat(UniformHandle handle, float value) const;
+    void SetMat4(UniformHandle handle, const glm::mat4 &m) const;
+    void SetMat3(UniformHandle handle, const glm::mat3 &m) const;
+    void SetVec3(UniformHandle handle, const glm::vec3 &v) const;
+    void SetVec4(UniformHandle handle, const glm::vec4 &v) const;
+
+    // Set `count` consecutive elements of an array uniform, starting at the element named or referred to
+    // (the array name is its first element).
+    void SetIntArray(const std::string& name, const int *values, int count) const;
+    void SetFloatArray(const std::string& name, const float *values, int count) const;
+    void SetVec3Array(const std::string& name, const glm::vec3 *values, int count) const;
+    void SetVec4Array(const std::string& name, const glm::vec4 *values, int count) const;
+    void SetMat4Array(const std::string& name, const glm::mat4 *values, int count) const;
+    void SetIntArray(UniformHandle handle, const int *values, int count) const;
+    void SetFloatArray(UniformHandle handle, const float *values, int count) const;
+    void SetVec3Array(UniformHandle handle, const glm::vec3 *values, int count) const;
+    void SetVec4Array(UniformHandle handle, const glm::vec4 *values, int count) const;
+    void SetMat4Array(UniformHandle handle, const glm::mat4 *values, int count) const;
+
+    // Location of a uniform, resolved at link time. -1 if the shader doesn't use it.
+    int GetUniformLocation(const std::string& name) const;
+    inline int GetUniformLocation(UniformHandle handle) const {
+        return handle.Id() < handleLocations_.size() ? handleLocations_[handle.Id()] : -1;
     }
 
-    const std::string& AttributeLocationsStr() const {
-        return attributeLocationsStr_;
+    // Location of a vertex attribute not covered by AttributeType, e.g. a per-instance attribute.
+    // -1 if the shader doesn't use it.
+    int GetAttributeLocation(const std::string& name) const;
+
+    // Locations of the vertex attributes used by this shader
+    const VertexLayout& GetVertexLayout() const {
+        return vertexLayout_;
     }
 
+    // Uniforms of the default block only, the members of uniform blocks are not listed
     bool HasUniform(const std::string& name) const {
-        return activeUniforms_.count(name) > 0;
+        return uniformIndices_.count(name) > 0;
+    }
+
+    inline bool HasUniform(UniformHandle handle) const {
+        return GetUniformLocation(handle) >= 0;
     }
 
+    // Active uniforms, array elements included
+    inline const std::vector<Uniform>& GetUniforms() const { return uniforms_; }
+
+    // True if the shader declares the FrameUniforms block, bound to FrameUniforms::kBindingPoint
+    bool UsesFrameUniforms() const {
+        return usesFrameUniforms_;
+    }
+
+    inline unsigned int GetProgramHandle() const { return programHandle_; }
+
+    // Start compiling and linking the sources without waiting for the driver, unless the ShaderCache has the
+    // program. The sources are preprocessed here, with `defines` inserted after their #version line, see
+    // ShaderSource. Several builds submitted before they are finished can run in parallel.
+    static ProgramBuild SubmitProgram(const char* vertexShaderCode, const char* fragmentShaderCode,
+                                      const std::string &defines = "");
+
+    // True once the driver finished the build. Without GL_KHR_parallel_shader_compile the driver can't be
+    // asked, and this is always true: FinishProgram() then blocks until it finishes.
+    static bool IsProgramReady(const ProgramBuild &build);
+
+    // Check the build and store the program in the ShaderCache. Return the program, or 0 with the compiler
+    // and linker logs in `error`; the build is released in both cases.
+    static unsigned int FinishProgram(ProgramBuild &build, std::string &error);
+
+    // GL_KHR_parallel_shader_compile or GL_ARB_parallel_shader_compile, needs a current context
+    static bool ParallelCompileSupported();
+
 private:
     void Create(const char* vertexShaderCode, const char* fragmentShaderCode);
 
+    // Read the attributes and uniforms of the linked program
+    void Setup();
+
     void ExtractAttributeLocations();
 
     void ExtractUniformLocations();
 
-    void CheckUniformName(const std::string &name) const;
+    void BindUniformBlocks();
+
+    // Location of a uniform set by name, reported if the shader doesn't have it
+    int CheckedLocation(const std::string &name) const;
 
     unsigned int programHandle_;
 
-    std::map<int, std::string> attributeLocations_;
-    std::string attributeLocationsStr_;
+    VertexLayout vertexLayout_;
+
+    std::vector<Uniform> uniforms_;
+    std::unordered_map<std::string, size_t> uniformIndices_;
+    std::vector<int> handleLocations_;      // indexed by handle id, -1 if the uniform isn't used
 
-    std::map<std::string, Uniform> activeUniforms_;
+    bool usesFrameUniforms_ = false;
 };
 
 using ShaderPtr = std::shared_ptr<Shader>;
@@ -0,0 +1,222 @@
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <vector>
+#include <glad/glad.h>
+#include "vivid/core/ShaderCache.h"
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+namespace vivid {
+
+// Header of a cache file, followed by the binary
+struct BinaryHeader {
+    char magic[4] = {'V', 'V', 'P', 'B'};
+    uint32_t version = 1;
+    uint64_t key = 0;
+    uint64_t vertexSourceLength = 0;
+    uint64_t fragmentSourceLength = 0;
+    uint32_t binaryFormat = 0;
+    uint32_t binaryLength = 0;
+};
+
+
+static bool MakeCacheDirectory(const std::string &path) {
+#ifdef _WIN32
+    return _mkdir(path.c_str()) == 0 || errno == EEXIST;
+#else
+    return mkdir(path.c_str(), 0755) == 0 || errno == EEXIST;
+#endif
+}
+
+
+static std::string GLString(GLenum name) {
+    const auto *str = reinterpret_cast<const char*>(glGetString(name));
+    return str != nullptr ? str : "";
+}
+
+
+static bool HasExtension(const char *extension) {
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; ++i) {
+        const auto *name = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+        if (name != nullptr && strcmp(name, extension) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+ShaderCache& ShaderCache::Instance() {
+    static ShaderCache cache;
+    return cache;
+}
+
+
+bool ShaderCache::LoadProgramBinaryExtension(ProcLoader loader) {
+    if (!GLAD_GL_VERSION_4_1) {
+        if (!HasExtension("GL_ARB_get_program_binary")) {
+            return false;
+        }
+        // The extension uses the core names
+        glad_glGetProgramBinary = reinterpret_cast<PFNGLGETPROGRAMBINARYPROC>(loader("glGetProgramBinary"));
+        glad_glProgramBinary = reinterpret_cast<PFNGLPROGRAMBINARYPROC>(loader("glProgramBinary"));
+        glad_glProgramParameteri = reinterpret_cast<PFNGLPROGRAMPARAMETERIPROC>(loader("glProgramParameteri"));
+        Instance().supported_ = -1;
+    }
+    return glGetProgramBinary != nullptr && glProgramBinary != nullptr && glProgramParameteri != nullptr;
+}
+
+
+void ShaderCache::SetDirectory(const std::string &directory) {
+    directory_ = directory;
+    directoryCreated_ = false;
+}
+
+
+uint64_t ShaderCache::Hash(const void *data, size_t size, uint64_t hash) {
+    const auto *bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+
+bool ShaderCache::IsSupported() {
+    if (supported_ < 0) {
+        GLint formatCount = 0;
+        const bool available = GLAD_GL_VERSION_4_1 || HasExtension("GL_ARB_get_program_binary");
+        if (available && glGetProgramBinary != nullptr && glProgramBinary != nullptr
+            && glProgramParameteri != nullptr) {
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+        }
+        supported_ = formatCount > 0 ? 1 : 0;
+
+        // Binaries are only valid for the driver that produced them
+        const std::string driver = GLString(GL_VENDOR) + '\n' + GLString(GL_RENDERER) + '\n' + GLString(GL_VERSION);
+        driverHash_ = Hash(driver.data(), driver.size());
+    }
+    return supported_ == 1;
+}
+
+
+uint64_t ShaderCache::Key(const char *vertexShaderCode, const char *fragmentShaderCode) {
+    // The terminating nulls separate the sources
+    uint64_t key = Hash(vertexShaderCode, std::strlen(vertexShaderCode) + 1, driverHash_);
+    return Hash(fragmentShaderCode, std::strlen(fragmentShaderCode) + 1, key);
+}
+
+
+std::string ShaderCache::FilePath(uint64_t key) const {
+    char name[24];
+    snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(key));
+    return directory_ + "/" + name;
+}
+
+
+unsigned int ShaderCache::Load(const char *vertexShaderCode, const char *fragmentShaderCode) {
+    if (directory_.empty() || !IsSupported()) {
+        return 0;
+    }
+    const uint64_t key = Key(vertexShaderCode, fragmentShaderCode);
+    const std::string path = FilePath(key);
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        missCount_++;
+        return 0;
+    }
+
+    BinaryHeader expected;
+    expected.key = key;
+    expected.vertexSourceLength = std::strlen(vertexShaderCode);
+    expected.fragmentSourceLength = std::strlen(fragmentShaderCode);
+    BinaryHeader header;
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    std::vector<char> binary;
+    bool valid = file.good() && std::memcmp(header.magic, expected.magic, 4) == 0
+                 && header.version == expected.version && header.key == expected.key
+                 && header.vertexSourceLength == expected.vertexSourceLength
+                 && header.fragmentSourceLength == expected.fragmentSourceLength;
+    if (valid) {
+        binary.resize(header.binaryLength);
+        file.read(binary.data(), static_cast<std::streamsize>(binary.size()));
+        valid = file.good();
+    }
+    file.close();
+
+    GLuint program = 0;
+    if (valid) {
+        // The driver rejects binaries it can't use, e.g. after an update
+        program = glCreateProgram();
+        glProgramBinary(program, header.binaryFormat, binary.data(), static_cast<GLsizei>(binary.size()));
+        GLint linked = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        if (linked == GL_FALSE) {
+            glDeleteProgram(program);
+            program = 0;
+        }
+    }
+    if (program == 0) {
+        std::cerr << "Warning: the cached program binary " << path << " is out of date, compiling from source\n";
+        std::remove(path.c_str());
+        missCount_++;
+        return 0;
+    }
+    hitCount_++;
+    return program;
+}
+
+
+void ShaderCache::Store(unsigned int program, const char *vertexShaderCode, const char *fragmentShaderCode) {
+    if (directory_.empty() || !IsSupported()) {
+        return;
+    }
+    if (!directoryCreated_) {
+        if (!MakeCacheDirectory(directory_)) {
+            std::cerr << "Warning: failed to create the shader cache directory " << directory_ << "!\n";
+            directory_.clear();
+            return;
+        }
+        directoryCreated_ = true;
+    }
+
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return;
+    }
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    glGetProgramBinary(program, length, &length, &format, binary.data());
+
+    BinaryHeader header;
+    header.key = Key(vertexShaderCode, fragmentShaderCode);
+    header.vertexSourceLength = std::strlen(vertexShaderCode);
+    header.fragmentSourceLength = std::strlen(fragmentShaderCode);
+    header.binaryFormat = format;
+    header.binaryLength = static_cast<uint32_t>(length);
+
+    // Written to a temporary file first, so that an interrupted write leaves no partial entry
+    const std::string path = FilePath(header.key);
+    const std::string tempPath = path + ".tmp";
+    std::ofstream file(tempPath, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(binary.data(), length);
+    file.close();
+    std::remove(path.c_str());
+    if (!file.good() || std::rename(tempPath.c_str(), path.c_str()) != 0) {
+        std::cerr << "Warning: failed to write the program binary " << path << "!\n";
+        std::remove(tempPath.c_str());
+    }
+}
+
+} // namespace vivid
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <iostream>
+#include <cstdint>
+#include <string>
+
+namespace vivid {
+
+/* On-disk cache of linked program binaries (glGetProgramBinary / glProgramBinary), so that programs are
+ * compiled from source once per driver instead of on every start.
+ *
+ * A binary is keyed by a hash of the vertex and fragment sources and of the vendor, renderer and version
+ * strings of the driver. It is only used if its header matches, and if the driver accepts it; otherwise the
+ * program is compiled from source and the entry rewritten. Without binary format support the cache does
+ * nothing.
+ */
+class ShaderCache {
+public:
+    // Resolver of GL entry points, e.g. glfwGetProcAddress
+    using ProcLoader = void* (*)(const char *name);
+
+    // Cache used by Shader, in the "shader_cache" directory of the working directory
+    static ShaderCache& Instance();
+
+    // Below GL 4.1, resolve the entry points of GL_ARB_get_program_binary, which glad only loads with 4.1.
+    // Return true if the program binary functions are available.
+    static bool LoadProgramBinaryExtension(ProcLoader loader);
+
+    // Directory of the cache files, created when the first binary is stored. Empty to disable the cache.
+    void SetDirectory(const std::string &directory);
+    inline const std::string& GetDirectory() const { return directory_; }
+
+    // True if the driver can save and load program binaries, needs a current context
+    bool IsSupported();
+
+    // Program created from the cached binary of these sources, 0 if there is none or it is rejected
+    unsigned int Load(const char *vertexShaderCode, const char *fragmentShaderCode);
+
+    // Save the binary of a linked program, linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set
+    void Store(unsigned int program, const char *vertexShaderCode, const char *fragmentShaderCode);
+
+    // Programs loaded from the cache, and not found or rejected
+    inline unsigned int HitCount() const { return hitCount_; }
+    inline unsigned int MissCount() const { return missCount_; }
+
+    // 64-bit FNV-1a hash of `size` bytes, continued from `hash`
+    static uint64_t Hash(const void *data, size_t size, uint64_t hash = 14695981039346656037ull);
+
+private:
+    ShaderCache() = default;
+
+    // Key of the sources for the current driver, and path of its file
+    uint64_t Key(const char *vertexShaderCode, const char *fragmentShaderCode);
+    std::string FilePath(uint64_t key) const;
+
+    std::string directory_ = "shader_cache";
+    bool directoryCreated_ = false;
+
+    // Support and driver hash, queried once
+    int supported_ = -1;
+    uint64_t driverHash_ = 0;
+
+    unsigned int hitCount_ = 0;
+    unsigned int missCount_ = 0;
+};
+
+} // namespace vivid
@@ -0,0 +1,129 @@
+#include <algorithm>
+#include <glad/glad.h>
+#include "vivid/core/ShaderLibrary.h"
+#include "vivid/core/GLContext.h"
+
+namespace vivid {
+
+ShaderLibrary& ShaderLibrary::Default() {
+    static ShaderLibrary library;
+    return library;
+}
+
+
+ShaderLibrary::~ShaderLibrary() {
+    // Builds never finished own their program and shaders
+    if (!GLContext::IsAlive()) {
+        return;
+    }
+    for (const std::string &name : pending_) {
+        ProgramBuild &build = entries_[name].build;
+        if (build.vertexShader) {
+            glDeleteShader(build.vertexShader);
+        }
+        if (build.fragmentShader) {
+            glDeleteShader(build.fragmentShader);
+        }
+        if (build.program) {
+            glDeleteProgram(build.program);
+        }
+    }
+}
+
+
+bool ShaderLibrary::EnableParallelCompile(ProcLoader loader) {
+    if (!Shader::ParallelCompileSupported()) {
+        return false;
+    }
+    // Same entry point and semantics in both extensions
+    using MaxThreadsProc = void (*)(GLuint count);
+    auto maxThreads = reinterpret_cast<MaxThreadsProc>(loader("glMaxShaderCompilerThreadsKHR"));
+    if (maxThreads == nullptr) {
+        maxThreads = reinterpret_cast<MaxThreadsProc>(loader("glMaxShaderCompilerThreadsARB"));
+    }
+    if (maxThreads != nullptr) {
+        maxThreads(0xFFFFFFFF);     // chosen by the driver
+    }
+    return true;
+}
+
+
+bool ShaderLibrary::Submit(const std::string &name, const std::string &vertexShaderCode,
+                           const std::string &fragmentShaderCode, const std::string &defines) {
+    if (entries_.count(name) > 0) {
+        std::cerr << "Warning: the shader " << name << " is already in the library!\n";
+        return false;
+    }
+    Entry &entry = entries_[name];
+    entry.build = Shader::SubmitProgram(vertexShaderCode.c_str(), fragmentShaderCode.c_str(), defines);
+    pending_.push_back(name);
+    return true;
+}
+
+
+size_t ShaderLibrary::Poll() {
+    // Finish the ready programs, keeping the others in order
+    size_t kept = 0;
+    for (size_t i = 0; i < pending_.size(); ++i) {
+        Entry &entry = entries_[pending_[i]];
+        if (Shader::IsProgramReady(entry.build)) {
+            Finish(pending_[i], entry);
+        } else {
+            if (kept != i) {
+                pending_[kept] = std::move(pending_[i]);
+            }
+            kept++;
+        }
+    }
+    pending_.resize(kept);
+    return pending_.size();
+}
+
+
+void ShaderLibrary::Wait() {
+    for (const std::string &name : pending_) {
+        Finish(name, entries_[name]);
+    }
+    pending_.clear();
+}
+
+
+ShaderLibrary::Status ShaderLibrary::GetStatus(const std::string &name) const {
+    auto it = entries_.find(name);
+    return it != entries_.end() ? it->second.status : Status::kUnknown;
+}
+
+
+ShaderPtr ShaderLibrary::Get(const std::string &name) {
+    auto it = entries_.find(name);
+    if (it == entries_.end()) {
+        return nullptr;
+    }
+    Entry &entry = it->second;
+    if (entry.status == Status::kPending) {
+        Finish(name, entry);
+        pending_.erase(std::find(pending_.begin(), pending_.end(), name));
+    }
+    return entry.shader;
+}
+
+
+const std::string& ShaderLibrary::GetError(const std::string &name) const {
+    static const std::string none;
+    auto it = entries_.find(name);
+    return it != entries_.end() ? it->second.error : none;
+}
+
+
+void ShaderLibrary::Finish(const std::string &name, Entry &entry) {
+    const unsigned int program = Shader::FinishProgram(entry.build, entry.error);
+    if (program == 0) {
+        entry.status = Status::kFailed;
+        std::cerr << "Warning: failed to build the shader " << name << "!\n" << entry.error;
+        return;
+    }
+    entry.shader = std::make_shared<Shader>(program);
+    entry.status = Status::kReady;
+}
+
+} // namespace vivid
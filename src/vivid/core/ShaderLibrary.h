@@ -0,0 +1,79 @@
+#pragma once
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "vivid/core/Shader.h"
+
+namespace vivid {
+
+/* Named programs compiled in the background.
+ *
+ * Programs are submitted up front and only checked once the driver is done with them, so their compiles
+ * overlap, on the driver threads if GL_KHR_parallel_shader_compile is supported. Poll() once per frame
+ * finishes the completed programs without blocking; Get() finishes one on demand. Failures are kept as
+ * results with the compiler logs, nothing exits.
+ */
+class ShaderLibrary {
+public:
+    enum class Status {
+        kUnknown,       // never submitted
+        kPending,
+        kReady,
+        kFailed,
+    };
+
+    // Resolver of GL entry points, e.g. glfwGetProcAddress
+    using ProcLoader = void* (*)(const char *name);
+
+    // Library of the built-in shaders, see ShaderImpl::Precompile()
+    static ShaderLibrary& Default();
+
+    ShaderLibrary() = default;
+    ~ShaderLibrary();
+
+    ShaderLibrary(const ShaderLibrary&) = delete;
+    ShaderLibrary& operator=(const ShaderLibrary&) = delete;
+
+    // Let the driver use as many compiler threads as it wants. Return false without the extension.
+    static bool EnableParallelCompile(ProcLoader loader);
+
+    // Start compiling a program, with `defines` inserted after the #version lines. A name already submitted
+    // is kept, and false returned.
+    bool Submit(const std::string &name, const std::string &vertexShaderCode,
+                const std::string &fragmentShaderCode, const std::string &defines = "");
+
+    // Finish the programs the driver completed, without blocking if it can compile in parallel (otherwise
+    // all are finished). Return the number still pending.
+    size_t Poll();
+
+    // Finish all the programs
+    void Wait();
+
+    Status GetStatus(const std::string &name) const;
+
+    // Program of the name, finished now if still pending. Null if it failed or was never submitted.
+    ShaderPtr Get(const std::string &name);
+
+    // Compiler and linker logs of a failed program
+    const std::string& GetError(const std::string &name) const;
+
+    inline size_t PendingCount() const { return pending_.size(); }
+
+private:
+    struct Entry {
+        Status status = Status::kPending;
+        ProgramBuild build;
+        ShaderPtr shader;
+        std::string error;
+    };
+
+    void Finish(const std::string &name, Entry &entry);
+
+    std::unordered_map<std::string, Entry> entries_;
+    std::vector<std::string> pending_;      // in order of submission
+};
+
+} // namespace vivid
@@ -0,0 +1,148 @@
+#include <algorithm>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "vivid/core/ShaderSource.h"
+#include "vivid/core/FrameUniforms.h"
+
+namespace vivid {
+
+static const char* kFeaturesChunk = R"(
+#ifdef SHADER_VARIANT
+#define FEATURE(name, value) const bool name = value
+#else
+#define FEATURE(name, value) uniform bool name = false
+#endif
+)";
+
+
+namespace {
+struct ChunkRegistry {
+    std::mutex mutex;
+    std::unordered_map<std::string, std::string> chunks;
+
+    ChunkRegistry() {
+        chunks["frame_uniforms"] = FrameUniforms::Glsl();
+        chunks["features"] = kFeaturesChunk;
+    }
+};
+
+ChunkRegistry& Registry() {
+    static ChunkRegistry registry;
+    return registry;
+}
+
+
+// First non-blank character of the line [begin, end), or end
+size_t SkipBlanks(const std::string &source, size_t begin, size_t end) {
+    while (begin < end && (source[begin] == ' ' || source[begin] == '\t')) {
+        ++begin;
+    }
+    return begin;
+}
+
+
+bool StartsWith(const std::string &source, size_t pos, const char *prefix) {
+    return source.compare(pos, std::char_traits<char>::length(prefix), prefix) == 0;
+}
+
+
+// Append the source with its includes resolved. `stack` holds the chunks being expanded.
+void Expand(const std::string &source, std::vector<std::string> &stack, std::string &out) {
+    size_t begin = 0;
+    while (begin < source.size()) {
+        size_t end = source.find('\n', begin);
+        end = end == std::string::npos ? source.size() : end + 1;
+
+        const size_t directive = SkipBlanks(source, begin, end);
+        if (!StartsWith(source, directive, "#include")) {
+            out.append(source, begin, end - begin);
+            begin = end;
+            continue;
+        }
+
+        // Name between <> or ""
+        const size_t open = source.find_first_of("<\"", directive);
+        const size_t close = open < end ? source.find_first_of(">\"", open + 1) : std::string::npos;
+        if (close >= end) {
+            std::cerr << "Warning: malformed shader include '" << source.substr(begin, end - begin - 1) << "'!\n";
+            out.append(source, begin, end - begin);
+            begin = end;
+            continue;
+        }
+        const std::string name = source.substr(open + 1, close - open - 1);
+
+        std::string chunk;
+        {
+            ChunkRegistry &registry = Registry();
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            auto it = registry.chunks.find(name);
+            if (it != registry.chunks.end()) {
+                chunk = it->second;
+            }
+        }
+        if (chunk.empty()) {
+            // Left in place for the compiler to report
+            std::cerr << "Warning: unknown shader chunk '" << name << "'!\n";
+            out.append(source, begin, end - begin);
+        } else if (std::find(stack.begin(), stack.end(), name) != stack.end()) {
+            std::cerr << "Warning: shader chunk '" << name << "' includes itself!\n";
+        } else {
+            stack.push_back(name);
+            Expand(chunk, stack, out);
+            stack.pop_back();
+            if (!out.empty() && out.back() != '\n') {
+                out += '\n';
+            }
+        }
+        begin = end;
+    }
+}
+} // namespace
+
+
+void ShaderSource::RegisterChunk(const std::string &name, const std::string &source) {
+    ChunkRegistry &registry = Registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.chunks[name] = source;
+}
+
+
+bool ShaderSource::HasChunk(const std::string &name) {
+    ChunkRegistry &registry = Registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    return registry.chunks.count(name) > 0;
+}
+
+
+std::string ShaderSource::Preprocess(const std::string &source, const std::string &defines) {
+    if (defines.empty() && source.find("#include") == std::string::npos) {
+        return source;
+    }
+
+    std::string out;
+    out.reserve(source.size() + defines.size());
+    std::vector<std::string> stack;
+    Expand(source, stack, out);
+    if (defines.empty()) {
+        return out;
+    }
+
+    // The defines go after the #version line, which must come first
+    size_t begin = 0;
+    while (begin < out.size()) {
+        size_t end = out.find('\n', begin);
+        end = end == std::string::npos ? out.size() : end + 1;
+        if (StartsWith(out, SkipBlanks(out, begin, end), "#version")) {
+            if (out[end - 1] != '\n') {
+                out.insert(end++, 1, '\n');
+            }
+            out.insert(end, defines);
+            return out;
+        }
+        begin = end;
+    }
+    return defines + out;
+}
+
+} // namespace vivid
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+
+namespace vivid {
+
+/* Preprocessing of the GLSL sources before they are compiled.
+ *
+ * Sources can share code through named chunks: a line `#include <name>` is replaced by the chunk registered
+ * under that name, whose own includes are resolved too. Defines can be inserted after the `#version` line,
+ * e.g. to compile the variants of a shader. Built-in chunks:
+ *   frame_uniforms  the FrameUniforms block, see FrameUniforms::Glsl()
+ *   features        FEATURE(uniform, define): a bool uniform in the generic shader, a constant set by the
+ *                   define in the variants compiled by ShaderVariants
+ */
+class ShaderSource {
+public:
+    // Register or replace a chunk
+    static void RegisterChunk(const std::string &name, const std::string &source);
+    static bool HasChunk(const std::string &name);
+
+    // Source with its includes resolved and `defines` inserted after the #version line
+    static std::string Preprocess(const std::string &source, const std::string &defines = "");
+};
+
+} // namespace vivid
@@ -0,0 +1,70 @@
+#include <cstdio>
+#include "vivid/core/ShaderVariants.h"
+#include "vivid/core/ShaderCache.h"
+#include "vivid/core/ShaderLibrary.h"
+
+namespace vivid {
+
+ShaderVariants::ShaderVariants(std::string vertexSource, std::string fragmentSource,
+                               std::vector<std::string> defines)
+    : vertexSource_(std::move(vertexSource)),
+      fragmentSource_(std::move(fragmentSource)),
+      defines_(std::move(defines)) {
+    if (defines_.size() > 32) {
+        std::cerr << "Warning: shader variants support 32 features, " << defines_.size() - 32 << " ignored!\n";
+        defines_.resize(32);
+    }
+    validMask_ = defines_.size() == 32 ? ~0u : (1u << defines_.size()) - 1;
+
+    // The library names tell apart the variants of different sources
+    sourceHash_ = ShaderCache::Hash(vertexSource_.data(), vertexSource_.size());
+    sourceHash_ = ShaderCache::Hash(fragmentSource_.data(), fragmentSource_.size(), sourceHash_);
+    for (const std::string &define : defines_) {
+        sourceHash_ = ShaderCache::Hash(define.data(), define.size() + 1, sourceHash_);
+    }
+}
+
+
+void ShaderVariants::Submit(uint32_t featureMask) {
+    const uint32_t key = featureMask & validMask_;
+    if (variants_.count(key) > 0) {
+        return;
+    }
+    ShaderLibrary &library = ShaderLibrary::Default();
+    const std::string name = VariantName(key);
+    if (library.GetStatus(name) == ShaderLibrary::Status::kUnknown) {
+        library.Submit(name, vertexSource_, fragmentSource_, DefineBlock(key));
+    }
+}
+
+
+const ShaderPtr& ShaderVariants::Get(uint32_t featureMask) {
+    const uint32_t key = featureMask & validMask_;
+    auto it = variants_.find(key);
+    if (it != variants_.end()) {
+        return it->second;
+    }
+
+    Submit(key);
+    ShaderPtr shader = ShaderLibrary::Default().Get(VariantName(key));
+    return variants_.emplace(key, std::move(shader)).first->second;
+}
+
+
+std::string ShaderVariants::VariantName(uint32_t featureMask) const {
+    char name[48];
+    snprintf(name, sizeof(name), "variant/%016llx/%08x", static_cast<unsigned long long>(sourceHash_),
+             featureMask & validMask_);
+    return name;
+}
+
+
+std::string ShaderVariants::DefineBlock(uint32_t featureMask) const {
+    std::string block = "#define SHADER_VARIANT\n";
+    for (size_t i = 0; i < defines_.size(); ++i) {
+        block += "#define " + defines_[i] + ((featureMask >> i) & 1u ? " true\n" : " false\n");
+    }
+    return block;
+}
+
+} // namespace vivid
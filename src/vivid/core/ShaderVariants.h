@@ -0,0 +1,56 @@
+#pragma once
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <cstdint>
+#include "vivid/core/Shader.h"
+
+namespace vivid {
+
+/* Programs specialized from the same sources by the features of a material.
+ *
+ * Each bit of a feature mask stands for one define: a variant is compiled with SHADER_VARIANT defined and
+ * each define set to true or false by its bit, so the shader branches on constants instead of uniforms and
+ * the unused samplers are dropped by the compiler. Variants are built by ShaderLibrary::Default(), named
+ * after the sources and the mask: Submit() starts the known ones ahead, the others are built on first use.
+ */
+class ShaderVariants {
+public:
+    // Define of bit i of the feature masks at index i, 32 at most
+    ShaderVariants(std::string vertexSource, std::string fragmentSource, std::vector<std::string> defines);
+
+    ShaderVariants(const ShaderVariants&) = delete;
+    ShaderVariants& operator=(const ShaderVariants&) = delete;
+
+    // Start building the variant of the mask in the background, e.g. for the materials about to be drawn
+    void Submit(uint32_t featureMask);
+
+    // Program of the features of the mask, finished now if it is still building. Bits without a define are
+    // ignored. Null if the variant fails to build, which the library reports.
+    const ShaderPtr& Get(uint32_t featureMask);
+
+    // Name of the variant of the mask in the library
+    std::string VariantName(uint32_t featureMask) const;
+
+    // Define lines of the variant of the mask
+    std::string DefineBlock(uint32_t featureMask) const;
+
+    inline const std::vector<std::string>& Defines() const { return defines_; }
+    inline size_t VariantCount() const { return variants_.size(); }
+
+private:
+    std::string vertexSource_;
+    std::string fragmentSource_;
+    std::vector<std::string> defines_;
+    uint32_t validMask_ = 0;
+    uint64_t sourceHash_ = 0;
+
+    std::unordered_map<uint32_t, ShaderPtr> variants_;      // finished variants
+};
+
+using ShaderVariantsPtr = std::shared_ptr<ShaderVariants>;
+
+} // namespace vivid
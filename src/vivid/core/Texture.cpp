@@ -1,4 +1,6 @@
 #include "Texture.h"
+#include "GLContext.h"
+#include "GLStateCache.h"
 
 namespace vivid {
 
@@ -11,7 +13,7 @@ Texture::Texture(unsigned char *data, int width, int height, int channels,
     glGenTextures(1, &textureHandle_);
 
     // Bind
-    glBindTexture(GL_TEXTURE_2D, textureHandle_);
+    GLStateCache::Instance().BindTexture(GL_TEXTURE_2D, textureHandle_);
 
     // Upload the image data to GPU
     if (channels == 4) {
@@ -35,15 +37,22 @@ Texture::Texture(unsigned char *data, int width, int height, int channels,
  }
 
 
+Texture::~Texture() {
+    if (textureHandle_ && GLContext::IsAlive()) {
+        GLStateCache::Instance().ForgetTexture(textureHandle_);
+        glDeleteTextures(1, &textureHandle_);
+    }
+}
+
+
  void Texture::Bind() const {
-    glBindTexture(GL_TEXTURE_2D, textureHandle_);
+    GLStateCache::Instance().BindTexture(GL_TEXTURE_2D, textureHandle_);
 }
 
 
 void Texture::Update(unsigned char *data) {
-    glBindTexture(GL_TEXTURE_2D, textureHandle_);
+    GLStateCache::Instance().BindTexture(GL_TEXTURE_2D, textureHandle_);
     glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width_, height_, GL_RGBA, GL_UNSIGNED_BYTE, data);
-    glBindTexture(GL_TEXTURE_2D, 0);
 }
 
 
@@ -19,6 +19,11 @@ public:
             int minFilter = GL_LINEAR,
             int magFilter = GL_LINEAR);
 
+    ~Texture();
+
+    Texture(const Texture&) = delete;
+    Texture& operator=(const Texture&) = delete;
+
     void Bind() const;
 
     void Update(unsigned char *data);
@@ -1,3 +1,4 @@
+#include <atomic>
 #include "vivid/core/Transform.h"
 
 namespace vivid {
@@ -12,7 +13,7 @@ Transform::Transform(const Eigen::Matrix4d &T) {
 
 void Transform::SetIdentity() {
     mat_.setIdentity();
-    q_.setIdentity();
+    Touch();
 }
 
 void Transform::Set(const Transform &tf) {
@@ -21,20 +22,17 @@ void Transform::Set(const Transform &tf) {
 
 void Transform::SetMatrix(const Eigen::Matrix4d &T) {
     mat_ = T;
-    UpdateQuat();
+    Touch();
 }
 
 void Transform::SetRotation(const Eigen::Matrix3d &R) {
     mat_.topLeftCorner(3, 3) = R;
-    UpdateQuat();
+    Touch();
 }
 
 void Transform::SetPosition(const Eigen::Vector3d &p) {
     mat_.topRightCorner(3, 1) = p;
-}
-
-Eigen::Matrix4d Transform::Matrix() const {
-    return mat_;
+    Touch();
 }
 
 Eigen::Matrix3d Transform::Rotation() const {
@@ -46,20 +44,61 @@ Eigen::Vector3d Transform::Position() const {
 }
 
 Eigen::Quaterniond Transform::Quaternion() const {
+    if (!(cached_ & kQuaternion)) {
+        q_ = Eigen::Quaterniond(Eigen::Matrix3d(mat_.topLeftCorner(3, 3)));
+        cached_ |= kQuaternion;
+    }
     return q_;
 }
 
+const Eigen::Matrix4f& Transform::MatrixF() const {
+    if (!(cached_ & kMatrixF)) {
+        matF_ = mat_.cast<float>();
+        cached_ |= kMatrixF;
+    }
+    return matF_;
+}
+
+bool Transform::IsRigid() const {
+    if (!(cached_ & kRigidity)) {
+        const Eigen::Matrix3d R = mat_.topLeftCorner(3, 3);
+        const double error = (R.transpose() * R - Eigen::Matrix3d::Identity()).cwiseAbs().maxCoeff();
+        rigid_ = error < 1e-6 && mat_.row(3) == Eigen::RowVector4d(0, 0, 0, 1);
+        cached_ |= kRigidity;
+    }
+    return rigid_;
+}
+
+Eigen::Matrix4d Transform::InverseMatrix() const {
+    if (IsRigid()) {
+        return InverseRigid().mat_;
+    }
+    return mat_.inverse();
+}
+
 Transform Transform::Inverse() const {
-    return Transform(mat_.inverse());
+    return Transform(InverseMatrix());
+}
+
+Transform Transform::InverseRigid() const {
+    const Eigen::Matrix3d Rt = mat_.topLeftCorner(3, 3).transpose();
+    Transform inverse;
+    inverse.mat_.topLeftCorner(3, 3) = Rt;
+    inverse.mat_.topRightCorner(3, 1) = -Rt * mat_.topRightCorner(3, 1);
+    // Known without checking
+    inverse.rigid_ = true;
+    inverse.cached_ = kRigidity;
+    return inverse;
 }
 
 Transform Transform::operator*(const Transform &otherTf) const {
     return Transform(mat_ * otherTf.Matrix());
 }
 
-void Transform::UpdateQuat() {
-    const Eigen::Matrix3d& R = mat_.topLeftCorner(3, 3);
-    q_ = Eigen::Quaterniond(R);
+void Transform::Touch() {
+    static std::atomic<uint64_t> counter(0);
+    stamp_ = ++counter;
+    cached_ = 0;
 }
 
 
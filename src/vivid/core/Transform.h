@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <Eigen/Dense>
 
 namespace vivid {
@@ -18,22 +19,52 @@ public:
     void SetRotation(const Eigen::Matrix3d &R);
     void SetPosition(const Eigen::Vector3d& p);
 
-    Eigen::Matrix4d Matrix() const;
+    inline const Eigen::Matrix4d& Matrix() const { return mat_; }
     Eigen::Matrix3d Rotation() const;
     Eigen::Vector3d Position() const;
+
+    // Computed on first use after a change
     Eigen::Quaterniond Quaternion() const;
 
+    // Single precision copy of the matrix, converted on first use after a change
+    const Eigen::Matrix4f& MatrixF() const;
+
+    // True if the rotation part is orthonormal and the last row is (0, 0, 0, 1): no scale, shear or projection.
+    // Computed on first use after a change.
+    bool IsRigid() const;
+
+    // Inverse of the matrix, (R^T, -R^T t) for rigid transforms and a general inverse otherwise
+    Eigen::Matrix4d InverseMatrix() const;
     Transform Inverse() const;
 
+    // Inverse of a transform known to be rigid, without checking it
+    Transform InverseRigid() const;
+
     Transform operator* (const Transform& otherTf) const;
 
     void Rotate(const Eigen::Vector3d &axis, double angle);
 
+    // Changes on every modification, and is unique among all transforms: a copy keeps the stamp of its
+    // source, so comparing stamps tells whether a transform differs from the one seen before.
+    inline uint64_t Stamp() const { return stamp_; }
+
 private:
-    void UpdateQuat();
+    // Invalidate the cached values and take a new stamp
+    void Touch();
 
     Eigen::Matrix4d mat_;
-    Eigen::Quaterniond q_;
+    uint64_t stamp_ = 0;
+
+    // Values derived from the matrix, valid if their flag is set in cached_
+    enum CacheFlags : uint8_t {
+        kQuaternion = 1 << 0,
+        kMatrixF = 1 << 1,
+        kRigidity = 1 << 2
+    };
+    mutable uint8_t cached_ = 0;
+    mutable bool rigid_ = true;
+    mutable Eigen::Quaterniond q_;
+    mutable Eigen::Matrix4f matF_;
 };
 
 } // namespace vivid
\ No newline at end of file
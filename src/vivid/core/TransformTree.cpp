@@ -0,0 +1,136 @@
+#include <algorithm>
+#include <atomic>
+#include "vivid/core/TransformTree.h"
+#include "vivid/utils/Parallel.h"
+
+namespace vivid {
+
+// Trees with fewer nodes are updated on the calling thread
+static constexpr size_t kParallelNodeCount = 4096;
+// Approximate number of nodes updated per job
+static constexpr size_t kNodesPerJob = 1024;
+
+TransformTree::TransformTree(Object3D *root, bool includeRoot) {
+    SetRoot(root, includeRoot);
+}
+
+
+void TransformTree::SetRoot(Object3D *root, bool includeRoot) {
+    root_ = root;
+    includeRoot_ = includeRoot;
+    built_ = false;
+}
+
+
+void TransformTree::Rebuild() {
+    nodes_.clear();
+    parents_.clear();
+    subtreeEnds_.clear();
+    subtrees_.clear();
+    hierarchyVersion_ = Object3D::HierarchyVersion();
+    built_ = true;
+    if (root_ == nullptr) {
+        worldMatrices_.clear();
+        stamps_.clear();
+        dirty_.clear();
+        return;
+    }
+
+    // Iterative depth-first traversal, children are pushed in reverse to keep their order.
+    // A null entry closes the subtree of the node it refers to.
+    std::vector<std::pair<Object3D*, int>> stack;
+    if (includeRoot_) {
+        stack.emplace_back(root_, -1);
+    } else {
+        const auto &roots = root_->GetChildren();
+        for (auto it = roots.rbegin(); it != roots.rend(); ++it) {
+            stack.emplace_back(it->get(), -1);
+        }
+    }
+    while (!stack.empty()) {
+        Object3D *node = stack.back().first;
+        const int parent = stack.back().second;
+        stack.pop_back();
+        if (node == nullptr) {
+            // End of the subtree of node `parent`
+            subtreeEnds_[parent] = nodes_.size();
+            continue;
+        }
+
+        const int index = static_cast<int>(nodes_.size());
+        nodes_.push_back(node);
+        parents_.push_back(parent);
+        subtreeEnds_.push_back(0);
+
+        stack.emplace_back(nullptr, index);
+        const auto &children = node->GetChildren();
+        for (auto it = children.rbegin(); it != children.rend(); ++it) {
+            stack.emplace_back(it->get(), index);
+        }
+    }
+
+    // Independent subtrees: those of the roots, or of the children of the root if there is only one
+    const int top = includeRoot_ && !nodes_.empty() ? 0 : -1;
+    for (size_t i = 0; i < nodes_.size(); ++i) {
+        if (parents_[i] == top) {
+            subtrees_.push_back(i);
+        }
+    }
+
+    // Everything is recomputed on the next update
+    worldMatrices_.assign(nodes_.size(), Eigen::Matrix4d::Identity());
+    stamps_.assign(nodes_.size(), 0);
+    dirty_.assign(nodes_.size(), 0);
+}
+
+
+size_t TransformTree::Update() {
+    if (!built_ || hierarchyVersion_ != Object3D::HierarchyVersion()) {
+        Rebuild();
+    }
+    if (nodes_.empty()) {
+        return 0;
+    }
+
+    // Nodes before the first subtree, i.e. the root if it is included, come first
+    const size_t first = subtrees_.empty() ? nodes_.size() : subtrees_.front();
+    size_t updated = UpdateRange(0, first);
+    if (nodes_.size() < kParallelNodeCount) {
+        return updated + UpdateRange(first, nodes_.size());
+    }
+
+    // Subtrees are independent, they are updated in parallel
+    std::atomic<size_t> parallelUpdated(0);
+    const size_t grainSize = std::max<size_t>(1, subtrees_.size() * kNodesPerJob / nodes_.size());
+    ParallelFor(0, subtrees_.size(), grainSize, [&](size_t begin, size_t end) {
+        parallelUpdated += UpdateRange(subtrees_[begin], subtreeEnds_[subtrees_[end - 1]]);
+    });
+    return updated + parallelUpdated.load();
+}
+
+
+size_t TransformTree::UpdateRange(size_t begin, size_t end) {
+    size_t updated = 0;
+    for (size_t i = begin; i < end; ++i) {
+        Object3D *node = nodes_[i];
+        const int parent = parents_[i];
+        const Transform &tf = parent < 0 ? node->GetTransform() : node->GetLocalTransform();
+        const bool dirty = tf.Stamp() != stamps_[i] || (parent >= 0 && dirty_[parent]);
+        dirty_[i] = dirty;
+        if (!dirty) {
+            continue;
+        }
+
+        stamps_[i] = tf.Stamp();
+        if (parent < 0) {
+            worldMatrices_[i] = tf.Matrix();
+        } else {
+            worldMatrices_[i] = worldMatrices_[parent] * tf.Matrix();
+            node->GetTransform().SetMatrix(worldMatrices_[i]);
+        }
+        updated++;
+    }
+    return updated;
+}
+
+} // namespace vivid
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <iostream>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <Eigen/Dense>
+#include <Eigen/StdVector>
+#include "vivid/core/Object3D.h"
+
+namespace vivid {
+
+/* Flattened object hierarchy that composes local transforms into world transforms.
+ *
+ * The hierarchy under a root is stored in depth-first order, so a parent always precedes its children and
+ * a single forward pass updates the whole tree. Only nodes whose transform changed since the last update,
+ * and their descendants, are recomputed; the results are stored in a contiguous array and written back to
+ * the world transform of the objects. The tree is rebuilt when objects are added or removed. Independent
+ * subtrees of large trees are updated in parallel.
+ */
+class TransformTree {
+public:
+    TransformTree() = default;
+
+    explicit TransformTree(Object3D *root, bool includeRoot = true);
+
+    // The root is placed with its world transform, it must outlive the tree. If `includeRoot` is false,
+    // the root is only a container: its children are the roots of the tree, placed with their world
+    // transform, e.g. the objects of a scene.
+    void SetRoot(Object3D *root, bool includeRoot = true);
+    inline Object3D* GetRoot() const { return root_; }
+
+    // Recompute the world transforms that are out of date. Return the number of recomputed nodes.
+    size_t Update();
+
+    // Number of nodes, the root included unless it is a container
+    inline size_t Size() const { return nodes_.size(); }
+
+    // Nodes in depth-first order, and the index of their parent (-1 for the roots)
+    inline const std::vector<Object3D*>& Nodes() const { return nodes_; }
+    inline int ParentIndex(size_t i) const { return parents_[i]; }
+
+    // One past the last descendant of node i
+    inline size_t SubtreeEnd(size_t i) const { return subtreeEnds_[i]; }
+
+    // World matrix of node i, valid after Update()
+    inline const Eigen::Matrix4d& WorldMatrix(size_t i) const { return worldMatrices_[i]; }
+
+private:
+    void Rebuild();
+
+    // Update the nodes [begin, end), which must contain the parents of their nodes or be preceded by them
+    size_t UpdateRange(size_t begin, size_t end);
+
+    Object3D *root_ = nullptr;
+    bool includeRoot_ = true;
+    unsigned int hierarchyVersion_ = 0;
+    bool built_ = false;
+
+    std::vector<Object3D*> nodes_;
+    std::vector<int> parents_;
+    std::vector<size_t> subtreeEnds_;
+    std::vector<size_t> subtrees_;      // first node of the subtrees updated in parallel, in order
+    std::vector<Eigen::Matrix4d, Eigen::aligned_allocator<Eigen::Matrix4d>> worldMatrices_;
+
+    // Stamp of the transform each world matrix was computed from: the world transform of the root,
+    // the local transform of the other nodes.
+    std::vector<uint64_t> stamps_;
+    std::vector<uint8_t> dirty_;
+};
+
+} // namespace vivid
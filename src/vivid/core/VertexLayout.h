@@ -0,0 +1,77 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include "Attribute.h"
+
+namespace vivid {
+
+/* Compact description of the vertex inputs: which attribute types are used, at which shader locations and
+ * in which formats. A shader fills the locations, a geometry adds the formats of its attributes, and the
+ * 64-bit hash of the result identifies a vertex array object without any string manipulation.
+ */
+class VertexLayout {
+public:
+    VertexLayout() {
+        locations_.fill(-1);
+        formats_.fill(0);
+    }
+
+    // Bit i is set if the attribute type i is used
+    inline uint32_t Mask() const { return mask_; }
+
+    inline bool Has(AttributeType type) const { return (mask_ >> type) & 1u; }
+
+    // Shader location of an attribute type, -1 if unused
+    inline int Location(AttributeType type) const { return locations_[type]; }
+
+    inline void SetLocation(AttributeType type, int location) {
+        locations_[type] = static_cast<int8_t>(location);
+        if (location >= 0) {
+            mask_ |= 1u << type;
+        } else {
+            mask_ &= ~(1u << type);
+        }
+        hash_ = 0;
+    }
+
+    // Pack the storage format of an attribute in a byte:
+    // component type (3 bits) | elements per item - 1 (2 bits) | normalized (1 bit)
+    inline void SetFormat(AttributeType type, const Attribute &attr) {
+        formats_[type] = static_cast<uint8_t>(static_cast<int>(attr.GetComponentType())
+                                              | ((attr.ElementsPerItem() - 1) & 3) << 3
+                                              | (attr.Normalized() ? 1 : 0) << 5);
+        hash_ = 0;
+    }
+
+    // FNV-1a over the mask, locations and formats, computed once after a change.
+    inline uint64_t Hash() const {
+        if (hash_ == 0) {
+            uint64_t h = 14695981039346656037ull;
+            auto mix = [&h](uint32_t v) {
+                h ^= v;
+                h *= 1099511628211ull;
+            };
+            mix(mask_);
+            for (int i = 0; i < kAttribNum; ++i) {
+                if (Has(static_cast<AttributeType>(i))) {
+                    mix(static_cast<uint8_t>(locations_[i]) | static_cast<uint32_t>(formats_[i]) << 8);
+                }
+            }
+            hash_ = h != 0 ? h : 1;
+        }
+        return hash_;
+    }
+
+    inline bool operator==(const VertexLayout &other) const {
+        return mask_ == other.mask_ && locations_ == other.locations_ && formats_ == other.formats_;
+    }
+
+private:
+    uint32_t mask_ = 0;
+    std::array<int8_t, kAttribNum> locations_;
+    std::array<uint8_t, kAttribNum> formats_;
+    mutable uint64_t hash_ = 0;
+};
+
+} // namespace vivid
@@ -1,4 +1,6 @@
 #include "FrameBuffer.h"
+#include "vivid/core/GLContext.h"
+#include "vivid/core/GLStateCache.h"
 
 namespace vivid {
 
@@ -17,6 +19,20 @@ FrameBuffer::FrameBuffer(int width, int height, bool colorFlag, bool depthFlag)
 }
 
 
+FrameBuffer::~FrameBuffer() {
+    if (!GLContext::IsAlive()) {
+        return;
+    }
+    GLStateCache &gl = GLStateCache::Instance();
+    gl.ForgetTexture(colorTextureHandle_);
+    gl.ForgetTexture(depthTextureHandle_);
+    gl.ForgetFramebuffer(frameBufferHandle_);
+    glDeleteTextures(1, &colorTextureHandle_);
+    glDeleteTextures(1, &depthTextureHandle_);
+    glDeleteFramebuffers(1, &frameBufferHandle_);
+}
+
+
 bool FrameBuffer::Check() {
     Bind();
     return glCheckFramebufferStatus(GL_FRAMEBUFFER)
@@ -30,7 +46,7 @@ void FrameBuffer::CreateColorTexture() {
     // Create color texture.
     colorTextureHandle_ = 0;
     glGenTextures(1, &colorTextureHandle_);
-    glBindTexture(GL_TEXTURE_2D, colorTextureHandle_);
+    GLStateCache::Instance().BindTexture(GL_TEXTURE_2D, colorTextureHandle_);
     // give an empty image to opengl.
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, (GLsizei)width_, (GLsizei)height_, 0, GL_RGB, GL_UNSIGNED_BYTE, 0);
 
@@ -53,7 +69,7 @@ void FrameBuffer::CreateDepthTexture() {
     // Create depth texture. Slower than a depth buffer, but you can sample it later in your shader
     depthTextureHandle_ = 0;
     glGenTextures(1, &depthTextureHandle_);
-    glBindTexture(GL_TEXTURE_2D, depthTextureHandle_);
+    GLStateCache::Instance().BindTexture(GL_TEXTURE_2D, depthTextureHandle_);
     glTexImage2D(GL_TEXTURE_2D, 0,GL_DEPTH_COMPONENT, (GLsizei)width_, (GLsizei)height_, 0,GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
@@ -83,12 +99,12 @@ void FrameBuffer::SetupDrawables() {
 
 
 void FrameBuffer::Bind() {
-    glBindFramebuffer(GL_FRAMEBUFFER, frameBufferHandle_);
+    GLStateCache::Instance().BindFramebuffer(GL_FRAMEBUFFER, frameBufferHandle_);
 }
 
 
 void FrameBuffer::Unbind() {
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    GLStateCache::Instance().BindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
 
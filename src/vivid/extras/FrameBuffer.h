@@ -9,6 +9,11 @@ class FrameBuffer {
 public:
     FrameBuffer(int width, int height, bool colorFlag = false, bool depthFlag = false);
 
+    ~FrameBuffer();
+
+    FrameBuffer(const FrameBuffer&) = delete;
+    FrameBuffer& operator=(const FrameBuffer&) = delete;
+
     bool Check();
 
     void Bind();
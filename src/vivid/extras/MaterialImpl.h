@@ -3,16 +3,25 @@
 #include <iostream>
 #include <glm/glm.hpp>
 #include <utility>
+#include "vivid/core/GLStateCache.h"
 #include "vivid/core/Material.h"
 #include "vivid/core/Texture.h"
 #include "vivid/core/Shader.h"
+#include "vivid/extras/ShaderImpl.h"
 
 namespace vivid {
 
 class BasicColorMaterial : public Material {
 public:
+    // Feature bits, in the order of the defines of ShaderImpl::GetColoredBasicVariants()
+    enum Feature : uint32_t {
+        kColorMap = 1u << 0,
+    };
+
     BasicColorMaterial(const glm::vec3 &color, TexturePtr colorTex = nullptr)
-        : Material(), color_(color), colorTexture_(std::move(colorTex)) {}
+        : Material(), color_(color), colorTexture_(std::move(colorTex)) {
+        variants_ = ShaderImpl::GetColoredBasicVariants();
+    }
 
     void SetColor(const glm::vec3& color) {
         color_ = color;
@@ -30,15 +39,26 @@ public:
         return colorTexture_;
     }
 
+    unsigned int TextureKey() const override {
+        return colorTexture_ ? colorTexture_->GetHandle() : 0;
+    }
+
+    uint32_t FeatureMask() const override {
+        return colorTexture_ ? kColorMap : 0u;
+    }
+
     void SetUniforms(const ShaderPtr& shader) override {
-        shader->SetVec3("uColor", color_);
+        static const UniformHandle kColor("uColor");
+        static const UniformHandle kColorMapUniform("uColorMap");
+        static const UniformHandle kHasColorMap("uHasColorMap");
+
+        shader->SetVec3(kColor, color_);
         if (colorTexture_) {
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, colorTexture_->GetHandle());
-            shader->SetInt("uColorMap", 0);
-            shader->SetBool("uHasColorMap", true);
+            GLStateCache::Instance().BindTexture(0, GL_TEXTURE_2D, colorTexture_->GetHandle());
+            shader->SetInt(kColorMapUniform, 0);
+            shader->SetBool(kHasColorMap, true);
         } else {
-            shader->SetBool("uHasColorMap", false);
+            shader->SetBool(kHasColorMap, false);
         }
     }
 
@@ -62,7 +82,9 @@ public:
     }
 
     void SetUniforms(const ShaderPtr &shader) override {
-        shader->SetFloat("uPointSize", pointSize_);
+        static const UniformHandle kPointSize("uPointSize");
+
+        shader->SetFloat(kPointSize, pointSize_);
     }
 
 private:
@@ -72,6 +94,13 @@ private:
 
 class PhongMaterial : public Material {
 public:
+    // Feature bits, in the order of the defines of ShaderImpl::GetBlinnPhongVariants()
+    enum Feature : uint32_t {
+        kDiffuseMap = 1u << 0,
+        kSpecularMap = 1u << 1,
+        kNormalMap = 1u << 2,
+    };
+
     PhongMaterial(const glm::vec3 &diffuseColor,
                   const glm::vec3 &specularColor,
                   float shininess = 5.0f,
@@ -84,7 +113,9 @@ public:
           shininess_(shininess),
           diffuseTexture_(std::move(diffuseTex)),
           specularTexture_(std::move(specularTex)),
-          normalTexture_(std::move(normalTex)) {}
+          normalTexture_(std::move(normalTex)) {
+        variants_ = ShaderImpl::GetBlinnPhongVariants();
+    }
 
     void SetDiffuseColor(const glm::vec3& color) {
         diffuseColor_ = color;
@@ -126,36 +157,53 @@ public:
         return specularTexture_;
     }
 
+    unsigned int TextureKey() const override {
+        return diffuseTexture_ ? diffuseTexture_->GetHandle() : 0;
+    }
+
+    uint32_t FeatureMask() const override {
+        return (diffuseTexture_ ? kDiffuseMap : 0u)
+               | (specularTexture_ ? kSpecularMap : 0u)
+               | (normalTexture_ ? kNormalMap : 0u);
+    }
+
     void SetUniforms(const ShaderPtr &shader) override {
-        shader->SetVec3("uDiffuseColor", diffuseColor_);
-        shader->SetVec3("uSpecularColor", specularColor_);
-        shader->SetFloat("uShininess", shininess_);
+        static const UniformHandle kDiffuseColor("uDiffuseColor");
+        static const UniformHandle kSpecularColor("uSpecularColor");
+        static const UniformHandle kShininess("uShininess");
+        static const UniformHandle kDiffuseMapUniform("uDiffuseMap");
+        static const UniformHandle kHasDiffuseMap("uHasDiffuseMap");
+        static const UniformHandle kSpecularMapUniform("uSpecularMap");
+        static const UniformHandle kHasSpecularMap("uHasSpecularMap");
+        static const UniformHandle kNormalMapUniform("uNormalMap");
+        static const UniformHandle kHasNormalMap("uHasNormalMap");
+
+        shader->SetVec3(kDiffuseColor, diffuseColor_);
+        shader->SetVec3(kSpecularColor, specularColor_);
+        shader->SetFloat(kShininess, shininess_);
 
         if (diffuseTexture_) {
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, diffuseTexture_->GetHandle());
-            shader->SetInt("uDiffuseMap", 0);
-            shader->SetBool("uHasDiffuseMap", true);
+            GLStateCache::Instance().BindTexture(0, GL_TEXTURE_2D, diffuseTexture_->GetHandle());
+            shader->SetInt(kDiffuseMapUniform, 0);
+            shader->SetBool(kHasDiffuseMap, true);
         } else {
-            shader->SetBool("uHasDiffuseMap", false);
+            shader->SetBool(kHasDiffuseMap, false);
         }
 
         if (specularTexture_) {
-            glActiveTexture(GL_TEXTURE1);
-            glBindTexture(GL_TEXTURE_2D, specularTexture_->GetHandle());
-            shader->SetInt("uSpecularMap", 1);
-            shader->SetBool("uHasSpecularMap", true);
+            GLStateCache::Instance().BindTexture(1, GL_TEXTURE_2D, specularTexture_->GetHandle());
+            shader->SetInt(kSpecularMapUniform, 1);
+            shader->SetBool(kHasSpecularMap, true);
         } else {
-            shader->SetBool("uHasSpecularMap", false);
+            shader->SetBool(kHasSpecularMap, false);
         }
 
         if (normalTexture_) {
-            glActiveTexture(GL_TEXTURE2);
-            glBindTexture(GL_TEXTURE_2D, normalTexture_->GetHandle());
-            shader->SetInt("uNormalMap", 2);
-            shader->SetBool("uHasNormalMap", true);
+            GLStateCache::Instance().BindTexture(2, GL_TEXTURE_2D, normalTexture_->GetHandle());
+            shader->SetInt(kNormalMapUniform, 2);
+            shader->SetBool(kHasNormalMap, true);
         } else {
-            shader->SetBool("uHasNormalMap", false);
+            shader->SetBool(kHasNormalMap, false);
         }
     }
 
@@ -172,6 +220,15 @@ private:
 
 class PbrMaterial : public Material {
 public:
+    // Feature bits, in the order of the defines of ShaderImpl::GetPBRVariants()
+    enum Feature : uint32_t {
+        kBaseColorMap = 1u << 0,
+        kRmoMap = 1u << 1,
+        kOpacityMap = 1u << 2,
+        kEmissiveMap = 1u << 3,
+        kImageBasedLighting = 1u << 4,
+    };
+
     PbrMaterial(const glm::vec3 &baseColor,
                 float roughness = 0.5f,
                 float metalness = 0.0f,
@@ -186,7 +243,9 @@ public:
           baseColorTexture_(std::move(baseColorTex)),
           rmoTexture_(std::move(rmoTex)),
           opacityTexture_(std::move(opacityTex)),
-          emissiveTexture(std::move(emissiveTex)) {}
+          emissiveTexture(std::move(emissiveTex)) {
+        variants_ = ShaderImpl::GetPBRVariants();
+    }
 
     void SetBaseColor(const glm::vec3& color) {
         baseColor_ = color;
@@ -216,45 +275,75 @@ public:
         emissiveTexture = tex;
     }
 
+    // Select the variant with environment lighting. The generic PBR shader reads uEnableIBL instead, and
+    // the environment maps are bound by the application in both cases.
+    void SetImageBasedLighting(bool enable) {
+        imageBasedLighting_ = enable;
+    }
+
+    bool GetImageBasedLighting() const {
+        return imageBasedLighting_;
+    }
+
+    unsigned int TextureKey() const override {
+        return baseColorTexture_ ? baseColorTexture_->GetHandle() : 0;
+    }
+
+    uint32_t FeatureMask() const override {
+        return (baseColorTexture_ ? kBaseColorMap : 0u)
+               | (rmoTexture_ ? kRmoMap : 0u)
+               | (opacityTexture_ ? kOpacityMap : 0u)
+               | (emissiveTexture ? kEmissiveMap : 0u)
+               | (imageBasedLighting_ ? kImageBasedLighting : 0u);
+    }
+
     void SetUniforms(const ShaderPtr &shader) override {
-        shader->SetVec3("uBaseColor", baseColor_);
-        shader->SetFloat("uRoughness", roughness_);
-        shader->SetFloat("uMetalness", metalness_);
+        static const UniformHandle kBaseColor("uBaseColor");
+        static const UniformHandle kRoughness("uRoughness");
+        static const UniformHandle kMetalness("uMetalness");
+        static const UniformHandle kBaseColorMapUniform("uBaseColorMap");
+        static const UniformHandle kHasBaseColorMap("uHasBaseColorMap");
+        static const UniformHandle kRmoMapUniform("uRmoMap");
+        static const UniformHandle kHasRmoMap("uHasRmoMap");
+        static const UniformHandle kOpacityMapUniform("uOpacityMap");
+        static const UniformHandle kHasOpacityMap("uHasOpacityMap");
+        static const UniformHandle kEmissiveMapUniform("uEmissiveMap");
+        static const UniformHandle kHasEmissiveMap("uHasEmissiveMap");
+
+        shader->SetVec3(kBaseColor, baseColor_);
+        shader->SetFloat(kRoughness, roughness_);
+        shader->SetFloat(kMetalness, metalness_);
 
         if (baseColorTexture_) {
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, baseColorTexture_->GetHandle());
-            shader->SetInt("uBaseColorMap", 0);
-            shader->SetBool("uHasBaseColorMap", true);
+            GLStateCache::Instance().BindTexture(0, GL_TEXTURE_2D, baseColorTexture_->GetHandle());
+            shader->SetInt(kBaseColorMapUniform, 0);
+            shader->SetBool(kHasBaseColorMap, true);
         } else {
-            shader->SetBool("uHasBaseColorMap", false);
+            shader->SetBool(kHasBaseColorMap, false);
         }
 
         if (rmoTexture_) {
-            glActiveTexture(GL_TEXTURE1);
-            glBindTexture(GL_TEXTURE_2D, rmoTexture_->GetHandle());
-            shader->SetInt("uRmoMap", 1);
-            shader->SetBool("uHasRmoMap", true);
+            GLStateCache::Instance().BindTexture(1, GL_TEXTURE_2D, rmoTexture_->GetHandle());
+            shader->SetInt(kRmoMapUniform, 1);
+            shader->SetBool(kHasRmoMap, true);
         } else {
-            shader->SetBool("uHasRmoMap", false);
+            shader->SetBool(kHasRmoMap, false);
         }
 
         if (opacityTexture_) {
-            glActiveTexture(GL_TEXTURE2);
-            glBindTexture(GL_TEXTURE_2D, opacityTexture_->GetHandle());
-            shader->SetInt("uOpacityMap", 2);
-            shader->SetBool("uHasOpacityMap", true);
+            GLStateCache::Instance().BindTexture(2, GL_TEXTURE_2D, opacityTexture_->GetHandle());
+            shader->SetInt(kOpacityMapUniform, 2);
+            shader->SetBool(kHasOpacityMap, true);
         } else {
-            shader->SetBool("uHasOpacityMap", false);
+            shader->SetBool(kHasOpacityMap, false);
         }
 
         if (emissiveTexture) {
-            glActiveTexture(GL_TEXTURE3);
-            glBindTexture(GL_TEXTURE_2D, emissiveTexture->GetHandle());
-            shader->SetInt("uEmissiveMap", 3);
-            shader->SetBool("uHasEmissiveMap", true);
+            GLStateCache::Instance().BindTexture(3, GL_TEXTURE_2D, emissiveTexture->GetHandle());
+            shader->SetInt(kEmissiveMapUniform, 3);
+            shader->SetBool(kHasEmissiveMap, true);
         } else {
-            shader->SetBool("uHasEmissiveMap", false);
+            shader->SetBool(kHasEmissiveMap, false);
         }
     }
 
@@ -267,6 +356,7 @@ private:
     TexturePtr rmoTexture_; // pack roughness, metallic, occlusion into one texture
     TexturePtr opacityTexture_;
     TexturePtr emissiveTexture;
+    bool imageBasedLighting_ = false;
 };
 
 
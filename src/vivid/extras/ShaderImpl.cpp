@@ -1,6 +1,8 @@
 #include <memory>
 #include <string>
 #include <fstream>
+#include <vector>
+#include "vivid/core/ShaderLibrary.h"
 #include "vivid/extras/ShaderImpl.h"
 
 
@@ -9,20 +11,21 @@ namespace vivid {
 // ============= vertex colored shader =============
 const std::string vertex_colored_vs = R"(
 #version 330 core
+#include <frame_uniforms>
 
 // input
 layout(location = 0) in vec3 position;
 layout(location = 1) in vec3 color;
 
 // uniforms
-uniform mat4 MVP;
+uniform mat4 modelMatrix;
 uniform float uPointSize = 1.0; // for rendering points
 
 // output
 out vec3 fragColor;
 
 void main() {
-    gl_Position = MVP * vec4(position, 1.0);
+    gl_Position = uFrame.viewProjectionMatrix * modelMatrix * vec4(position, 1.0);
     gl_PointSize = uPointSize;
     fragColor = color;
 }
@@ -50,25 +53,27 @@ void main() {
 // ============= colored basic shader =============
 const std::string colored_basic_vs = R"(
 #version 330 core
+#include <frame_uniforms>
 
 // input
 layout(location = 0) in vec3 position;
 layout(location = 1) in vec2 texCoord0;
 
 // uniforms
-uniform mat4 MVP;
+uniform mat4 modelMatrix;
 
 // output
 out vec2 vUv;
 
 void main() {
-    gl_Position = MVP * vec4(position, 1.0);
+    gl_Position = uFrame.viewProjectionMatrix * modelMatrix * vec4(position, 1.0);
     vUv = texCoord0;
 }
 )";
 
 const std::string colored_basic_fs = R"(
 #version 330 core
+#include <features>
 
 // input
 in vec2 vUv;
@@ -76,7 +81,7 @@ in vec2 vUv;
 // uniforms
 uniform vec3 uColor = vec3(1.0, 1.0, 1.0);
 uniform sampler2D uColorMap;
-uniform bool uHasColorMap = false;
+FEATURE(uHasColorMap, HAS_COLOR_MAP);
 
 // output
 out vec3 color;
@@ -96,6 +101,7 @@ void main() {
 // ============= basic shading shader ===================
 const std::string basic_shading_vs = R"(
 #version 330 core
+#include <frame_uniforms>
 
 // Input vertex data
 layout (location = 0) in vec3 position;
@@ -107,14 +113,14 @@ out vec2 vUv;
 out vec3 vNormal;   // normal vector in camera space
 
 // Uniforms
-uniform mat4 MVP;
+uniform mat4 modelMatrix;
 uniform mat3 normalMatrix;  // inverse transpose of modelview matrix, for transforming normals from object space to camera space
 
 
 void main() {
     vUv = texCoord0;
     vNormal = normalize(normalMatrix * normal);
-    gl_Position = MVP * vec4(position, 1.0);
+    gl_Position = uFrame.viewProjectionMatrix * modelMatrix * vec4(position, 1.0);
 }
 )";
 
@@ -150,6 +156,7 @@ void main() {
 // ============= colored blinn phong shader =============
 const std::string blinn_phong_vs = R"(
 #version 330 core
+#include <frame_uniforms>
 
 // input
 layout(location = 0) in vec3 position;
@@ -162,19 +169,18 @@ out vec3 vPositionC;    // fragment position in camera space
 out vec2 vUv;
 
 // Uniforms
-uniform mat4 MVP;
+uniform mat4 modelMatrix;
 uniform mat3 normalMatrix; // convert normal from model space to camera space
-uniform mat4 modelViewMatrix;
 
 void main() {
     // Output position of the vertex, in clip space.
-    gl_Position = MVP * vec4(position, 1);
+    gl_Position = uFrame.viewProjectionMatrix * modelMatrix * vec4(position, 1);
 
     // normal in the camera space
     vNormalC = normalize(normalMatrix * normal);
 
     // position in the camera space
-    vPositionC = (modelViewMatrix * vec4(position, 1)).xyz;
+    vPositionC = (uFrame.viewMatrix * modelMatrix * vec4(position, 1)).xyz;
 
     vUv = texCoord0;
 }
@@ -183,6 +189,7 @@ void main() {
 
 const std::string blinn_phong_fs = R"(
 #version 330 core
+#include <features>
 
 // Interpolated values from the vertex shaders
 in vec3 vNormalC;       // normal in camera space
@@ -204,13 +211,13 @@ uniform vec3 uSpecularColor;
 uniform float uShininess = 5.0;
 
 uniform sampler2D uDiffuseMap;
-uniform bool uHasDiffuseMap = false;
+FEATURE(uHasDiffuseMap, HAS_DIFFUSE_MAP);
 
 uniform sampler2D uNormalMap;
-uniform bool uHasNormalMap = false;
+FEATURE(uHasNormalMap, HAS_NORMAL_MAP);
 
 uniform sampler2D uSpecularMap;
-uniform bool uHasSpecularMap = false;
+FEATURE(uHasSpecularMap, HAS_SPECULAR_MAP);
 
 uniform Light uLight;
 uniform vec3 uAmbientColor;
@@ -263,6 +270,7 @@ void main() {
 // ============= PBR shader ===============
 const std::string pbr_vs = R"(
 #version 330 core
+#include <frame_uniforms>
 
 // input vertex data
 layout(location = 0) in vec3 position;
@@ -275,7 +283,6 @@ out vec3 vNormalW;   // normal vector in world space
 out vec3 vPosW;      // vertex position in world space
 
 // uniforms
-uniform mat4 MVP;
 uniform mat4 modelMatrix;
 uniform mat3 normalMatrixW;  // inverse transpose of model rotation matrix
 
@@ -288,12 +295,14 @@ void main() {
     // transform vertex position from model space to world space
     vPosW = vec3(modelMatrix * vec4(position, 1.0));
 
-    gl_Position = MVP * vec4(position, 1.0);
+    gl_Position = uFrame.viewProjectionMatrix * modelMatrix * vec4(position, 1.0);
 }
 )";
 
 const std::string pbr_fs = R"(
 #version 330 core
+#include <frame_uniforms>
+#include <features>
 
 // input data
 in vec2 vUv;
@@ -303,31 +312,28 @@ in vec3 vPosW;      // vertex position in world space
 // output data
 out vec4 fragColor;
 
-// uniform variables
-uniform vec3 uCamPosW;   // camera position in world space
-
 // material properties
 uniform sampler2D uBaseColorMap;
-uniform bool uHasBaseColorMap = false;
+FEATURE(uHasBaseColorMap, HAS_BASE_COLOR_MAP);
 uniform vec3 uBaseColor = vec3(1);
 
 uniform sampler2D uRmoMap;
 uniform float uMetalness = 0.0;
 uniform float uRoughness = 0.5;
 //uniform float uOccusion = 0.0;
-uniform bool uHasRmoMap = false;
+FEATURE(uHasRmoMap, HAS_RMO_MAP);
 
 uniform sampler2D uOpacityMap;
-uniform bool uHasOpacityMap = false;
+FEATURE(uHasOpacityMap, HAS_OPACITY_MAP);
 
 uniform sampler2D uEmissiveMap;
-uniform bool uHasEmissiveMap = false;
+FEATURE(uHasEmissiveMap, HAS_EMISSIVE_MAP);
 
 // envarionment lighting
 uniform sampler2D uEnvIrradianceMap;
 uniform sampler2D uBrdfLutMap;
 uniform sampler2D uEnvSpecularMap;
-uniform bool uEnableIBL = false;
+FEATURE(uEnableIBL, ENABLE_IBL);
 
 // Lights
 #define MAX_LIGHTS 4
@@ -418,7 +424,7 @@ void main() {
 
     // direction vectors
     vec3 N = normalize(vNormalW);              // normal vector
-    vec3 V = normalize(uCamPosW - vPosW);    // view vector
+    vec3 V = normalize(uFrame.cameraPosition.xyz - vPosW);    // view vector
     vec3 R = normalize(reflect(-V, N));                     // specular reflection vector
     float NdV = max(dot(N, V), 0.0);
 
@@ -519,6 +525,7 @@ void main() {
 // ============= ground shader =============
 const std::string ground_vs = R"(
 #version 330 core
+#include <frame_uniforms>
 
 // Input vertex data
 layout (location = 0) in vec3 position;
@@ -530,13 +537,13 @@ out vec2 vUv;
 out vec3 vNormal;   // normal vector in camera space
 
 // Uniforms
-uniform mat4 MVP;
+uniform mat4 modelMatrix;
 uniform mat3 normalMatrix;  // inverse transpose of modelview matrix, for transforming normals from object space to camera space
 
 void main() {
     vUv = texCoord0;
     vNormal = normalize(normalMatrix * normal);
-    gl_Position = MVP * vec4(position, 1.0);
+    gl_Position = uFrame.viewProjectionMatrix * modelMatrix * vec4(position, 1.0);
 }
 )";
 
@@ -565,13 +572,14 @@ void main() {
 
 const std::string depth_vs = R"(
 #version 330 core
+#include <frame_uniforms>
 
 layout(location = 0) in vec3 position;
 
-uniform mat4 MVP;
+uniform mat4 modelMatrix;
 
 void main() {
-    gl_Position = MVP * vec4(position, 1);
+    gl_Position = uFrame.viewProjectionMatrix * modelMatrix * vec4(position, 1);
 }
 )";
 
@@ -590,6 +598,102 @@ void main() {
 
 
 
+// ============= instanced shading shader =============
+// Per-instance transforms and colors read from vertex attributes advanced once per instance
+const std::string instanced_vs = R"(
+#version 330 core
+#include <frame_uniforms>
+
+// Input vertex data
+layout (location = 0) in vec3 position;
+layout (location = 1) in vec3 normal;
+layout (location = 2) in vec2 texCoord0;
+layout (location = 3) in vec4 instanceColor;
+layout (location = 4) in mat4 instanceMatrix;   // locations 4 to 7
+
+// Output data
+out vec2 vUv;
+out vec3 vNormal;   // normal vector in camera space
+out vec3 vColor;
+
+// Uniforms
+uniform mat4 modelMatrix;
+uniform mat3 normalMatrix;
+
+void main() {
+    vUv = texCoord0;
+    // exact for uniformly scaled instances
+    vNormal = normalize(normalMatrix * mat3(instanceMatrix) * normal);
+    vColor = instanceColor.rgb;
+    gl_Position = uFrame.viewProjectionMatrix * modelMatrix * instanceMatrix * vec4(position, 1.0);
+}
+)";
+
+// Per-instance transforms and colors fetched from texture buffers, no attribute location needed
+const std::string instanced_texture_buffer_vs = R"(
+#version 330 core
+#include <frame_uniforms>
+
+// Input vertex data
+layout (location = 0) in vec3 position;
+layout (location = 1) in vec3 normal;
+layout (location = 2) in vec2 texCoord0;
+
+// Output data
+out vec2 vUv;
+out vec3 vNormal;   // normal vector in camera space
+out vec3 vColor;
+
+// Uniforms
+uniform mat4 modelMatrix;
+uniform mat3 normalMatrix;
+uniform samplerBuffer uInstanceMatrices;    // 4 columns per instance
+uniform samplerBuffer uInstanceColors;
+
+void main() {
+    int base = gl_InstanceID * 4;
+    mat4 instanceMatrix = mat4(texelFetch(uInstanceMatrices, base),
+                               texelFetch(uInstanceMatrices, base + 1),
+                               texelFetch(uInstanceMatrices, base + 2),
+                               texelFetch(uInstanceMatrices, base + 3));
+    vUv = texCoord0;
+    vNormal = normalize(normalMatrix * mat3(instanceMatrix) * normal);
+    vColor = texelFetch(uInstanceColors, gl_InstanceID).rgb;
+    gl_Position = uFrame.viewProjectionMatrix * modelMatrix * instanceMatrix * vec4(position, 1.0);
+}
+)";
+
+const std::string instanced_fs = R"(
+#version 330 core
+
+// input values from the vertex shaders
+in vec2 vUv;
+in vec3 vNormal;
+in vec3 vColor;
+
+// output data
+out vec3 color;
+
+// texture
+uniform vec3 uColor = vec3(1.0, 1.0, 1.0);
+uniform sampler2D uColorMap;
+uniform bool uHasColorMap = false;
+
+void main() {
+    vec3 light = vec3(0.5, 0.2, 1.0);
+    vec3 normal = normalize(vNormal);
+    vec3 tex = uColor * vColor;
+    if (uHasColorMap) {
+        tex *= texture(uColorMap, vUv).rgb;
+    }
+    float shading = dot(normal, light) * 0.15;
+    color = tex + shading;
+}
+)";
+
+
+
+
 // ============= 2D screen shader =============
 const std::string screen_shader_vs = R"(
 #version 330 core
@@ -625,43 +729,136 @@ void main() {
 
 
 
+// Built-in programs, by name in the default ShaderLibrary
+namespace {
+struct BuiltinSource {
+    const char *name;
+    const std::string &vertexSource;
+    const std::string &fragmentSource;
+};
+
+enum Builtin {
+    kVertexColored,
+    kColoredBasic,
+    kBasicShading,
+    kBlinnPhong,
+    kPBR,
+    kGround,
+    kDepth,
+    kScreen,
+    kInstanced,
+    kInstancedTextureBuffer,
+    kBuiltinCount,
+};
+
+const BuiltinSource kBuiltinSources[kBuiltinCount] = {
+    {"vertex_colored", vertex_colored_vs, vertex_colored_fs},
+    {"colored_basic", colored_basic_vs, colored_basic_fs},
+    {"basic_shading", basic_shading_vs, basic_shading_fs},
+    {"blinn_phong", blinn_phong_vs, blinn_phong_fs},
+    {"pbr", pbr_vs, pbr_fs},
+    {"ground", ground_vs, ground_fs},
+    {"depth", depth_vs, depth_fs},
+    {"screen", screen_shader_vs, screen_shader_fs},
+    {"instanced", instanced_vs, instanced_fs},
+    {"instanced_texture_buffer", instanced_texture_buffer_vs, instanced_fs},
+};
+
+// Program of a built-in shader, possibly started by ShaderImpl::Precompile(). Null if it fails to build.
+ShaderPtr BuiltinShader(Builtin builtin) {
+    const BuiltinSource &source = kBuiltinSources[builtin];
+    ShaderLibrary &library = ShaderLibrary::Default();
+    if (library.GetStatus(source.name) == ShaderLibrary::Status::kUnknown) {
+        library.Submit(source.name, source.vertexSource, source.fragmentSource);
+    }
+    return library.Get(source.name);
+}
+} // namespace
+
+
+void ShaderImpl::Precompile() {
+    ShaderLibrary &library = ShaderLibrary::Default();
+    for (const BuiltinSource &source : kBuiltinSources) {
+        if (library.GetStatus(source.name) == ShaderLibrary::Status::kUnknown) {
+            library.Submit(source.name, source.vertexSource, source.fragmentSource);
+        }
+    }
+
+    // Variants of the materials without textures
+    GetColoredBasicVariants()->Submit(0);
+    GetBlinnPhongVariants()->Submit(0);
+    GetPBRVariants()->Submit(0);
+}
+
+
 ShaderPtr ShaderImpl::GetVertexColoredShader() {
-    static ShaderPtr shader = std::make_shared<Shader>(vertex_colored_vs.c_str(), vertex_colored_fs.c_str());
+    static ShaderPtr shader = BuiltinShader(kVertexColored);
     return shader;
 }
 
 ShaderPtr ShaderImpl::GetColoredBasicShader() {
-    static ShaderPtr shader = std::make_shared<Shader>(colored_basic_vs.c_str(), colored_basic_fs.c_str());
+    static ShaderPtr shader = BuiltinShader(kColoredBasic);
     return shader;
 }
 
 ShaderPtr ShaderImpl::GetBasicShadingShader() {
-    static ShaderPtr shader = std::make_shared<Shader>(basic_shading_vs.c_str(), basic_shading_fs.c_str());
+    static ShaderPtr shader = BuiltinShader(kBasicShading);
     return shader;
 }
 
 ShaderPtr ShaderImpl::GetBlinnPhongShader() {
-    static ShaderPtr shader = std::make_shared<Shader>(blinn_phong_vs.c_str(), blinn_phong_fs.c_str());
+    static ShaderPtr shader = BuiltinShader(kBlinnPhong);
     return shader;
 }
 
 ShaderPtr ShaderImpl::GetPBRShader() {
-    static ShaderPtr shader = std::make_shared<Shader>(pbr_vs.c_str(), pbr_fs.c_str());
+    static ShaderPtr shader = BuiltinShader(kPBR);
     return shader;
 }
 
+ShaderVariantsPtr ShaderImpl::GetColoredBasicVariants() {
+    static auto variants = std::make_shared<ShaderVariants>(
+        colored_basic_vs, colored_basic_fs, std::vector<std::string>{"HAS_COLOR_MAP"});
+    return variants;
+}
+
+ShaderVariantsPtr ShaderImpl::GetBlinnPhongVariants() {
+    static auto variants = std::make_shared<ShaderVariants>(
+        blinn_phong_vs, blinn_phong_fs,
+        std::vector<std::string>{"HAS_DIFFUSE_MAP", "HAS_SPECULAR_MAP", "HAS_NORMAL_MAP"});
+    return variants;
+}
+
+ShaderVariantsPtr ShaderImpl::GetPBRVariants() {
+    static auto variants = std::make_shared<ShaderVariants>(
+        pbr_vs, pbr_fs,
+        std::vector<std::string>{"HAS_BASE_COLOR_MAP", "HAS_RMO_MAP", "HAS_OPACITY_MAP", "HAS_EMISSIVE_MAP",
+                                 "ENABLE_IBL"});
+    return variants;
+}
+
 ShaderPtr ShaderImpl::GetGroundShader() {
-    static ShaderPtr shader = std::make_shared<Shader>(ground_vs.c_str(), ground_fs.c_str());
+    static ShaderPtr shader = BuiltinShader(kGround);
     return shader;
 }
 
 ShaderPtr ShaderImpl::GetDepthShader() {
-    static ShaderPtr shader = std::make_shared<Shader>(depth_vs.c_str(), depth_fs.c_str());
+    static ShaderPtr shader = BuiltinShader(kDepth);
     return shader;
 }
 
 ShaderPtr ShaderImpl::GetScreenShader() {
-    static ShaderPtr shader = std::make_shared<Shader>(screen_shader_vs.c_str(), screen_shader_fs.c_str());
+    static ShaderPtr shader = BuiltinShader(kScreen);
+    return shader;
+}
+
+ShaderPtr ShaderImpl::GetInstancedShader() {
+    static ShaderPtr shader = BuiltinShader(kInstanced);
+    return shader;
+}
+
+ShaderPtr ShaderImpl::GetInstancedTextureBufferShader() {
+    static ShaderPtr shader = BuiltinShader(kInstancedTextureBuffer);
     return shader;
 }
 
@@ -680,7 +877,7 @@ ShaderPtr ShaderImpl::LoadShader(const std::string &vertexShaderPath, const std:
     std::ifstream ifs(vertexShaderPath);
     if (!ifs.is_open()) {
         std::cerr << "Failed to open vertex shader file: " << vertexShaderPath << std::endl;
-        exit(-1);
+        return nullptr;
     }
     std::string vertexShaderSource((std::istreambuf_iterator<char>(ifs)), (std::istreambuf_iterator<char>()));
     ifs.close();
@@ -688,12 +885,19 @@ ShaderPtr ShaderImpl::LoadShader(const std::string &vertexShaderPath, const std:
     ifs.open(fragShaderPath);
     if (!ifs.is_open()) {
         std::cerr << "Failed to open fragment shader file: " << fragShaderPath << std::endl;
-        exit(-1);
+        return nullptr;
     }
     std::string fragShaderSource((std::istreambuf_iterator<char>(ifs)), (std::istreambuf_iterator<char>()));
     ifs.close();
 
-    return std::make_shared<Shader>(vertexShaderSource.c_str(), fragShaderSource.c_str());
+    ProgramBuild build = Shader::SubmitProgram(vertexShaderSource.c_str(), fragShaderSource.c_str());
+    std::string error;
+    const unsigned int program = Shader::FinishProgram(build, error);
+    if (program == 0) {
+        std::cerr << "Failed to build the shader " << vertexShaderPath << ", " << fragShaderPath << "\n" << error;
+        return nullptr;
+    }
+    return std::make_shared<Shader>(program);
 }
 
 
@@ -2,6 +2,7 @@
 
 #include <iostream>
 #include "vivid/core/Shader.h"
+#include "vivid/core/ShaderVariants.h"
 
 namespace vivid {
 
@@ -9,6 +10,12 @@ class ShaderImpl {
 public:
     ShaderImpl() = default;
 
+    // Start compiling all the built-in shaders in ShaderLibrary::Default(), and the material variants without
+    // textures, so that the Get*Shader() functions only wait for the ones not finished yet
+    static void Precompile();
+
+    // The shaders below are null if they fail to build, the errors are in ShaderLibrary::Default()
+
     static ShaderPtr GetVertexColoredShader();
 
     static ShaderPtr GetColoredBasicShader();
@@ -19,6 +26,17 @@ public:
 
     static ShaderPtr GetPBRShader();
 
+    // Variants of the colored basic, Blinn-Phong and PBR shaders specialized by material features, see
+    // ShaderVariants. Bit i of the feature mask sets define i:
+    //   colored basic  HAS_COLOR_MAP
+    //   Blinn-Phong    HAS_DIFFUSE_MAP, HAS_SPECULAR_MAP, HAS_NORMAL_MAP
+    //   PBR            HAS_BASE_COLOR_MAP, HAS_RMO_MAP, HAS_OPACITY_MAP, HAS_EMISSIVE_MAP, ENABLE_IBL
+    static ShaderVariantsPtr GetColoredBasicVariants();
+
+    static ShaderVariantsPtr GetBlinnPhongVariants();
+
+    static ShaderVariantsPtr GetPBRVariants();
+
     static ShaderPtr GetToonShader();
 
     static ShaderPtr GetGroundShader();
@@ -27,6 +45,13 @@ public:
 
     static ShaderPtr GetScreenShader();
 
+    // Shading with per-instance transforms and colors, for InstancedMesh
+    static ShaderPtr GetInstancedShader();
+
+    // Same as GetInstancedShader(), reading the instances from texture buffers
+    static ShaderPtr GetInstancedTextureBufferShader();
+
+    // Shader of two source files, null if a file can't be read or the program fails to build
     static ShaderPtr LoadShader(const std::string& vertexShaderPath, const std::string& fragShaderPath);
 
 };
@@ -1,6 +1,7 @@
 #include <utility>
 
 #include "vivid/extras/Shadow.h"
+#include "vivid/core/GLStateCache.h"
 #include "vivid/extras/ShaderImpl.h"
 
 namespace vivid {
@@ -13,17 +14,22 @@ Shadow::Shadow(CameraPtr lightCam, int width, int height)
 
     // create depth shader
     depthShader_ = ShaderImpl::GetDepthShader();
+    if (depthShader_ == nullptr) {
+        std::cerr << "Warning: the depth shader failed to build, the depth map stays empty!\n";
+    }
 }
 
 
 void Shadow::RenderDepthMap(const std::vector<MeshPtr> &castMeshes) {
     // render depth map
     depthFrameBuf_->Bind();
-    glViewport(0, 0, width_, height_);
+    GLStateCache::Instance().Viewport(0, 0, width_, height_);
     glClear(GL_DEPTH_BUFFER_BIT);
-    depthShader_->Use();
-    for (const auto &mesh : castMeshes) {
-        mesh->Draw(lightCam_, depthShader_, GL_TRIANGLES, false);
+    if (depthShader_ != nullptr) {
+        depthShader_->Use();
+        for (const auto &mesh : castMeshes) {
+            mesh->Draw(lightCam_, depthShader_, GL_TRIANGLES, false);
+        }
     }
     depthFrameBuf_->Unbind();
 }
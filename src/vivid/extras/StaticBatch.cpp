@@ -0,0 +1,151 @@
+#include <array>
+#include <map>
+#include "vivid/extras/StaticBatch.h"
+#include "vivid/core/VertexLayout.h"
+
+namespace vivid {
+
+// Attribute types and formats of a geometry, meshes must match to be merged
+static VertexLayout FormatOf(const Geometry &geometry) {
+    VertexLayout layout;
+    for (int i = 0; i < kAttribNum; ++i) {
+        const auto type = static_cast<AttributeType>(i);
+        if (geometry.GetAttribute(type)) {
+            layout.SetLocation(type, i);
+            layout.SetFormat(type, *geometry.GetAttribute(type));
+        }
+    }
+    return layout;
+}
+
+
+void StaticBatch::Add(const MeshPtr &mesh) {
+    pending_.push_back(mesh);
+}
+
+
+void StaticBatch::Clear() {
+    pending_.clear();
+    batches_.clear();
+}
+
+
+const std::vector<MeshPtr>& StaticBatch::Build() {
+    // Group the meshes by material and vertex format, in the order they were added
+    std::map<std::pair<const Material*, uint64_t>, size_t> groupIndices;
+    std::vector<std::vector<MeshPtr>> groups;
+    for (const auto &mesh : pending_) {
+        const auto &geometry = mesh->GetGeometry();
+        if (!geometry || !geometry->GetAttribute(AttributeType::Position)) {
+            std::cerr << "Warning: mesh without positions is not batched!\n";
+            continue;
+        }
+        const auto key = std::make_pair(mesh->GetMaterial().get(), FormatOf(*geometry).Hash());
+        auto it = groupIndices.find(key);
+        if (it == groupIndices.end()) {
+            it = groupIndices.emplace(key, groups.size()).first;
+            groups.emplace_back();
+        }
+        groups[it->second].push_back(mesh);
+    }
+    pending_.clear();
+
+    for (const auto &group : groups) {
+        auto merged = Merge(group);
+        if (merged) {
+            batches_.push_back(merged);
+        }
+    }
+    return batches_;
+}
+
+
+MeshPtr StaticBatch::Merge(const std::vector<MeshPtr> &meshes) const {
+    std::array<std::vector<float>, kAttribNum> data;
+    std::vector<unsigned int> indices;
+    std::vector<DrawRange> ranges;
+    const auto &first = meshes.front()->GetGeometry();
+
+    int vertexOffset = 0;
+    for (const auto &mesh : meshes) {
+        const auto &geometry = mesh->GetGeometry();
+        const int vertexCount = geometry->GetAttribute(AttributeType::Position)->ItemCount();
+
+        // Bake the world transform into a float copy of the vertices
+        Geometry baked;
+        bool hasCpuData = true;
+        for (int i = 0; i < kAttribNum; ++i) {
+            const auto &attr = geometry->GetAttribute(static_cast<AttributeType>(i));
+            if (attr) {
+                hasCpuData = hasCpuData && attr->HasCpuData();
+                baked.AddAttribute(std::make_shared<Attribute>(attr->Type(), attr->ElementsPerItem(),
+                                                               attr->Normalized(), attr->ToFloat()));
+            }
+        }
+        if (!hasCpuData) {
+            std::cerr << "Warning: the CPU data of mesh (" << mesh->GetName() << ") has been released, "
+                      << "it is not batched!\n";
+            continue;
+        }
+        baked.Transform(mesh->GetTransform().Matrix().cast<float>());
+        for (int i = 0; i < kAttribNum; ++i) {
+            const auto &attr = baked.GetAttribute(static_cast<AttributeType>(i));
+            if (attr) {
+                data[i].insert(data[i].end(), attr->GetData().begin(), attr->GetData().end());
+            }
+        }
+
+        // Indices stay relative to the first vertex of the mesh, the range gives the base vertex
+        const auto firstIndex = static_cast<unsigned int>(indices.size());
+        if (geometry->GetIndex().empty()) {
+            for (int i = 0; i < vertexCount; ++i) {
+                indices.push_back(i);
+            }
+        } else {
+            indices.insert(indices.end(), geometry->GetIndex().begin(), geometry->GetIndex().end());
+        }
+        if (geometry->GetDrawRanges().empty()) {
+            ranges.push_back({firstIndex, static_cast<unsigned int>(indices.size()) - firstIndex, vertexOffset});
+        } else {
+            for (const auto &range : geometry->GetDrawRanges()) {
+                ranges.push_back({firstIndex + range.firstIndex, range.indexCount, vertexOffset + range.baseVertex});
+            }
+        }
+        vertexOffset += vertexCount;
+    }
+    if (ranges.empty()) {
+        return nullptr;
+    }
+
+    // Merged attributes keep the storage format of the originals, except positions: once in world frame they
+    // leave the range the originals were quantized for, so they stay float.
+    auto geometry = std::make_shared<Geometry>();
+    for (int i = 0; i < kAttribNum; ++i) {
+        const auto &attr = first->GetAttribute(static_cast<AttributeType>(i));
+        if (!attr) {
+            continue;
+        }
+        if (attr->Type() == AttributeType::Position) {
+            geometry->AddAttribute(std::make_shared<Attribute>(attr->Type(), attr->ElementsPerItem(), false,
+                                                               std::move(data[i])));
+            continue;
+        }
+        auto merged = std::make_shared<Attribute>(attr->Type(), attr->ElementsPerItem(), attr->Normalized(),
+                                                  std::move(data[i]));
+        merged->Quantize(attr->GetComponentType());
+        geometry->AddAttribute(merged);
+    }
+    geometry->SetIndex(indices, true);
+    geometry->SetDrawRanges(ranges);
+    geometry->SetInterleaved(true);
+    return std::make_shared<Mesh>(geometry, meshes.front()->GetMaterial());
+}
+
+
+void StaticBatch::Draw(const CameraPtr &cam, const ShaderPtr &shader, int drawMode) {
+    for (const auto &mesh : batches_) {
+        mesh->Draw(cam, shader, drawMode);
+    }
+}
+
+} // namespace vivid
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include "vivid/core/Camera.h"
+#include "vivid/core/Mesh.h"
+#include "vivid/core/Shader.h"
+
+namespace vivid {
+
+/* Merge static meshes into a few large geometries, one per material and vertex format. The meshes keep
+ * their own index ranges and are drawn together by a single glMultiDrawElementsBaseVertex call, instead of
+ * one vertex array bind and one draw call each.
+ */
+class StaticBatch {
+public:
+    StaticBatch() = default;
+
+    // Queue a mesh. Its world transform is baked into the merged vertices, later changes are ignored.
+    void Add(const MeshPtr &mesh);
+
+    // Merge the queued meshes and return the merged ones. The CPU data of the queued meshes is needed.
+    // Merged positions are float, the other attributes keep their storage format.
+    const std::vector<MeshPtr>& Build();
+
+    // Draw all the merged meshes, one draw call each.
+    void Draw(const CameraPtr &cam, const ShaderPtr &shader, int drawMode = GL_TRIANGLES);
+
+    inline const std::vector<MeshPtr>& GetMeshes() const { return batches_; }
+
+    void Clear();
+
+private:
+    MeshPtr Merge(const std::vector<MeshPtr> &meshes) const;
+
+    std::vector<MeshPtr> pending_;
+    std::vector<MeshPtr> batches_;
+};
+
+} // namespace vivid
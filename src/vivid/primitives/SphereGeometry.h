@@ -76,6 +76,7 @@ public:
         AddAttribute(std::make_shared<Attribute>(AttributeType::Normal, 3, true, &normals));
         AddAttribute(std::make_shared<Attribute>(AttributeType::TexCoord0, 2, false, &uvs));
         SetIndex(indices);
+        Optimize();
 
     }
 
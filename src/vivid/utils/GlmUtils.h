@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstring>
 #include <glm/glm.hpp>
 #include <Eigen/Dense>
 
@@ -19,6 +20,15 @@ public:
     }
 
 
+    // Both are column-major: single precision matrices are copied as a whole
+    template<int m, int n>
+    static glm::mat<m, n, float, glm::precision::highp> eigen2glm(const Eigen::Matrix<float, m, n> &em) {
+        glm::mat<m, n, float, glm::precision::highp> mat;
+        std::memcpy(&mat[0][0], em.data(), sizeof(float) * m * n);
+        return mat;
+    }
+
+
     template<typename T, int m, int n>
     static Eigen::Matrix<T, m, n> glm2eigen(const glm::mat<m, n, float, glm::precision::highp> &mat) {
         Eigen::Matrix<T, m, n> em;
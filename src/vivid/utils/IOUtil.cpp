@@ -6,9 +6,30 @@
 #include "vivid/utils/stb_image.h"
 #include "vivid/utils/json.hpp"
 #include "vivid/core/Material.h"
+#include "vivid/utils/MeshOptimizer.h"
 
 namespace vivid {
 
+// Weld a triangle soup into an indexed geometry optimized for the vertex cache
+static GeometryPtr CreateIndexedGeometry(std::vector<float> &&positions,
+                                         std::vector<float> &&uvs,
+                                         std::vector<float> &&normals) {
+    std::vector<VertexStream> streams = {{&positions, 3}};
+    if (!uvs.empty()) {
+        streams.push_back({&uvs, 2});
+    }
+    if (!normals.empty()) {
+        streams.push_back({&normals, 3});
+    }
+    std::vector<unsigned int> indices = MeshOptimizer::WeldVertices(streams);
+
+    auto geometry = std::make_shared<Geometry>(std::move(positions), std::move(uvs), std::move(normals));
+    geometry->SetIndex(indices, true);
+    geometry->Optimize();
+    return geometry;
+}
+
+
 bool IOUtil::LoadObj(const std::string &filePath,
                      std::vector<float> &positions,
                      std::vector<float> &normals) {
@@ -74,7 +95,7 @@ bool IOUtil::LoadObj(const std::string &filePath,
 bool IOUtil::ReadObjLegacy(const std::string &filePath, vivid::MeshPtr &mesh) {
     std::vector<float> positions, normals;
     LoadObj(filePath, positions, normals);
-    auto geometry = std::make_shared<Geometry>(&positions, nullptr, &normals);
+    auto geometry = CreateIndexedGeometry(std::move(positions), std::vector<float>(), std::move(normals));
 //    auto material = std::make_shared<Material>();
     mesh = std::make_shared<Mesh>(geometry, nullptr);
     return true;
@@ -164,7 +185,7 @@ MeshPtr IOUtil::CreateMesh(const std::vector<unsigned int> &vertexIndices,
         normals.push_back(normal.z);
     }
 
-    auto geometry = std::make_shared<Geometry>(&positions, nullptr, &normals);
+    auto geometry = CreateIndexedGeometry(std::move(positions), std::vector<float>(), std::move(normals));
     auto mesh = std::make_shared<Mesh>(geometry, nullptr);
     return mesh;
 }
@@ -191,7 +212,7 @@ MeshPtr IOUtil::LoadJsonModel(const std::string &filePath) {
     }
 
     // create mesh
-    auto geo = std::make_shared<Geometry>(&positions, &uvs, &normals);
+    auto geo = CreateIndexedGeometry(std::move(positions), std::move(uvs), std::move(normals));
     auto mesh = std::make_shared<Mesh>(geo, nullptr);
     return mesh;
 }
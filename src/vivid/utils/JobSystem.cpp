@@ -0,0 +1,220 @@
+#include <algorithm>
+#include "vivid/utils/JobSystem.h"
+
+namespace vivid {
+
+// Chunks per thread in ParallelFor, more than one so that threads finishing early steal the rest
+static constexpr size_t kChunksPerThread = 4;
+
+// Job system and queue of the calling thread, if it is a worker
+static thread_local const JobSystem *currentSystem = nullptr;
+static thread_local unsigned int currentQueue = 0;
+
+
+JobSystem::JobSystem(unsigned int workerCount) {
+    queues_.reserve(workerCount + 1);
+    for (unsigned int i = 0; i <= workerCount; ++i) {
+        queues_.push_back(std::unique_ptr<Queue>(new Queue()));
+    }
+    workers_.reserve(workerCount);
+    for (unsigned int i = 0; i < workerCount; ++i) {
+        workers_.emplace_back(&JobSystem::WorkerLoop, this, i);
+    }
+}
+
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+        stop_ = true;
+    }
+    wakeUp_.notify_all();
+    for (auto &worker : workers_) {
+        worker.join();
+    }
+}
+
+
+JobSystem& JobSystem::Instance() {
+    static JobSystem jobSystem(std::max(1u, std::thread::hardware_concurrency()) - 1);
+    return jobSystem;
+}
+
+
+unsigned int JobSystem::QueueIndex() const {
+    return currentSystem == this ? currentQueue : WorkerCount();
+}
+
+
+void JobSystem::Run(JobGroup &group, std::function<void()> job) {
+    group.pending_.fetch_add(1, std::memory_order_relaxed);
+    if (workers_.empty()) {
+        // Nobody else would run it
+        job();
+        group.pending_.fetch_sub(1, std::memory_order_release);
+        return;
+    }
+
+    Queue &queue = *queues_[QueueIndex()];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.jobs.push_back({std::move(job), &group});
+    }
+    queuedJobs_.fetch_add(1, std::memory_order_release);
+    {
+        // Taken so that a worker checking for jobs before going to sleep doesn't miss the notification
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+    }
+    wakeUp_.notify_one();
+}
+
+
+void JobSystem::Wait(JobGroup &group) {
+    const unsigned int queueIndex = QueueIndex();
+    while (!group.Done()) {
+        if (!RunPendingJob(queueIndex)) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+
+bool JobSystem::PopJob(unsigned int queueIndex, bool back, Job &job) {
+    Queue &queue = *queues_[queueIndex];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.jobs.empty()) {
+        return false;
+    }
+    if (back) {
+        job = std::move(queue.jobs.back());
+        queue.jobs.pop_back();
+    } else {
+        job = std::move(queue.jobs.front());
+        queue.jobs.pop_front();
+    }
+    return true;
+}
+
+
+bool JobSystem::RunPendingJob(unsigned int queueIndex) {
+    if (queuedJobs_.load(std::memory_order_acquire) == 0) {
+        return false;
+    }
+
+    // Newest job of our own queue, which is likely to use data still in cache, or else the oldest job
+    // of another queue, which is likely to be the largest
+    Job job;
+    bool found = PopJob(queueIndex, true, job);
+    const auto queueCount = static_cast<unsigned int>(queues_.size());
+    for (unsigned int i = 1; !found && i < queueCount; ++i) {
+        found = PopJob((queueIndex + i) % queueCount, false, job);
+    }
+    if (!found) {
+        return false;
+    }
+    queuedJobs_.fetch_sub(1, std::memory_order_relaxed);
+    job.func();
+    job.group->pending_.fetch_sub(1, std::memory_order_release);
+    return true;
+}
+
+
+void JobSystem::WorkerLoop(unsigned int index) {
+    currentSystem = this;
+    currentQueue = index;
+    while (true) {
+        if (RunPendingJob(index)) {
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleepMutex_);
+        wakeUp_.wait(lock, [this] { return stop_ || queuedJobs_.load(std::memory_order_acquire) > 0; });
+        if (stop_) {
+            return;
+        }
+    }
+}
+
+
+void JobSystem::ParallelFor(size_t begin, size_t end, size_t grainSize,
+                            const std::function<void(size_t, size_t)> &func) {
+    if (end <= begin) {
+        return;
+    }
+    const size_t count = end - begin;
+    const size_t chunkCount = std::min<size_t>(ThreadCount() * kChunksPerThread,
+                                               (count + grainSize - 1) / std::max<size_t>(grainSize, 1));
+    if (chunkCount <= 1 || workers_.empty()) {
+        func(begin, end);
+        return;
+    }
+
+    // The calling thread takes the first chunk, and the others that are left when it is done
+    const size_t chunkSize = (count + chunkCount - 1) / chunkCount;
+    JobGroup group;
+    for (size_t chunkBegin = begin + chunkSize; chunkBegin < end; chunkBegin += chunkSize) {
+        const size_t chunkEnd = std::min(end, chunkBegin + chunkSize);
+        Run(group, [&func, chunkBegin, chunkEnd] { func(chunkBegin, chunkEnd); });
+    }
+    func(begin, begin + chunkSize);
+    Wait(group);
+}
+
+
+TaskGraph::TaskId TaskGraph::Add(std::function<void()> task) {
+    nodes_.push_back(std::unique_ptr<Node>(new Node()));
+    nodes_.back()->task = std::move(task);
+    return nodes_.size() - 1;
+}
+
+
+void TaskGraph::Precede(TaskId before, TaskId after) {
+    if (before >= nodes_.size() || after >= nodes_.size()) {
+        std::cerr << "Warning: unknown task in TaskGraph::Precede!\n";
+        return;
+    }
+    nodes_[before]->successors.push_back(after);
+    nodes_[after]->predecessorCount++;
+}
+
+
+void TaskGraph::Submit(JobSystem &jobs, JobGroup &group, TaskId id) {
+    jobs.Run(group, [this, &jobs, &group, id] {
+        Node &node = *nodes_[id];
+        node.task();
+        doneCount_.fetch_add(1, std::memory_order_relaxed);
+        // Submitted before this job ends, so the group can't be seen done in between
+        for (TaskId successor : node.successors) {
+            if (nodes_[successor]->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                Submit(jobs, group, successor);
+            }
+        }
+    });
+}
+
+
+void TaskGraph::Run(JobSystem &jobs) {
+    for (auto &node : nodes_) {
+        node->remaining.store(node->predecessorCount, std::memory_order_relaxed);
+    }
+    doneCount_ = 0;
+
+    JobGroup group;
+    for (TaskId id = 0; id < nodes_.size(); ++id) {
+        if (nodes_[id]->predecessorCount == 0) {
+            Submit(jobs, group, id);
+        }
+    }
+    jobs.Wait(group);
+
+    if (doneCount_ != nodes_.size()) {
+        std::cerr << "Warning: " << nodes_.size() - doneCount_ << " tasks of the graph are in a dependency cycle "
+                  << "and were not run!\n";
+    }
+}
+
+
+void TaskGraph::Clear() {
+    nodes_.clear();
+}
+
+} // namespace vivid
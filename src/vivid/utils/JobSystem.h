@@ -0,0 +1,134 @@
+#pragma once
+
+#include <iostream>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace vivid {
+
+// Jobs submitted together, waited for together
+class JobGroup {
+public:
+    JobGroup() = default;
+
+    JobGroup(const JobGroup&) = delete;
+    JobGroup& operator=(const JobGroup&) = delete;
+
+    inline bool Done() const { return pending_.load(std::memory_order_acquire) == 0; }
+
+private:
+    friend class JobSystem;
+    std::atomic<size_t> pending_{0};
+};
+
+
+/* Pool of worker threads running jobs, with work stealing: each worker pushes and pops the jobs it
+ * submits at the back of its own queue, and steals from the front of the others when it runs out.
+ * Threads that are not workers submit to a shared queue. A thread waiting for a group runs pending
+ * jobs in the meantime, so jobs may submit and wait for nested jobs.
+ */
+class JobSystem {
+public:
+    // `workerCount` threads in addition to the threads that wait for the jobs
+    explicit JobSystem(unsigned int workerCount);
+
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    // Shared job system, with one worker per hardware thread besides the calling one
+    static JobSystem& Instance();
+
+    inline unsigned int WorkerCount() const { return static_cast<unsigned int>(workers_.size()); }
+
+    // Threads running jobs while one thread waits: the workers and the waiting thread
+    inline unsigned int ThreadCount() const { return WorkerCount() + 1; }
+
+    void Run(JobGroup &group, std::function<void()> job);
+
+    // Return when all the jobs of the group are done, running jobs meanwhile.
+    void Wait(JobGroup &group);
+
+    // Split [begin, end) into chunks of at least `grainSize` items and run func(chunkBegin, chunkEnd)
+    // on each chunk. The calling thread takes part, small ranges run on it only.
+    void ParallelFor(size_t begin, size_t end, size_t grainSize,
+                     const std::function<void(size_t, size_t)> &func);
+
+private:
+    struct Job {
+        std::function<void()> func;
+        JobGroup *group = nullptr;
+    };
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Job> jobs;
+    };
+
+    void WorkerLoop(unsigned int index);
+
+    // Queue of the calling thread: its own for a worker, the shared one otherwise
+    unsigned int QueueIndex() const;
+
+    // Run one job, from the queue of the thread first, stolen otherwise. False if there was none.
+    bool RunPendingJob(unsigned int queueIndex);
+
+    bool PopJob(unsigned int queueIndex, bool back, Job &job);
+
+    std::vector<std::thread> workers_;
+    std::vector<std::unique_ptr<Queue>> queues_;    // one per worker, then the shared one
+    std::atomic<size_t> queuedJobs_{0};
+
+    // Idle workers sleep until jobs are queued
+    std::mutex sleepMutex_;
+    std::condition_variable wakeUp_;
+    bool stop_ = false;
+};
+
+
+/* Tasks with dependencies, run on a job system: a task starts once all the tasks preceding it are done,
+ * independent tasks run in parallel. The graph can be run again, e.g. once per frame.
+ */
+class TaskGraph {
+public:
+    using TaskId = size_t;
+
+    TaskGraph() = default;
+
+    TaskGraph(const TaskGraph&) = delete;
+    TaskGraph& operator=(const TaskGraph&) = delete;
+
+    TaskId Add(std::function<void()> task);
+
+    // `after` runs once `before` is done
+    void Precede(TaskId before, TaskId after);
+
+    // Run all the tasks and return when they are done. Tasks in a dependency cycle are not run.
+    void Run(JobSystem &jobs = JobSystem::Instance());
+
+    inline size_t Size() const { return nodes_.size(); }
+
+    void Clear();
+
+private:
+    struct Node {
+        std::function<void()> task;
+        std::vector<TaskId> successors;
+        unsigned int predecessorCount = 0;
+        std::atomic<unsigned int> remaining{0};
+    };
+
+    void Submit(JobSystem &jobs, JobGroup &group, TaskId id);
+
+    std::vector<std::unique_ptr<Node>> nodes_;
+    std::atomic<size_t> doneCount_{0};
+};
+
+} // namespace vivid
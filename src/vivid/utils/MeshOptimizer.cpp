@@ -0,0 +1,284 @@
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include "vivid/utils/Parallel.h"
+
+namespace vivid {
+
+namespace {
+
+constexpr int kCacheSize = 32;
+constexpr int kMaxValence = 32;
+constexpr float kCacheDecayPower = 1.5f;
+constexpr float kLastTriangleScore = 0.75f;
+constexpr float kValenceBoostScale = 2.0f;
+constexpr float kValenceBoostPower = 0.5f;
+
+// Score tables, indexed by cache position and by remaining valence
+struct ScoreTable {
+    float cache[kCacheSize];
+    float valence[kMaxValence + 1];
+
+    ScoreTable() {
+        for (int i = 0; i < kCacheSize; ++i) {
+            if (i < 3) {
+                // The vertices of the last triangle are penalized, so that strips don't ping-pong
+                cache[i] = kLastTriangleScore;
+            } else {
+                const float scaler = 1.0f / (kCacheSize - 3);
+                cache[i] = std::pow(1.0f - (float)(i - 3) * scaler, kCacheDecayPower);
+            }
+        }
+        valence[0] = 0.f;
+        for (int i = 1; i <= kMaxValence; ++i) {
+            // Boost vertices with few triangles left, to finish them off quickly
+            valence[i] = kValenceBoostScale * std::pow((float)i, -kValenceBoostPower);
+        }
+    }
+};
+
+float VertexScore(const ScoreTable &table, int cachePosition, unsigned int remainingValence) {
+    if (remainingValence == 0) {
+        return -1.f;
+    }
+    float score = cachePosition >= 0 ? table.cache[cachePosition] : 0.f;
+    return score + table.valence[std::min<unsigned int>(remainingValence, kMaxValence)];
+}
+
+// Comparable bits of a float, with -0 and +0 made equal
+uint32_t FloatKey(float value) {
+    if (value == 0.f) {
+        return 0;
+    }
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+} // namespace
+
+
+std::vector<unsigned int> MeshOptimizer::WeldVertices(const std::vector<VertexStream> &streams, float gridSize) {
+    if (streams.empty()) {
+        return {};
+    }
+    size_t keySize = 0;
+    for (const auto &stream : streams) {
+        keySize += stream.elementsPerVertex;
+    }
+    const size_t vertexCount = streams[0].data->size() / streams[0].elementsPerVertex;
+    for (const auto &stream : streams) {
+        if (stream.data->size() != vertexCount * stream.elementsPerVertex) {
+            std::cerr << "Warning: vertex streams have different vertex counts, vertices are not welded!\n";
+            std::vector<unsigned int> indices(vertexCount);
+            for (size_t i = 0; i < vertexCount; ++i) {
+                indices[i] = (unsigned int)i;
+            }
+            return indices;
+        }
+    }
+
+    // Key and hash of every vertex
+    std::vector<uint32_t> keys(vertexCount * keySize);
+    std::vector<uint64_t> hashes(vertexCount);
+    const float invGridSize = gridSize > 0.f ? 1.f / gridSize : 0.f;
+    ParallelFor(0, vertexCount, 1 << 15, [&](size_t begin, size_t end) {
+        for (size_t v = begin; v < end; ++v) {
+            uint32_t *key = &keys[v * keySize];
+            for (const auto &stream : streams) {
+                const float *values = stream.data->data() + v * stream.elementsPerVertex;
+                for (int k = 0; k < stream.elementsPerVertex; ++k) {
+                    *key++ = gridSize > 0.f ? (uint32_t)(int32_t)std::floor(values[k] * invGridSize + 0.5f)
+                                            : FloatKey(values[k]);
+                }
+            }
+            // FNV-1a
+            uint64_t h = 14695981039346656037ull;
+            for (size_t k = 0; k < keySize; ++k) {
+                h = (h ^ keys[v * keySize + k]) * 1099511628211ull;
+            }
+            hashes[v] = h;
+        }
+    });
+
+    // Open addressing table of the unique vertices, at most half full
+    size_t tableSize = 1;
+    while (tableSize < vertexCount * 2) {
+        tableSize <<= 1;
+    }
+    const auto empty = static_cast<unsigned int>(-1);
+    std::vector<unsigned int> table(tableSize, empty);
+    std::vector<unsigned int> indices(vertexCount);
+    std::vector<unsigned int> uniqueVertices;
+    uniqueVertices.reserve(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v) {
+        size_t slot = hashes[v] & (tableSize - 1);
+        while (true) {
+            const unsigned int other = table[slot];
+            if (other == empty) {
+                table[slot] = (unsigned int)v;
+                indices[v] = (unsigned int)uniqueVertices.size();
+                uniqueVertices.push_back((unsigned int)v);
+                break;
+            }
+            if (hashes[other] == hashes[v]
+                && std::equal(&keys[v * keySize], &keys[v * keySize] + keySize, &keys[other * keySize])) {
+                indices[v] = indices[other];
+                break;
+            }
+            slot = (slot + 1) & (tableSize - 1);
+        }
+    }
+
+    // Compact the streams, unique vertices keep their input order
+    for (const auto &stream : streams) {
+        std::vector<float> &data = *stream.data;
+        const int n = stream.elementsPerVertex;
+        for (size_t i = 0; i < uniqueVertices.size(); ++i) {
+            std::copy_n(&data[uniqueVertices[i] * n], n, &data[i * n]);
+        }
+        data.resize(uniqueVertices.size() * n);
+        data.shrink_to_fit();
+    }
+    return indices;
+}
+
+
+void MeshOptimizer::OptimizeVertexCache(std::vector<unsigned int> &indices, size_t vertexCount) {
+    const size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0 || vertexCount == 0) {
+        return;
+    }
+    static const ScoreTable table;
+
+    // Triangles adjacent to each vertex
+    std::vector<unsigned int> valence(vertexCount, 0);
+    for (unsigned int index : indices) {
+        if (index >= vertexCount) {
+            std::cerr << "Warning: index " << index << " out of range, vertex cache optimization is skipped!\n";
+            return;
+        }
+        valence[index]++;
+    }
+    std::vector<unsigned int> adjacencyOffsets(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; ++v) {
+        adjacencyOffsets[v + 1] = adjacencyOffsets[v] + valence[v];
+    }
+    std::vector<unsigned int> adjacency(indices.size());
+    std::vector<unsigned int> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+    for (size_t t = 0; t < triangleCount; ++t) {
+        for (int k = 0; k < 3; ++k) {
+            adjacency[fill[indices[t * 3 + k]]++] = (unsigned int)t;
+        }
+    }
+
+    std::vector<float> vertexScores(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v) {
+        vertexScores[v] = VertexScore(table, -1, valence[v]);
+    }
+    std::vector<float> triangleScores(triangleCount);
+    for (size_t t = 0; t < triangleCount; ++t) {
+        triangleScores[t] = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]]
+                            + vertexScores[indices[t * 3 + 2]];
+    }
+
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<unsigned int> result;
+    result.reserve(indices.size());
+
+    // LRU cache, with room for the 3 vertices pushed in before the overflow is evicted
+    std::vector<unsigned int> cache, nextCache;
+    cache.reserve(kCacheSize + 3);
+    nextCache.reserve(kCacheSize + 3);
+
+    size_t scanCursor = 0;
+    long bestTriangle = 0;
+    while (bestTriangle >= 0) {
+        // Emit the triangle and remove it from the adjacency of its vertices
+        emitted[bestTriangle] = true;
+        const unsigned int *tri = &indices[bestTriangle * 3];
+        result.insert(result.end(), tri, tri + 3);
+        for (int k = 0; k < 3; ++k) {
+            const unsigned int v = tri[k];
+            unsigned int *begin = &adjacency[adjacencyOffsets[v]];
+            unsigned int *end = begin + valence[v];
+            std::iter_swap(std::find(begin, end, (unsigned int)bestTriangle), end - 1);
+            valence[v]--;
+        }
+
+        // Move its vertices to the front of the cache
+        nextCache.assign(tri, tri + 3);
+        for (unsigned int v : cache) {
+            if (v != tri[0] && v != tri[1] && v != tri[2]) {
+                nextCache.push_back(v);
+            }
+        }
+        cache.swap(nextCache);
+
+        // Update the scores of the cached vertices, including the ones just evicted
+        for (size_t i = 0; i < cache.size(); ++i) {
+            const unsigned int v = cache[i];
+            const float score = VertexScore(table, i < (size_t)kCacheSize ? (int)i : -1, valence[v]);
+            const float delta = score - vertexScores[v];
+            vertexScores[v] = score;
+            for (unsigned int j = 0; j < valence[v]; ++j) {
+                triangleScores[adjacency[adjacencyOffsets[v] + j]] += delta;
+            }
+        }
+        if (cache.size() > (size_t)kCacheSize) {
+            cache.resize(kCacheSize);
+        }
+
+        // The next triangle is the best one using a cached vertex
+        float bestScore = -1.f;
+        bestTriangle = -1;
+        for (unsigned int v : cache) {
+            for (unsigned int j = 0; j < valence[v]; ++j) {
+                const unsigned int t = adjacency[adjacencyOffsets[v] + j];
+                if (triangleScores[t] > bestScore) {
+                    bestScore = triangleScores[t];
+                    bestTriangle = t;
+                }
+            }
+        }
+
+        // Dead end, restart from the first triangle not emitted yet
+        if (bestTriangle < 0) {
+            while (scanCursor < triangleCount && emitted[scanCursor]) {
+                scanCursor++;
+            }
+            if (scanCursor < triangleCount) {
+                bestTriangle = (long)scanCursor;
+            }
+        }
+    }
+
+    indices.swap(result);
+}
+
+
+std::vector<unsigned int> MeshOptimizer::OptimizeVertexFetch(std::vector<unsigned int> &indices,
+                                                             size_t vertexCount) {
+    const auto unassigned = static_cast<unsigned int>(-1);
+    std::vector<unsigned int> remap(vertexCount, unassigned);
+    unsigned int next = 0;
+    for (unsigned int &index : indices) {
+        if (index >= vertexCount) {
+            continue;
+        }
+        if (remap[index] == unassigned) {
+            remap[index] = next++;
+        }
+        index = remap[index];
+    }
+    for (unsigned int &newIndex : remap) {
+        if (newIndex == unassigned) {
+            newIndex = next++;
+        }
+    }
+    return remap;
+}
+
+} // namespace vivid
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+
+namespace vivid {
+
+// A per-vertex float array, e.g. positions with 3 elements per vertex.
+struct VertexStream {
+    std::vector<float> *data;
+    int elementsPerVertex;
+};
+
+/* Index buffer optimizations for indexed triangle lists.
+ */
+class MeshOptimizer {
+public:
+    MeshOptimizer() = default;
+
+    // Merge the vertices whose streams hold identical values, or, if gridSize is positive, values snapped to
+    // the same cell of a grid of that size. This is grid snapping, not a distance threshold: values closer
+    // than gridSize but on both sides of a cell boundary stay apart. The streams are compacted in place,
+    // keeping the first vertex of each group, and the index of each input vertex is returned. Keys are
+    // computed on several threads.
+    static std::vector<unsigned int> WeldVertices(const std::vector<VertexStream> &streams, float gridSize = 0.f);
+
+    // Reorder triangles so that consecutive triangles share vertices, keeping the post-transform vertex
+    // cache hot (Tom Forsyth's "Linear-Speed Vertex Cache Optimisation").
+    static void OptimizeVertexCache(std::vector<unsigned int> &indices, size_t vertexCount);
+
+    // Renumber vertices in the order the triangles first reference them, so that vertex fetching walks
+    // memory linearly. Unreferenced vertices are moved to the end.
+    // Return the new index of each old vertex, used to reorder the vertex data.
+    static std::vector<unsigned int> OptimizeVertexFetch(std::vector<unsigned int> &indices, size_t vertexCount);
+};
+
+} // namespace vivid
@@ -0,0 +1,11 @@
+#include "vivid/utils/Parallel.h"
+#include "vivid/utils/JobSystem.h"
+
+namespace vivid {
+
+void ParallelFor(size_t begin, size_t end, size_t grainSize,
+                 const std::function<void(size_t, size_t)> &func) {
+    JobSystem::Instance().ParallelFor(begin, end, grainSize, func);
+}
+
+} // namespace vivid
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <iostream>
+#include <functional>
+
+namespace vivid {
+
+/* Split [begin, end) into chunks of at least `grainSize` items and run func(chunkBegin, chunkEnd) on each
+ * chunk, on the shared JobSystem. Small ranges run on the calling thread.
+ */
+void ParallelFor(size_t begin, size_t end, size_t grainSize,
+                 const std::function<void(size_t, size_t)> &func);
+
+} // namespace vivid
@@ -1,14 +1,28 @@
 #pragma once
 
 #include <vivid/core/Attribute.h>
+#include <vivid/core/BVH.h>
+#include <vivid/core/Bounds.h>
 #include <vivid/core/Camera.h>
+#include <vivid/core/FrameUniforms.h>
+#include <vivid/core/Frustum.h>
 #include <vivid/core/Geometry.h>
+#include <vivid/core/GLStateCache.h>
+#include <vivid/core/InstancedMesh.h>
 #include <vivid/core/Light.h>
 #include <vivid/core/Mesh.h>
+#include <vivid/core/MeshBVH.h>
 #include <vivid/core/Object3D.h>
+#include <vivid/core/Renderer.h>
+#include <vivid/core/Scene.h>
 #include <vivid/core/Shader.h>
+#include <vivid/core/ShaderCache.h>
+#include <vivid/core/ShaderLibrary.h>
+#include <vivid/core/ShaderSource.h>
+#include <vivid/core/ShaderVariants.h>
 #include <vivid/core/Texture.h>
 #include <vivid/core/Transform.h>
+#include <vivid/core/TransformTree.h>
 
 #include <vivid/extras/FrameBuffer.h>
 #include <vivid/extras/ShaderImpl.h>